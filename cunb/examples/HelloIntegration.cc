@@ -24,6 +24,7 @@
 #include "ns3/sub-band-cunb.h"
 #include "ns3/cunb-mac-trailer-ul.h"
 #include "ns3/Hello_helper.h"
+#include "ns3/cunb-packet-tracker-helper.h"
 #include <iostream>
 
 #include <algorithm>
@@ -34,12 +35,6 @@ using namespace ns3;
 NS_LOG_COMPONENT_DEFINE ("HelloIntegrationTrace");
 
 // Variables that stores the status of captured packets
-int noMoreReceivers = 0;
-int interfered = 0;
-int received = 0;
-int underSensitivity = 0;
-int underSensitivity_at_bs = 0;
-int underSensitivity_at_sm = 0;
 int transmitted_by_sm = 0;
 int transmitted_by_bs = 0;
 int succesfully_acked = 0; // GET Response ACKed
@@ -50,185 +45,19 @@ int assoc_req = 0; // AA Request sent by Data Concentrator
 int simulation_endtime = 500;
 int reporting_interval = 30;
 
-int received_by_sm = 0;
-int received_by_bs = 0;
-
-int wrong_freq = 0;
-
 int phy_rx_begin = 0;
 
 uint8_t sm_count = 60;
 uint8_t enb_count = 2;
 
-enum PacketOutcome {
-  RECEIVED,
-  INTERFERED,
-  NO_MORE_RECEIVERS,
-  UNDER_SENSITIVITY,
-  WRONG_FREQUENCY,
-  UNSET
-};
-
-struct PacketStatus {
-  Ptr<Packet const> packet;
-  uint32_t senderId;
-  int outcomeNumber;
-  std::vector<enum PacketOutcome> outcomes;
-};
-
-std::map<Ptr<Packet const>, PacketStatus> packetTracker;
-
-void
-CheckReceptionByAllEnbsComplete (std::map<Ptr<Packet const>, PacketStatus>::iterator it)
-{
-  // Check whether this packet is received by all gateways
-  if ((*it).second.outcomeNumber == enb_count)
-    {
-      // Update the statistics
-      PacketStatus status = (*it).second;
-      for (int j = 0; j < enb_count; j++)
-        {
-          switch (status.outcomes.at (j))
-            {
-            case RECEIVED:
-              {
-                received += 1;
-                std::cout << "Received "<<received<<std::endl;
-                break;
-              }
-            case UNDER_SENSITIVITY:
-              {
-                underSensitivity += 1;
-                break;
-              }
-            case NO_MORE_RECEIVERS:
-              {
-                noMoreReceivers += 1;
-                break;
-              }
-            case INTERFERED:
-              {
-                interfered += 1;
-                break;
-              }
-            case WRONG_FREQUENCY:
-              {
-                wrong_freq += 1;
-                break;
-              }
-            case UNSET:
-              {
-                break;
-              }
-            }
-        }
-      // Remove the packet from the tracker
-      packetTracker.erase (it);
-    }
-}
-
 void
 TransmissionCallback (Ptr<Packet const> packet, uint32_t systemId)
 {
   // NS_LOG_INFO ("Transmitted a packet from device " << systemId);
-  // Create a packetStatus
-  PacketStatus status;
-  status.packet = packet;
-  status.senderId = systemId;
-  status.outcomeNumber = 0;
-  status.outcomes = std::vector<enum PacketOutcome> (enb_count, UNSET);
   if(systemId < sm_count)
 	  transmitted_by_sm++;
   else
       transmitted_by_bs++;
-
-  packetTracker.insert (std::pair<Ptr<Packet const>, PacketStatus> (packet, status));
-}
-
-//LostPacketBecauseWrongFrequency
-
-void
-PacketReceptionCallback (Ptr<Packet const> packet, uint32_t systemId)
-{
-  // Remove the successfully received packet from the list of sent ones
-  // NS_LOG_INFO ("A packet was successfully received at gateway " << systemId);
-
-  std::map<Ptr<Packet const>, PacketStatus>::iterator it = packetTracker.find (packet);
-  std::cout << "System Id: " << systemId << " packet counts " << packetTracker.count(packet) << std::endl;
-  if(systemId < sm_count)
-	  {received_by_sm++;
-	  std::cout <<received_by_sm<< " for SM"<<std::endl;
-      (*it).second.outcomes.at (systemId) = RECEIVED;}
-  else{
-      received_by_bs++;
-      std::cout <<received_by_bs<< " for BS"<<std::endl;
-      (*it).second.outcomes.at (systemId - sm_count) = RECEIVED;}
-
-  (*it).second.outcomeNumber += 1;
-
-  CheckReceptionByAllEnbsComplete (it);
-}
-
-void
-InterferenceCallback (Ptr<Packet const> packet, uint32_t systemId)
-{
-  // NS_LOG_INFO ("A packet was lost because of interference at gateway " << systemId);
-
-  std::map<Ptr<Packet const>, PacketStatus>::iterator it = packetTracker.find (packet);
-  if(systemId < sm_count)
-  {
-	  (*it).second.outcomes.at (systemId) = INTERFERED;
-  }
-  else{
-	  (*it).second.outcomes.at (systemId - sm_count) = INTERFERED;
-  }
-  (*it).second.outcomeNumber += 1;
-
-  CheckReceptionByAllEnbsComplete (it);
-}
-
-void
-UnderSensitivityCallback (Ptr<Packet const> packet, uint32_t systemId)
-{
-  // NS_LOG_INFO ("A packet arrived at the gateway under sensitivity at gateway " << systemId);
-
-  std::map<Ptr<Packet const>, PacketStatus>::iterator it = packetTracker.find (packet);
-  if(systemId < sm_count)
-  {
-	  underSensitivity_at_sm +=1;
-     (*it).second.outcomes.at (systemId) = UNDER_SENSITIVITY;
-  }
-  else{
-	  underSensitivity_at_bs +=1;
-	  (*it).second.outcomes.at (systemId - sm_count) = UNDER_SENSITIVITY;
-  }
-  (*it).second.outcomeNumber += 1;
-
-  CheckReceptionByAllEnbsComplete (it);
-}
-
-void
-NoMoreReceiversCallback (Ptr<Packet const> packet, uint32_t systemId)
-{
-  // NS_LOG_INFO ("A packet was lost because there were no more receivers at gateway " << systemId);
-
-  std::map<Ptr<Packet const>, PacketStatus>::iterator it = packetTracker.find (packet);
-  (*it).second.outcomes.at (systemId - sm_count) = NO_MORE_RECEIVERS;
-  (*it).second.outcomeNumber += 1;
-
-  CheckReceptionByAllEnbsComplete (it);
-}
-
-void
-WrongFrequencyCallback (Ptr<Packet const> packet, uint32_t systemId)
-{
-  // NS_LOG_INFO ("A packet was lost because of wrong frequency" << systemId);
-
-  std::map<Ptr<Packet const>, PacketStatus>::iterator it = packetTracker.find (packet);
-  (*it).second.outcomes.at (systemId) = WRONG_FREQUENCY;
-  (*it).second.outcomeNumber += 1;
-
-  CheckReceptionByAllEnbsComplete (it);
 }
 
 void
@@ -464,12 +293,6 @@ int main (int argc, char *argv[])
 
         // Global callbacks (every gateway)
         enbPhy->TraceConnectWithoutContext ("StartSending",MakeCallback (&TransmissionCallback));
-        // These are all for the received signal at the Physical Layer
-        enbPhy->TraceConnectWithoutContext ("ReceivedPacket",MakeCallback (&PacketReceptionCallback));
-        enbPhy->TraceConnectWithoutContext ("LostPacketBecauseInterference",
-                                           MakeCallback (&InterferenceCallback));
-        enbPhy->TraceConnectWithoutContext ("LostPacketBecauseNoMoreReceivers",MakeCallback (&NoMoreReceiversCallback));
-        enbPhy->TraceConnectWithoutContext ("LostPacketBecauseUnderSensitivity",MakeCallback (&UnderSensitivityCallback));
         enbPhy->TraceConnectWithoutContext ("PhyRxBegin",MakeCallback (&PhyRxBeginCallback));
 
         //enbPhy->TraceConnectWithoutContext ("PhyRxBegin",MakeCallback (&PhyRxBeginCallback));
@@ -478,6 +301,11 @@ int main (int argc, char *argv[])
         enbMac->TraceConnectWithoutContext ("SentAARequest",MakeCallback (&AssociationRequestCallback));
       }
 
+  // Follow the uplinks of the MSs to the eNBs, repetitions included
+  CunbPacketTrackerHelper tracker;
+  tracker.InstallReceivers (enbs);
+  tracker.InstallTransmitters (endDevices);
+
   // Set spreading factors up
   macHelper.SetSpreadingFactorsUp (endDevices, enbs, channel);
 
@@ -568,12 +396,10 @@ int main (int argc, char *argv[])
   // Start simulation
   Simulator::Stop (Seconds (simulation_endtime));
   Simulator::Run ();
+  tracker.Flush ();
   Simulator::Destroy ();
   std::cout << "Transmitted by MS "<< transmitted_by_sm << " and by BS "<< transmitted_by_bs<< std::endl ;
-  std::cout << "Received by MS "<< received_by_sm << " and by BS "<< received_by_bs<< std::endl ;
-  std::cout << "Undersensitivity loss at MS "<< underSensitivity_at_sm << " and at BS "<< underSensitivity_at_bs << std::endl;
-  std::cout << "Wrong Frequency "<<wrong_freq <<std::endl;
-  std::cout << "Received " << received << ", Interfered " << interfered << ", loss due to sensitivity " << underSensitivity << ", loss due to no receiver " << noMoreReceivers << std::endl;
+  tracker.PrintStatistics (std::cout);
   std::cout << "Succesfully Acked "<< succesfully_acked<< " transmitted data " <<transmitted_data<< " transmitted Assoc "<<transmitted_assoc<< " Assoc Req "<< assoc_req<<std::endl;
   std::cout<< "phy rx "<< phy_rx_begin;
 
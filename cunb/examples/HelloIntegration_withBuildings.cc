@@ -23,6 +23,8 @@
 #include "ns3/sub-band-cunb.h"
 #include "ns3/cunb-mac-trailer-ul.h"
 #include "ns3/Hello_helper.h"
+#include "ns3/cunb-kpi-helper.h"
+#include "ns3/simple-cunb-server.h"
 #include <ns3/buildings-helper.h>
 #include <ns3/hybrid-buildings-propagation-loss-model.h>
 #include <ns3/buildings-propagation-loss-model.h>
@@ -289,9 +291,13 @@ int main (int argc, char *argv[])
 {
 
   bool verbose = false;
+  std::string kpiFile = "";
+  double kpiBucket = 60;
 
   CommandLine cmd;
   cmd.AddValue ("verbose", "Whether to print output or not", verbose);
+  cmd.AddValue ("kpiFile", "File the KPIs are written to, none if empty", kpiFile);
+  cmd.AddValue ("kpiBucket", "Duration of a KPI bucket, in s", kpiBucket);
   cmd.Parse (argc, argv);
 
 
@@ -390,13 +396,13 @@ int main (int argc, char *argv[])
   	   if(enb_count == 3){
   		 if(i == 0) enbMobility->SetPosition (Vector (937.0, 1000.0, height_of_enb));
   		 if(i == 1) enbMobility->SetPosition (Vector (1874.0, 1000.0, height_of_enb));
-  		 if(i == 3) enbMobility->SetPosition (Vector (2811.0, 1000.0, height_of_enb));
+  		 if(i == 2) enbMobility->SetPosition (Vector (2811.0, 1000.0, height_of_enb));
   	   }
   	   if(enb_count == 4){
   	   		 if(i == 0) enbMobility->SetPosition (Vector (750.0, 1000.0, height_of_enb));
   	   		 if(i == 1) enbMobility->SetPosition (Vector (1874.0, 1500.0, height_of_enb));
-  	   		 if(i == 3) enbMobility->SetPosition (Vector (1874.0, 500.0, height_of_enb));
-  	   	     if(i == 4) enbMobility->SetPosition (Vector (3000.0, 1000.0, height_of_enb));
+  	   		 if(i == 2) enbMobility->SetPosition (Vector (1874.0, 500.0, height_of_enb));
+  	   	     if(i == 3) enbMobility->SetPosition (Vector (3000.0, 1000.0, height_of_enb));
   	   	   }
 
   	   Ptr<MobilityBuildingInfo> buildingInfoEnb = CreateObject<MobilityBuildingInfo> ();
@@ -596,11 +602,23 @@ int main (int argc, char *argv[])
   CunbForwarderHelper forwarderHelper;
   forwarderHelper.Install (enbs);
 
+  // Aggregate the KPIs over time
+  CunbKpiHelper kpiHelper;
+  if (!kpiFile.empty ())
+    {
+      kpiHelper.SetBucketWidth (Seconds (kpiBucket));
+      kpiHelper.InstallMeters (endDevices);
+      kpiHelper.InstallEnbs (enbs);
+      kpiHelper.InstallServer (cunbServers.Get (0)->GetApplication (0)->GetObject<SimpleCunbServer> ());
+      kpiHelper.Start (kpiFile);
+    }
+
  // helper.EnablePcapAll("cunb",false);
 
   // Start simulation
   Simulator::Stop (Seconds (simulation_endtime+1000));
   Simulator::Run ();
+  kpiHelper.Stop ();
   Simulator::Destroy ();
   std::cout << "Transmitted by MS "<< transmitted_by_sm << " and by BS "<< transmitted_by_bs<< std::endl ;
   std::cout << "Received by MS "<< received_by_sm << " and by BS "<< received_by_bs<< std::endl ;
@@ -0,0 +1,556 @@
+/*
+ * This program times the hot paths of the cunb module in isolation, so that
+ * their costs can be compared before deciding which layer to optimise.
+ *
+ * The kernels are:
+ *  - channel-send: CunbChannel::Send of an uplink to a number of eNBs;
+ *  - interference: CunbInterferenceHelper::IsDestroyedByInterference with a
+ *    number of events kept by the helper, the interferers being on other
+ *    micro channels;
+ *  - interference-same-channel: the same, with all the interferers on the
+ *    micro channel of the reception, so that each one is accounted for;
+ *  - trailer-fcs and trailer-auth: CunbMacTrailer::SetFcs and SetAuth for a
+ *    payload size;
+ *  - ul-serialize and ul-deserialize: the uplink header stack, from the
+ *    COSEM header to the MAC trailer, built as MSCunbMac does and parsed as
+ *    SimpleCunbServer does, for a payload size;
+ *  - enb-start-receive: EnbCunbPhy::StartReceive, searching a number of
+ *    reception paths for a free one;
+ *  - waiting-time: LogicalCunbChannelHelper::GetWaitingTime with a number of
+ *    micro channels, each in a sub-band of its own as CunbMacHelper sets
+ *    them up.
+ *
+ * Each kernel is run Iterations times per repetition, after a repetition
+ * that warms the caches up and isn't accounted for. Events scheduled by a
+ * kernel are run between repetitions, outside of the timed section. The
+ * time per call is reported as the minimum, the median, the 95th percentile,
+ * the maximum and the mean over the repetitions, in a JSON array. Numbers
+ * are only meaningful with an optimized build, without logging:
+ *
+ *   ./waf configure --build-profile=optimized --enable-examples
+ *   ./waf --run "cunb-microbenchmarks --kernels=interference,waiting-time"
+ */
+
+#include "ns3/cunb-channel.h"
+#include "ns3/enb-cunb-phy.h"
+#include "ns3/ms-cunb-phy.h"
+#include "ns3/cunb-interference-helper.h"
+#include "ns3/logical-cunb-channel-helper.h"
+#include "ns3/cunb-mac-header-ul.h"
+#include "ns3/cunb-mac-trailer.h"
+#include "ns3/cunb-frame-header-ul.h"
+#include "ns3/cunb-linklayer-header.h"
+#include "ns3/app-layer-header.h"
+#include "ns3/new-cosem-header.h"
+#include "ns3/cunb-tag.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("CunbMicrobenchmarks");
+
+/**
+ * The options shared by all the kernels.
+ */
+struct BenchmarkOptions
+{
+  uint32_t repetitions;  //!< Timed repetitions of each kernel
+  uint32_t iterations;   //!< Calls per repetition
+  std::ostream *os;      //!< Where the JSON goes
+  bool first;            //!< Whether no result was written yet
+};
+
+/**
+ * Time a kernel, and write the statistics of the time per call.
+ *
+ * \param kernel Runs the timed calls, as many as it's given.
+ * \param drain Whether the events scheduled by the kernel are run after
+ * each repetition.
+ */
+void
+Measure (BenchmarkOptions &options, const std::string &name,
+         const std::string &parameter, uint32_t value, uint32_t iterations,
+         std::function<void (uint32_t)> kernel, bool drain)
+{
+  NS_LOG_INFO ("Timing " << name << " with " << parameter << " " << value);
+
+  std::vector<double> perCall;
+  for (uint32_t r = 0; r <= options.repetitions; r++)
+    {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+      kernel (iterations);
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now ();
+
+      if (drain)
+        {
+          Simulator::Run ();
+        }
+
+      // The first repetition only warms up
+      if (r > 0)
+        {
+          perCall.push_back (std::chrono::duration<double, std::nano> (end - start).count ()
+                             / iterations);
+        }
+    }
+
+  std::sort (perCall.begin (), perCall.end ());
+  double sum = 0;
+  for (uint32_t i = 0; i < perCall.size (); i++)
+    {
+      sum += perCall[i];
+    }
+  uint32_t n = perCall.size ();
+
+  std::ostream &os = *options.os;
+  if (!options.first)
+    {
+      os << "," << std::endl;
+    }
+  options.first = false;
+  os << "  {\"kernel\": \"" << name << "\""
+     << ", \"" << parameter << "\": " << value
+     << ", \"repetitions\": " << n
+     << ", \"iterations\": " << iterations
+     << ", \"minNs\": " << perCall[0]
+     << ", \"medianNs\": " << perCall[n / 2]
+     << ", \"p95Ns\": " << perCall[std::min (n - 1, (uint32_t)(0.95 * n))]
+     << ", \"maxNs\": " << perCall[n - 1]
+     << ", \"meanNs\": " << sum / n << "}";
+  os.flush ();
+}
+
+/**
+ * The center frequencies of the uplink micro channels, as CunbMacHelper
+ * computes them.
+ */
+std::vector<double>
+GetMicroChannels (uint32_t nChannels)
+{
+  std::vector<double> frequencies;
+  double step = (868.3 - 868.1) / nChannels;
+  for (uint32_t i = 0; i < nChannels; i++)
+    {
+      frequencies.push_back (868.1 + (i + 0.5) * step);
+    }
+  return frequencies;
+}
+
+CunbTxParameters
+GetUplinkTxParameters (void)
+{
+  CunbTxParameters params;
+  params.bitrate = 250;
+  params.nPreamble = 8;
+  params.eccEnabled = 1;
+  params.authEnabled = 1;
+  params.fcsEnabled = 1;
+  return params;
+}
+
+/**
+ * Add the uplink headers and trailer of a GET Response to a payload, as
+ * MobileAutonomousReporting and MSCunbMac do.
+ */
+void
+BuildUplink (Ptr<Packet> packet)
+{
+  NewCosemGetResponseNormalHeader cosemHdr;
+  cosemHdr.SetInvokeIdAndPriority (2);
+  cosemHdr.SetData (789);
+  cosemHdr.SetDataAccessResult (0);
+  packet->AddHeader (cosemHdr);
+
+  NewTypeAPDU typeHdr;
+  typeHdr.SetApduType ((ApduType)cosemHdr.GetIdApdu ());
+  packet->AddHeader (typeHdr);
+
+  AppLayerHeader appHdr;
+  appHdr.SetPtype (1);
+  packet->AddHeader (appHdr);
+
+  NewCosemWrapperHeader wrapperHdr;
+  wrapperHdr.SetSrcwPort (80);
+  wrapperHdr.SetDstwPort (90);
+  wrapperHdr.SetLength (packet->GetSize ());
+  packet->AddHeader (wrapperHdr);
+
+  CunbLinkLayerHeader llHdr;
+  packet->AddHeader (llHdr);
+
+  CunbFrameHeaderUl frameHdr;
+  frameHdr.SetFPort (1);
+  frameHdr.SetAddress (CunbDeviceAddress (54, 1864));
+  packet->AddHeader (frameHdr);
+
+  CunbMacHeaderUl macHdr;
+  macHdr.SetMType (CunbMacHeaderUl::SINGLE_ACK);
+  macHdr.SetRepCnts (0);
+  macHdr.SetSeqCnt (0);
+  macHdr.SetIdent (1);
+  packet->AddHeader (macHdr);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  macTlr.SetFcs (packet);
+  macTlr.SetMacHeader (macHdr);
+  macTlr.SetAuth (packet);
+  packet->AddTrailer (macTlr);
+}
+
+/**
+ * Check and remove the uplink headers and trailer, as SimpleCunbServer
+ * does, and return the reading.
+ */
+uint32_t
+ParseUplink (Ptr<Packet> packet)
+{
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  packet->RemoveTrailer (macTlr);
+
+  CunbMacHeaderUl macHdr;
+  packet->PeekHeader (macHdr);
+  macTlr.SetMacHeader (macHdr);
+  if (!macTlr.CheckFcs (packet) || !macTlr.CheckAuth (packet))
+    {
+      return 0;
+    }
+  packet->RemoveHeader (macHdr);
+
+  CunbFrameHeaderUl frameHdr;
+  packet->RemoveHeader (frameHdr);
+  CunbLinkLayerHeader llHdr;
+  packet->RemoveHeader (llHdr);
+  NewCosemWrapperHeader wrapperHdr;
+  packet->RemoveHeader (wrapperHdr);
+  AppLayerHeader appHdr;
+  packet->RemoveHeader (appHdr);
+  NewTypeAPDU typeHdr;
+  packet->RemoveHeader (typeHdr);
+  NewCosemGetResponseNormalHeader hdr;
+  packet->RemoveHeader (hdr);
+
+  return hdr.GetData ();
+}
+
+Ptr<MobilityModel>
+CreateMobility (double x, double y)
+{
+  Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (Vector (x, y, 0));
+  return mobility;
+}
+
+void
+BenchmarkChannelSend (BenchmarkOptions &options, uint32_t nEnbs)
+{
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  loss->SetPathLossExponent (3.76);
+  loss->SetReference (1, 8.1);
+  Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  Ptr<CunbChannel> channel = CreateObject<CunbChannel> (loss, delay);
+
+  Ptr<MSCunbPhy> sender = CreateObject<MSCunbPhy> ();
+  sender->SetMobility (CreateMobility (0, 0));
+  channel->Add (sender);
+  for (uint32_t i = 0; i < nEnbs; i++)
+    {
+      Ptr<EnbCunbPhy> enb = CreateObject<EnbCunbPhy> ();
+      enb->SetMobility (CreateMobility (1000 * (i % 8 + 1), 1000 * (i / 8)));
+      channel->Add (enb);
+    }
+
+  Ptr<Packet> packet = Create<Packet> (20);
+  BuildUplink (packet);
+  CunbTxParameters params = GetUplinkTxParameters ();
+  Time duration = CunbPhy::GetOnAirTime (packet, params, MS);
+  double frequency = GetMicroChannels (150)[0];
+
+  Measure (options, "channel-send", "enbs", nEnbs, options.iterations,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 channel->Send (sender, packet, 14, params, duration, frequency);
+               }
+           }, true);
+
+  Simulator::Destroy ();
+}
+
+void
+BenchmarkInterference (BenchmarkOptions &options, uint32_t nEvents,
+                       bool sameChannel)
+{
+  CunbInterferenceHelper interference;
+  std::vector<double> frequencies = GetMicroChannels (150);
+  Ptr<Packet> packet = Create<Packet> (20);
+
+  // The interferers are either on the other micro channels, so that the
+  // whole list is walked through, as for most of the receptions, or all on
+  // the channel of the reception, so that each one adds to the energy
+  Ptr<UniformRandomVariable> rng = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 1; i < nEvents; i++)
+    {
+      uint32_t channel = sameChannel ? 0 : rng->GetInteger (1, frequencies.size () - 1);
+      interference.Add (Seconds (2), -110, packet, frequencies[channel]);
+    }
+  Ptr<CunbInterferenceHelper::Event> event =
+    interference.Add (Seconds (2), -110, packet, frequencies[0]);
+
+  uint32_t destroyed = 0;
+  Measure (options, sameChannel ? "interference-same-channel" : "interference",
+           "events", nEvents, options.iterations,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 destroyed += interference.IsDestroyedByInterference (event);
+               }
+           }, false);
+  NS_LOG_DEBUG ("Destroyed " << destroyed << " times");
+
+  Simulator::Destroy ();
+}
+
+void
+BenchmarkTrailer (BenchmarkOptions &options, uint32_t payloadSize, bool auth)
+{
+  Ptr<Packet> packet = Create<Packet> (payloadSize);
+  CunbMacHeaderUl macHdr;
+  macHdr.SetMType (CunbMacHeaderUl::SINGLE_ACK);
+  macHdr.SetIdent (1);
+  packet->AddHeader (macHdr);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  macTlr.SetMacHeader (macHdr);
+
+  if (!auth)
+    {
+      Measure (options, "trailer-fcs", "bytes", payloadSize, options.iterations,
+               [&] (uint32_t iterations)
+               {
+                 for (uint32_t i = 0; i < iterations; i++)
+                   {
+                     macTlr.SetFcs (packet);
+                   }
+               }, false);
+      return;
+    }
+
+  Measure (options, "trailer-auth", "bytes", payloadSize, options.iterations,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 macTlr.SetAuth (packet);
+               }
+           }, false);
+}
+
+void
+BenchmarkHeaderStack (BenchmarkOptions &options, uint32_t payloadSize,
+                      bool deserialize)
+{
+  Ptr<Packet> frame = Create<Packet> (payloadSize);
+  BuildUplink (frame);
+
+  if (!deserialize)
+    {
+      Measure (options, "ul-serialize", "bytes", payloadSize, options.iterations,
+               [&] (uint32_t iterations)
+               {
+                 for (uint32_t i = 0; i < iterations; i++)
+                   {
+                     BuildUplink (Create<Packet> (payloadSize));
+                   }
+               }, false);
+      return;
+    }
+
+  uint32_t sum = 0;
+  Measure (options, "ul-deserialize", "bytes", payloadSize, options.iterations,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 sum += ParseUplink (frame->Copy ());
+               }
+           }, false);
+  NS_LOG_DEBUG ("Read " << sum);
+}
+
+void
+BenchmarkStartReceive (BenchmarkOptions &options, uint32_t nPaths)
+{
+  std::vector<double> frequencies = GetMicroChannels (nPaths);
+  Ptr<EnbCunbPhy> enb = CreateObject<EnbCunbPhy> ();
+  for (uint32_t i = 0; i < nPaths; i++)
+    {
+      enb->AddReceptionPath (frequencies[i]);
+    }
+  Ptr<Packet> packet = Create<Packet> (20);
+  BuildUplink (packet);
+
+  // A repetition fills all the paths, one per micro channel, and the events
+  // run between repetitions free them
+  Measure (options, "enb-start-receive", "paths", nPaths, nPaths,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 enb->StartReceive (packet, -100, Seconds (2), frequencies[i]);
+               }
+           }, true);
+
+  Simulator::Destroy ();
+}
+
+void
+BenchmarkWaitingTime (BenchmarkOptions &options, uint32_t nChannels)
+{
+  std::vector<double> frequencies = GetMicroChannels (nChannels);
+  double step = (868.3 - 868.1) / nChannels;
+  LogicalCunbChannelHelper channelHelper;
+  std::vector<Ptr<LogicalCunbChannel> > channels;
+  for (uint32_t i = 0; i < nChannels; i++)
+    {
+      channelHelper.AddSubBand (frequencies[i] - step / 2, frequencies[i] + step / 2, 0);
+      Ptr<LogicalCunbChannel> channel = CreateObject<LogicalCunbChannel> (frequencies[i], 0, 5);
+      channelHelper.AddChannel (channel);
+      channels.push_back (channel);
+    }
+
+  Time total = Seconds (0);
+  Measure (options, "waiting-time", "channels", nChannels, options.iterations,
+           [&] (uint32_t iterations)
+           {
+             for (uint32_t i = 0; i < iterations; i++)
+               {
+                 total += channelHelper.GetWaitingTime (channels[i % nChannels]);
+               }
+           }, false);
+  NS_LOG_DEBUG ("Waited " << total);
+}
+
+int main (int argc, char *argv[])
+{
+  std::string kernels = "channel-send,interference,interference-same-channel,"
+    "trailer-fcs,trailer-auth,ul-serialize,ul-deserialize,enb-start-receive,"
+    "waiting-time";
+  uint32_t repetitions = 30;
+  uint32_t iterations = 1000;
+  std::string output = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("kernels", "Comma separated kernels to time", kernels);
+  cmd.AddValue ("repetitions", "Timed repetitions of each kernel", repetitions);
+  cmd.AddValue ("iterations", "Calls per repetition", iterations);
+  cmd.AddValue ("output", "File the JSON is written to, the standard output if empty", output);
+  cmd.Parse (argc, argv);
+
+  NS_ASSERT (repetitions > 0 && iterations > 0);
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      if (!file.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open " << output);
+          return 1;
+        }
+    }
+
+  BenchmarkOptions options;
+  options.repetitions = repetitions;
+  options.iterations = iterations;
+  options.os = output.empty () ? &std::cout : &file;
+  options.first = true;
+
+  std::vector<std::string> selected;
+  std::istringstream is (kernels);
+  std::string kernel;
+  while (std::getline (is, kernel, ','))
+    {
+      selected.push_back (kernel);
+    }
+
+  // The parameter ranges cover the networks the examples and the scale
+  // benchmark build
+  uint32_t enbCounts[] = { 1, 4, 16, 64 };
+  uint32_t eventCounts[] = { 1, 10, 100, 1000 };
+  uint32_t payloadSizes[] = { 0, 59, 230 };
+  uint32_t pathCounts[] = { 16, 150, 600 };
+  uint32_t channelCounts[] = { 16, 150, 600 };
+
+  *options.os << "[" << std::endl;
+  for (uint32_t k = 0; k < selected.size (); k++)
+    {
+      if (selected[k] == "channel-send")
+        {
+          for (uint32_t i = 0; i < 4; i++)
+            {
+              BenchmarkChannelSend (options, enbCounts[i]);
+            }
+        }
+      else if (selected[k] == "interference"
+               || selected[k] == "interference-same-channel")
+        {
+          for (uint32_t i = 0; i < 4; i++)
+            {
+              BenchmarkInterference (options, eventCounts[i],
+                                     selected[k] == "interference-same-channel");
+            }
+        }
+      else if (selected[k] == "trailer-fcs" || selected[k] == "trailer-auth")
+        {
+          for (uint32_t i = 0; i < 3; i++)
+            {
+              BenchmarkTrailer (options, payloadSizes[i],
+                                selected[k] == "trailer-auth");
+            }
+        }
+      else if (selected[k] == "ul-serialize" || selected[k] == "ul-deserialize")
+        {
+          for (uint32_t i = 0; i < 3; i++)
+            {
+              BenchmarkHeaderStack (options, payloadSizes[i],
+                                    selected[k] == "ul-deserialize");
+            }
+        }
+      else if (selected[k] == "enb-start-receive")
+        {
+          for (uint32_t i = 0; i < 3; i++)
+            {
+              BenchmarkStartReceive (options, pathCounts[i]);
+            }
+        }
+      else if (selected[k] == "waiting-time")
+        {
+          for (uint32_t i = 0; i < 3; i++)
+            {
+              BenchmarkWaitingTime (options, channelCounts[i]);
+            }
+        }
+      else
+        {
+          NS_LOG_ERROR ("Unknown kernel " << selected[k]);
+        }
+    }
+  *options.os << std::endl << "]" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * This program measures how the cunb module scales with the size of the
+ * network.
+ *
+ * Meters are simulated by a CunbMeterPopulation, spread uniformly on a disc
+ * around a square grid of eNBs, all of them connected to a SimpleCunbServer.
+ * For every combination of the meter counts, eNB counts and reporting
+ * intervals given on the command line, the simulation is run once and a JSON
+ * object is written with the wall time, the number of simulator events and
+ * their rate, the peak resident set size of the process and the number of
+ * events at each layer. All objects are gathered in a single JSON array.
+ * With --trace, the events of the eNBs are also written by a CunbTraceWriter,
+ * which gives the cost of tracing a run, and with --occupancy the eNBs'
+ * CunbChannelOccupancy matrices are written to <prefix>-<metric>.csv.
+ *
+ * Since the peak RSS of a process never decreases, each point of the sweep
+ * only gets a meaningful one when it's run by a process of its own, e.g.:
+ *
+ *   ./waf --run "cunb-scale-benchmark --meters=1000000 --enbs=16"
+ */
+
+#include "ns3/cunb-channel.h"
+#include "ns3/cunb-phy-helper.h"
+#include "ns3/cunb-mac-helper.h"
+#include "ns3/cunb-helper.h"
+#include "ns3/cunb-server-helper.h"
+#include "ns3/cunb-forwarder-helper.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/cunb-meter-population.h"
+#include "ns3/cunb-device-address-generator.h"
+#include "ns3/cunb-reading-sink.h"
+#include "ns3/cunb-trace-writer.h"
+#include "ns3/cunb-channel-occupancy.h"
+#include "ns3/simple-cunb-server.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/position-allocator.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include <sys/resource.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("CunbScaleBenchmark");
+
+namespace ns3 {
+
+/**
+ * The default scheduler, counting the events it hands to the simulator.
+ */
+class CunbBenchmarkScheduler : public MapScheduler
+{
+public:
+  static TypeId GetTypeId (void)
+  {
+    static TypeId tid = TypeId ("ns3::CunbBenchmarkScheduler")
+      .SetParent<MapScheduler> ()
+      .AddConstructor<CunbBenchmarkScheduler> ();
+    return tid;
+  }
+
+  virtual Event RemoveNext (void)
+  {
+    s_nEvents++;
+    return MapScheduler::RemoveNext ();
+  }
+
+  static uint64_t s_nEvents; //!< Events run since the last reset
+};
+
+uint64_t CunbBenchmarkScheduler::s_nEvents = 0;
+
+NS_OBJECT_ENSURE_REGISTERED (CunbBenchmarkScheduler);
+
+}
+
+/**
+ * The events of a run, layer by layer.
+ */
+struct LayerCounts
+{
+  uint64_t channelDeliveries;    //!< Copies of a packet scheduled to a PHY
+  uint64_t enbRxBegin;           //!< Receptions an eNB locked on
+  uint64_t enbReceived;          //!< Receptions an eNB decoded
+  uint64_t enbInterfered;        //!< Receptions lost to interference
+  uint64_t enbUnderSensitivity;  //!< Receptions below the sensitivity
+  uint64_t enbNoMoreReceivers;   //!< Receptions without a free reception path
+};
+
+void
+Count (uint64_t *counter, Ptr<const Packet> packet)
+{
+  (*counter)++;
+}
+
+void
+CountWithNode (uint64_t *counter, Ptr<const Packet> packet, uint32_t node)
+{
+  (*counter)++;
+}
+
+/**
+ * Split a comma separated list of numbers.
+ */
+template <typename T>
+std::vector<T>
+ParseList (const std::string &list)
+{
+  std::vector<T> values;
+  std::istringstream is (list);
+  std::string item;
+  while (std::getline (is, item, ','))
+    {
+      std::istringstream itemIs (item);
+      T value;
+      if (itemIs >> value)
+        {
+          values.push_back (value);
+        }
+    }
+  return values;
+}
+
+/**
+ * Run the simulation for a point of the sweep, and write its JSON object.
+ */
+void
+RunPoint (std::ostream &os, uint32_t nMeters, uint32_t nEnbs, double interval,
+          double duration, double radius, uint32_t seed, std::string traceFile,
+          std::string occupancyPrefix)
+{
+  NS_LOG_INFO ("Running " << nMeters << " meters, " << nEnbs <<
+               " eNBs, an interval of " << interval << " s");
+
+  RngSeedManager::SetRun (seed);
+
+  ObjectFactory schedulerFactory;
+  schedulerFactory.SetTypeId ("ns3::CunbBenchmarkScheduler");
+  Simulator::SetScheduler (schedulerFactory);
+  CunbBenchmarkScheduler::s_nEvents = 0;
+
+  std::chrono::steady_clock::time_point setupStart = std::chrono::steady_clock::now ();
+
+  // Create a simple wireless channel
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  loss->SetPathLossExponent (3.76);
+  loss->SetReference (1, 8.1);
+  Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  Ptr<CunbChannel> channel = CreateObject<CunbChannel> (loss, delay);
+
+  // eNBs, on a square grid covering the disc
+  NodeContainer enbs;
+  enbs.Create (nEnbs);
+  uint32_t side = std::ceil (std::sqrt ((double)nEnbs));
+  double spacing = 2 * radius / side;
+  Ptr<ListPositionAllocator> enbPositions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nEnbs; i++)
+    {
+      enbPositions->Add (Vector (-radius + spacing * (i % side + 0.5),
+                                 -radius + spacing * (i / side + 0.5), 15));
+    }
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (enbPositions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (enbs);
+
+  CunbPhyHelper phyHelper = CunbPhyHelper ();
+  phyHelper.SetChannel (channel);
+  phyHelper.SetDeviceType (CunbPhyHelper::ENB);
+  CunbMacHelper macHelper = CunbMacHelper ();
+  macHelper.SetDeviceType (CunbMacHelper::ENB);
+  macHelper.SetRegion (CunbMacHelper::EU);
+  CunbHelper helper = CunbHelper ();
+  helper.Install (phyHelper, macHelper, enbs);
+
+  // The CUNB server, and the forwarders of the eNBs
+  NodeContainer cunbServers;
+  cunbServers.Create (1);
+  CunbServerHelper cunbServerHelper;
+  cunbServerHelper.SetEnbs (enbs);
+  cunbServerHelper.SetMSs (NodeContainer ());
+  Ptr<SimpleCunbServer> server = DynamicCast<SimpleCunbServer>
+      (cunbServerHelper.Install (cunbServers).Get (0));
+  CunbForwarderHelper forwarderHelper;
+  forwarderHelper.Install (enbs);
+
+  // Only keep the readings in memory
+  Ptr<CunbBufferedReadingSink> sink = CreateObject<CunbBufferedReadingSink> ();
+  server->SetReadingSink (sink);
+
+  // The meters
+  Ptr<CunbMeterPopulation> population = CreateObject<CunbMeterPopulation> ();
+  population->SetAttribute ("ReportingInterval", TimeValue (Seconds (interval)));
+  population->SetChannel (channel);
+  Ptr<UniformDiscPositionAllocator> meterPositions = CreateObject<UniformDiscPositionAllocator> ();
+  meterPositions->SetRho (radius);
+  Ptr<CunbDeviceAddressGenerator> addrGen = CreateObject<CunbDeviceAddressGenerator> (54, 1864);
+  for (uint32_t i = 0; i < nMeters; i++)
+    {
+      population->AddMeter (meterPositions->GetNext (), addrGen->NextAddress ());
+    }
+  server->AddPopulation (population);
+
+  // Count the events of each layer
+  LayerCounts counts = LayerCounts ();
+  channel->TraceConnectWithoutContext
+    ("PacketSent", MakeBoundCallback (&Count, &counts.channelDeliveries));
+  for (uint32_t i = 0; i < nEnbs; i++)
+    {
+      Ptr<CunbPhy> phy = enbs.Get (i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext
+        ("PhyRxBegin", MakeBoundCallback (&Count, &counts.enbRxBegin));
+      phy->TraceConnectWithoutContext
+        ("ReceivedPacket", MakeBoundCallback (&CountWithNode, &counts.enbReceived));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseInterference",
+         MakeBoundCallback (&CountWithNode, &counts.enbInterfered));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseUnderSensitivity",
+         MakeBoundCallback (&CountWithNode, &counts.enbUnderSensitivity));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseNoMoreReceivers",
+         MakeBoundCallback (&CountWithNode, &counts.enbNoMoreReceivers));
+    }
+
+  CunbTraceWriter traceWriter;
+  if (!traceFile.empty ())
+    {
+      traceWriter.Open (traceFile);
+      traceWriter.Install (enbs);
+    }
+
+  Ptr<CunbChannelOccupancy> occupancy = CreateObject<CunbChannelOccupancy> ();
+  if (!occupancyPrefix.empty ())
+    {
+      occupancy->Install (enbs);
+    }
+
+  population->Start ();
+
+  std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now ();
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  traceWriter.Close ();
+
+  std::chrono::steady_clock::time_point runEnd = std::chrono::steady_clock::now ();
+
+  double setupTime = std::chrono::duration<double> (runStart - setupStart).count ();
+  double wallTime = std::chrono::duration<double> (runEnd - runStart).count ();
+  uint64_t nEvents = CunbBenchmarkScheduler::s_nEvents;
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  if (!occupancyPrefix.empty ())
+    {
+      const char *names[CunbChannelOccupancy::N_METRICS] =
+        { "busy", "arrivals", "overlaps", "destroyed", "noMoreReceivers" };
+      for (uint32_t m = 0; m < CunbChannelOccupancy::N_METRICS; m++)
+        {
+          std::ofstream matrix ((occupancyPrefix + "-" + names[m] + ".csv").c_str ());
+          occupancy->PrintMatrix (matrix, CunbChannelOccupancy::Metric (m));
+        }
+    }
+
+  Ptr<CunbServerMetrics> metrics = server->GetMetrics ();
+
+  os << "  {\"meters\": " << nMeters
+     << ", \"enbs\": " << nEnbs
+     << ", \"interval\": " << interval
+     << ", \"duration\": " << duration
+     << ", \"radius\": " << radius
+     << ", \"seed\": " << seed
+     << ", \"setupTime\": " << setupTime
+     << ", \"wallTime\": " << wallTime
+     << ", \"events\": " << nEvents
+     << ", \"eventsPerSecond\": " << (wallTime > 0 ? nEvents / wallTime : 0)
+     << ", \"peakRssKb\": " << usage.ru_maxrss
+     << ", \"traceRecords\": " << traceWriter.GetNRecords ()
+     << ", \"layers\": {"
+     << "\"population\": {\"sent\": " << population->GetNSent () << "}"
+     << ", \"channel\": {\"deliveries\": " << counts.channelDeliveries << "}"
+     << ", \"enbPhy\": {\"rxBegin\": " << counts.enbRxBegin
+     << ", \"received\": " << counts.enbReceived
+     << ", \"interfered\": " << counts.enbInterfered
+     << ", \"underSensitivity\": " << counts.enbUnderSensitivity
+     << ", \"noMoreReceivers\": " << counts.enbNoMoreReceivers << "}"
+     << ", \"server\": {\"readings\": " << sink->GetNRecorded ()
+     << ", \"duplicates\": " << metrics->GetDuplicateCount () << "}"
+     << "}}";
+
+  Simulator::Destroy ();
+}
+
+int main (int argc, char *argv[])
+{
+  std::string meters = "1000,10000,100000";
+  std::string enbCounts = "1,4";
+  std::string intervals = "900";
+  double duration = 900;
+  double radius = 5000;
+  uint32_t seed = 1;
+  std::string output = "";
+  std::string trace = "";
+  std::string occupancy = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("meters", "Comma separated meter counts", meters);
+  cmd.AddValue ("enbs", "Comma separated eNB counts", enbCounts);
+  cmd.AddValue ("intervals", "Comma separated reporting intervals, in s", intervals);
+  cmd.AddValue ("duration", "Simulated time of each run, in s", duration);
+  cmd.AddValue ("radius", "Radius of the disc the meters are spread on, in m", radius);
+  cmd.AddValue ("seed", "Run number of the random number generator", seed);
+  cmd.AddValue ("output", "File the JSON is written to, the standard output if empty", output);
+  cmd.AddValue ("trace", "File the eNB events are traced to, none if empty", trace);
+  cmd.AddValue ("occupancy", "Prefix of the channel occupancy matrices, none if empty",
+                occupancy);
+  cmd.Parse (argc, argv);
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      if (!file.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open " << output);
+          return 1;
+        }
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+
+  std::vector<uint32_t> meterList = ParseList<uint32_t> (meters);
+  std::vector<uint32_t> enbList = ParseList<uint32_t> (enbCounts);
+  std::vector<double> intervalList = ParseList<double> (intervals);
+
+  os << "[" << std::endl;
+  bool first = true;
+  for (uint32_t m = 0; m < meterList.size (); m++)
+    {
+      for (uint32_t e = 0; e < enbList.size (); e++)
+        {
+          for (uint32_t i = 0; i < intervalList.size (); i++)
+            {
+              if (!first)
+                {
+                  os << "," << std::endl;
+                }
+              first = false;
+              RunPoint (os, meterList[m], enbList[e], intervalList[i],
+                        duration, radius, seed, trace, occupancy);
+              os.flush ();
+            }
+        }
+    }
+  os << std::endl << "]" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * This program converts a trace file written by a CunbTraceWriter to CSV,
+ * one line per event, with the columns time (s), node, event, uid,
+ * frequency (MHz) and rxPower (dBm):
+ *
+ *   ./waf --run "cunb-trace-decoder --input=run.trc --output=run.csv"
+ */
+
+#include "ns3/cunb-trace-writer.h"
+#include "ns3/core-module.h"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("CunbTraceDecoder");
+
+int main (int argc, char *argv[])
+{
+  std::string input = "";
+  std::string output = "";
+
+  CommandLine cmd;
+  cmd.AddValue ("input", "Trace file written by a CunbTraceWriter", input);
+  cmd.AddValue ("output", "CSV file, the standard output if empty", output);
+  cmd.Parse (argc, argv);
+
+  std::ofstream file;
+  if (!output.empty ())
+    {
+      file.open (output.c_str ());
+      if (!file.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open " << output);
+          return 1;
+        }
+    }
+  std::ostream &os = output.empty () ? std::cout : file;
+
+  int64_t nRecords = CunbTraceWriter::Decode (input, os);
+  if (nRecords < 0)
+    {
+      NS_LOG_ERROR (input << " is not a CUNB trace file");
+      return 1;
+    }
+  NS_LOG_INFO ("Decoded " << nRecords << " records");
+
+  return 0;
+}
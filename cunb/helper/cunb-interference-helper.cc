@@ -1,4 +1,5 @@
 #include "ns3/cunb-interference-helper.h"
+#include "ns3/cunb-profiler.h"
 #include "ns3/log.h"
 #include <limits>
 
@@ -175,6 +176,8 @@ bool
 CunbInterferenceHelper::IsDestroyedByInterference
   (Ptr<CunbInterferenceHelper::Event> event)
 {
+  CUNB_PROFILE_SCOPE ("CunbInterferenceHelper::IsDestroyedByInterference");
+
   //NS_LOG_FUNCTION (this << event);
 
   //NS_LOG_INFO ("Current number of events in CunbInterferenceHelper: " << m_events.size ());
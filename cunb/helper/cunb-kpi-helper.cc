@@ -0,0 +1,259 @@
+#include "ns3/cunb-kpi-helper.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/cunb-phy.h"
+#include "ns3/cunb-tag.h"
+#include "ns3/cunb-server-metrics.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbKpiHelper");
+
+CunbKpiHelper::CunbKpiHelper () :
+  m_bucketWidth (Seconds (60))
+{
+  for (uint32_t i = 0; i < N_COUNTERS; i++)
+    {
+      m_counters[i] = 0;
+    }
+  SetChannelPlan (868.1, 868.3, 150);
+}
+
+CunbKpiHelper::~CunbKpiHelper ()
+{
+  Simulator::Cancel (m_bucketEvent);
+}
+
+void
+CunbKpiHelper::SetBucketWidth (Time width)
+{
+  NS_ASSERT (width.IsStrictlyPositive ());
+
+  m_bucketWidth = width;
+}
+
+void
+CunbKpiHelper::SetChannelPlan (double startFrequency, double endFrequency,
+                               uint32_t nChannels)
+{
+  NS_ASSERT (endFrequency > startFrequency && nChannels > 0);
+
+  m_startFrequency = startFrequency;
+  m_channelWidth = (endFrequency - startFrequency) / nChannels;
+  m_channelSent.assign (nChannels, 0);
+}
+
+void
+CunbKpiHelper::InstallMeters (NodeContainer meters)
+{
+  NS_LOG_FUNCTION (this << meters.GetN ());
+
+  for (NodeContainer::Iterator i = meters.Begin (); i != meters.End (); ++i)
+    {
+      Ptr<CunbPhy> phy = (*i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext
+        ("StartSending", MakeCallback (&CunbKpiHelper::PacketSent, this));
+    }
+}
+
+void
+CunbKpiHelper::InstallEnbs (NodeContainer enbs)
+{
+  NS_LOG_FUNCTION (this << enbs.GetN ());
+
+  for (NodeContainer::Iterator i = enbs.Begin (); i != enbs.End (); ++i)
+    {
+      Ptr<CunbPhy> phy = (*i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext
+        ("PhyRxBegin", MakeBoundCallback (&Increment, &m_counters[RX_BEGIN]));
+      phy->TraceConnectWithoutContext
+        ("ReceivedPacket",
+         MakeBoundCallback (&IncrementWithNode, &m_counters[RECEIVED]));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseInterference",
+         MakeBoundCallback (&IncrementWithNode, &m_counters[INTERFERED]));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseUnderSensitivity",
+         MakeBoundCallback (&IncrementWithNode, &m_counters[UNDER_SENSITIVITY]));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseNoMoreReceivers",
+         MakeBoundCallback (&IncrementWithNode, &m_counters[NO_MORE_RECEIVERS]));
+
+      Occupancy occupancy = { 0, 0, Simulator::Now ().GetTimeStep (), 0 };
+      m_occupancy.push_back (occupancy);
+      phy->TraceConnectWithoutContext
+        ("OccupiedReceptionPaths",
+         MakeBoundCallback (&OccupancyChanged, &m_occupancy.back ()));
+    }
+}
+
+void
+CunbKpiHelper::InstallServer (Ptr<SimpleCunbServer> server)
+{
+  NS_LOG_FUNCTION (this << server);
+
+  Ptr<CunbServerMetrics> metrics = server->GetMetrics ();
+  metrics->TraceConnectWithoutContext
+    ("FirstWindowReplies", MakeBoundCallback (&AddDelta, &m_counters[ACKS]));
+  metrics->TraceConnectWithoutContext
+    ("SecondWindowReplies", MakeBoundCallback (&AddDelta, &m_counters[ACKS]));
+  metrics->TraceConnectWithoutContext
+    ("ThirdWindowReplies", MakeBoundCallback (&AddDelta, &m_counters[ACKS]));
+  metrics->TraceConnectWithoutContext
+    ("DuplicateCount", MakeBoundCallback (&AddDelta, &m_counters[DUPLICATES]));
+}
+
+bool
+CunbKpiHelper::Start (std::string fileName)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  m_file.open (fileName.c_str (), std::ios::out | std::ios::trunc);
+  if (!m_file.is_open ())
+    {
+      NS_LOG_ERROR ("Cannot create the KPI file " << fileName);
+      return false;
+    }
+
+  m_file << "time,sent,rxBegin,received,interfered,underSensitivity,"
+         << "noMoreReceivers,acks,duplicates";
+  for (uint32_t i = 0; i < m_occupancy.size (); i++)
+    {
+      m_file << ",enb" << i << "PathsMean,enb" << i << "PathsPeak";
+    }
+  for (uint32_t i = 0; i < m_channelSent.size (); i++)
+    {
+      m_file << ",ch" << i;
+    }
+  m_file << std::endl;
+
+  // Start from a clean bucket
+  for (uint32_t i = 0; i < N_COUNTERS; i++)
+    {
+      m_counters[i] = 0;
+    }
+  std::fill (m_channelSent.begin (), m_channelSent.end (), 0);
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  for (uint32_t i = 0; i < m_occupancy.size (); i++)
+    {
+      m_occupancy[i].peak = m_occupancy[i].current;
+      m_occupancy[i].last = now;
+      m_occupancy[i].integral = 0;
+    }
+
+  m_bucketStart = Simulator::Now ();
+  m_bucketEvent = Simulator::Schedule (m_bucketWidth, &CunbKpiHelper::BucketEnded, this);
+  return true;
+}
+
+void
+CunbKpiHelper::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_file.is_open ())
+    {
+      Simulator::Cancel (m_bucketEvent);
+      CloseBucket ();
+      m_file.close ();
+    }
+}
+
+void
+CunbKpiHelper::Increment (uint64_t *counter, Ptr<const Packet> packet)
+{
+  (*counter)++;
+}
+
+void
+CunbKpiHelper::IncrementWithNode (uint64_t *counter, Ptr<const Packet> packet,
+                                  uint32_t nodeId)
+{
+  (*counter)++;
+}
+
+void
+CunbKpiHelper::AddDelta (uint64_t *counter, uint32_t oldValue, uint32_t newValue)
+{
+  // The metrics may be reset: only count increases
+  if (newValue > oldValue)
+    {
+      *counter += newValue - oldValue;
+    }
+}
+
+void
+CunbKpiHelper::OccupancyChanged (Occupancy *occupancy, int oldValue, int newValue)
+{
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  occupancy->integral += (double) occupancy->current * (now - occupancy->last);
+  occupancy->last = now;
+  occupancy->current = newValue;
+  occupancy->peak = std::max (occupancy->peak, newValue);
+}
+
+void
+CunbKpiHelper::PacketSent (Ptr<const Packet> packet, uint32_t nodeId)
+{
+  m_counters[SENT]++;
+
+  CunbTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      double channel = std::floor ((tag.GetFrequency () - m_startFrequency) / m_channelWidth);
+      if (channel >= 0 && channel < m_channelSent.size ())
+        {
+          m_channelSent[(uint32_t) channel]++;
+        }
+    }
+}
+
+void
+CunbKpiHelper::CloseBucket (void)
+{
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  double width = (double) (now - m_bucketStart.GetTimeStep ());
+
+  char value[32];
+  std::snprintf (value, sizeof (value), "%.3f", m_bucketStart.GetSeconds ());
+  m_file << value;
+  for (uint32_t i = 0; i < N_COUNTERS; i++)
+    {
+      m_file << "," << m_counters[i];
+      m_counters[i] = 0;
+    }
+
+  for (uint32_t i = 0; i < m_occupancy.size (); i++)
+    {
+      Occupancy &occupancy = m_occupancy[i];
+      occupancy.integral += (double) occupancy.current * (now - occupancy.last);
+      std::snprintf (value, sizeof (value), "%.3f",
+                     width > 0 ? occupancy.integral / width : occupancy.current);
+      m_file << "," << value << "," << occupancy.peak;
+      occupancy.integral = 0;
+      occupancy.last = now;
+      occupancy.peak = occupancy.current;
+    }
+
+  for (uint32_t i = 0; i < m_channelSent.size (); i++)
+    {
+      m_file << "," << m_channelSent[i];
+      m_channelSent[i] = 0;
+    }
+  m_file << "\n";
+
+  m_bucketStart = Simulator::Now ();
+}
+
+void
+CunbKpiHelper::BucketEnded (void)
+{
+  CloseBucket ();
+  m_bucketEvent = Simulator::Schedule (m_bucketWidth, &CunbKpiHelper::BucketEnded, this);
+}
+
+}
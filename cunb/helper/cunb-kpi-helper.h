@@ -0,0 +1,145 @@
+#ifndef CUNB_KPI_HELPER_H
+#define CUNB_KPI_HELPER_H
+
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/simple-cunb-server.h"
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * This class aggregates the KPIs of a network into fixed time buckets, and
+ * writes one CSV row per bucket to a file while the simulation runs.
+ *
+ * Each row holds, for the bucket that starts at its time:
+ *  - the uplinks sent by the meters, and their receptions at the eNBs by
+ *    outcome;
+ *  - the replies (ACKs) and duplicates of the server;
+ *  - the mean and peak occupied reception paths of each eNB;
+ *  - the uplinks sent on each micro channel of the channel plan.
+ *
+ * Every event costs a counter increment, and nothing is kept per packet,
+ * so that the memory only depends on the number of eNBs and channels.
+ * The frequency of an uplink is the one its CunbTag was given by the MS
+ * PHY; uplinks outside the channel plan are not counted per channel.
+ *
+ * The helper is bound to the traces, and must outlive the simulation.
+ */
+class CunbKpiHelper
+{
+public:
+
+  CunbKpiHelper ();
+
+  ~CunbKpiHelper ();
+
+  /**
+   * Set the duration of a bucket.
+   */
+  void SetBucketWidth (Time width);
+
+  /**
+   * Set the channel plan, as in CunbMacHelper: nChannels micro channels of
+   * equal width between the two frequencies, in MHz.
+   */
+  void SetChannelPlan (double startFrequency, double endFrequency,
+                       uint32_t nChannels);
+
+  /**
+   * Count the uplinks these meters send.
+   */
+  void InstallMeters (NodeContainer meters);
+
+  /**
+   * Count the receptions and the occupied reception paths of these eNBs.
+   */
+  void InstallEnbs (NodeContainer enbs);
+
+  /**
+   * Count the replies and duplicates of this server.
+   */
+  void InstallServer (Ptr<SimpleCunbServer> server);
+
+  /**
+   * Create the file, write its header and start the first bucket. The
+   * meters and eNBs are installed before.
+   *
+   * \return false if the file couldn't be created.
+   */
+  bool Start (std::string fileName);
+
+  /**
+   * Write the current, partial, bucket and close the file.
+   */
+  void Stop (void);
+
+private:
+
+  // Not copyable: the traces are bound to this
+  CunbKpiHelper (const CunbKpiHelper &);
+  CunbKpiHelper & operator= (const CunbKpiHelper &);
+
+  enum Counter
+  {
+    SENT = 0,
+    RX_BEGIN,
+    RECEIVED,
+    INTERFERED,
+    UNDER_SENSITIVITY,
+    NO_MORE_RECEIVERS,
+    ACKS,
+    DUPLICATES,
+    N_COUNTERS
+  };
+
+  /**
+   * The occupied reception paths of an eNB, integrated over the bucket.
+   */
+  struct Occupancy
+  {
+    int current;     //!< Occupied paths now
+    int peak;        //!< Highest value in the bucket
+    int64_t last;    //!< Time of the last change, in time steps
+    double integral; //!< Sum of paths times time steps in the bucket
+  };
+
+  static void Increment (uint64_t *counter, Ptr<const Packet> packet);
+  static void IncrementWithNode (uint64_t *counter, Ptr<const Packet> packet,
+                                 uint32_t nodeId);
+  static void AddDelta (uint64_t *counter, uint32_t oldValue, uint32_t newValue);
+  static void OccupancyChanged (Occupancy *occupancy, int oldValue, int newValue);
+
+  void PacketSent (Ptr<const Packet> packet, uint32_t nodeId);
+
+  /**
+   * Write the row of the current bucket, and clear its counters.
+   */
+  void CloseBucket (void);
+
+  /**
+   * Close the current bucket and schedule the end of the next one.
+   */
+  void BucketEnded (void);
+
+  Time m_bucketWidth;
+  double m_startFrequency;
+  double m_channelWidth;
+
+  uint64_t m_counters[N_COUNTERS];
+  std::vector<uint64_t> m_channelSent;   //!< Uplinks per micro channel
+  std::deque<Occupancy> m_occupancy;     //!< Per eNB, never moved
+
+  std::ofstream m_file;
+  Time m_bucketStart;
+  EventId m_bucketEvent;
+};
+
+} // namespace ns3
+
+#endif /* CUNB_KPI_HELPER_H */
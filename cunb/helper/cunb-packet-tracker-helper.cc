@@ -0,0 +1,441 @@
+#include "ns3/cunb-packet-tracker-helper.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/cunb-phy.h"
+#include "ns3/cunb-mac-header-ul.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbPacketTrackerHelper");
+
+const uint32_t CunbPacketTrackerHelper::BITS_PER_OUTCOME;
+const uint32_t CunbPacketTrackerHelper::OUTCOMES_PER_WORD;
+const uint32_t CunbPacketTrackerHelper::NO_SLOT;
+const uint32_t CunbPacketTrackerHelper::NO_RECEIVER;
+
+CunbPacketTrackerHelper::CunbPacketTrackerHelper () :
+  m_capacity (0),
+  m_nPending (0),
+  m_wordsPerRecord (1),
+  m_nReceivers (0),
+  m_timeout (Seconds (30)),
+  m_nSent (0),
+  m_nRetired (0),
+  m_nDelivered (0),
+  m_nTimedOut (0)
+{
+  for (uint32_t i = 0; i < N_OUTCOMES; i++)
+    {
+      m_outcomeCounts[i] = 0;
+    }
+  Resize (1 << 16);
+}
+
+CunbPacketTrackerHelper::~CunbPacketTrackerHelper ()
+{
+  Simulator::Cancel (m_sweepEvent);
+}
+
+void
+CunbPacketTrackerHelper::SetCapacity (uint32_t capacity)
+{
+  uint32_t slots = 1;
+  while (slots < capacity)
+    {
+      slots <<= 1;
+    }
+  NS_ASSERT_MSG (slots >= m_nPending, "The table can't shrink below its records");
+  Resize (slots);
+}
+
+void
+CunbPacketTrackerHelper::SetTimeout (Time timeout)
+{
+  NS_ASSERT (timeout.IsStrictlyPositive ());
+
+  m_timeout = timeout;
+}
+
+void
+CunbPacketTrackerHelper::InstallReceivers (NodeContainer receivers)
+{
+  NS_LOG_FUNCTION (this << receivers.GetN ());
+
+  NS_ASSERT_MSG (m_nSent == 0, "Receivers are installed before the first send");
+
+  for (NodeContainer::Iterator i = receivers.Begin (); i != receivers.End (); ++i)
+    {
+      uint32_t nodeId = (*i)->GetId ();
+      if (nodeId >= m_receiverIndex.size ())
+        {
+          m_receiverIndex.resize (nodeId + 1, NO_RECEIVER);
+        }
+      if (m_receiverIndex[nodeId] != NO_RECEIVER)
+        {
+          continue;
+        }
+      m_receiverIndex[nodeId] = m_nReceivers++;
+
+      Ptr<CunbPhy> phy = (*i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext
+        ("ReceivedPacket",
+         MakeCallback (&CunbPacketTrackerHelper::ReceptionCallback, this));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseInterference",
+         MakeCallback (&CunbPacketTrackerHelper::InterferenceCallback, this));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseNoMoreReceivers",
+         MakeCallback (&CunbPacketTrackerHelper::NoMoreReceiversCallback, this));
+      phy->TraceConnectWithoutContext
+        ("LostPacketBecauseUnderSensitivity",
+         MakeCallback (&CunbPacketTrackerHelper::UnderSensitivityCallback, this));
+    }
+
+  // The outcomes of a record take more words
+  m_wordsPerRecord = std::max<uint32_t>
+      (1, (m_nReceivers + OUTCOMES_PER_WORD - 1) / OUTCOMES_PER_WORD);
+  m_outcomes.assign (m_capacity * m_wordsPerRecord, 0);
+}
+
+void
+CunbPacketTrackerHelper::InstallTransmitters (NodeContainer transmitters)
+{
+  NS_LOG_FUNCTION (this << transmitters.GetN ());
+
+  for (NodeContainer::Iterator i = transmitters.Begin (); i != transmitters.End (); ++i)
+    {
+      Ptr<CunbPhy> phy = (*i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext
+        ("StartSending",
+         MakeCallback (&CunbPacketTrackerHelper::NotifySent, this));
+    }
+}
+
+uint32_t
+CunbPacketTrackerHelper::GetHome (uint64_t key) const
+{
+  // Fibonacci hashing: consecutive UIDs spread over the table
+  return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (m_capacity - 1);
+}
+
+uint64_t
+CunbPacketTrackerHelper::GetKey (Ptr<const Packet> packet)
+{
+  // Downlinks heard by the receivers have no such header, but their UIDs
+  // match no record anyway
+  CunbMacHeaderUl macHdr;
+  uint8_t repetition = 0;
+  if (packet->GetSize () >= macHdr.GetSerializedSize ())
+    {
+      packet->PeekHeader (macHdr);
+      repetition = macHdr.GetRepCnts ();
+    }
+  return (((uint64_t)packet->GetUid () << 8) | repetition) + 1;
+}
+
+uint32_t
+CunbPacketTrackerHelper::Find (uint64_t key) const
+{
+  for (uint32_t slot = GetHome (key); m_keys[slot] != 0;
+       slot = (slot + 1) & (m_capacity - 1))
+    {
+      if (m_keys[slot] == key)
+        {
+          return slot;
+        }
+    }
+  return NO_SLOT;
+}
+
+void
+CunbPacketTrackerHelper::NotifySent (Ptr<const Packet> packet, uint32_t senderId)
+{
+  NS_ASSERT_MSG (m_nReceivers > 0, "No receivers to follow the packet to");
+
+  m_nSent++;
+
+  // Keep the load under 3/4, first by retiring the stale records
+  if (4 * (m_nPending + 1) > 3 * m_capacity)
+    {
+      Sweep ();
+      if (4 * (m_nPending + 1) > 3 * m_capacity)
+        {
+          Resize (2 * m_capacity);
+        }
+    }
+
+  uint64_t key = GetKey (packet);
+  NS_ASSERT_MSG (Find (key) == NO_SLOT, "Packet " << packet->GetUid () <<
+                 " was sent twice with the same repetition count");
+
+  uint32_t slot = GetHome (key);
+  while (m_keys[slot] != 0)
+    {
+      slot = (slot + 1) & (m_capacity - 1);
+    }
+  m_keys[slot] = key;
+  m_senders[slot] = senderId;
+  m_sendTimes[slot] = Simulator::Now ().GetTimeStep ();
+  m_nOutcomes[slot] = 0;
+  std::fill (m_outcomes.begin () + slot * m_wordsPerRecord,
+             m_outcomes.begin () + (slot + 1) * m_wordsPerRecord, 0);
+  m_nPending++;
+
+  if (!m_sweepEvent.IsRunning ())
+    {
+      m_sweepEvent = Simulator::Schedule (m_timeout,
+                                          &CunbPacketTrackerHelper::Sweep, this);
+    }
+}
+
+void
+CunbPacketTrackerHelper::ReceptionCallback (Ptr<const Packet> packet, uint32_t nodeId)
+{
+  NotifyOutcome (packet, nodeId, RECEIVED);
+}
+
+void
+CunbPacketTrackerHelper::InterferenceCallback (Ptr<const Packet> packet, uint32_t nodeId)
+{
+  NotifyOutcome (packet, nodeId, INTERFERED);
+}
+
+void
+CunbPacketTrackerHelper::NoMoreReceiversCallback (Ptr<const Packet> packet, uint32_t nodeId)
+{
+  NotifyOutcome (packet, nodeId, NO_MORE_RECEIVERS);
+}
+
+void
+CunbPacketTrackerHelper::UnderSensitivityCallback (Ptr<const Packet> packet, uint32_t nodeId)
+{
+  NotifyOutcome (packet, nodeId, UNDER_SENSITIVITY);
+}
+
+void
+CunbPacketTrackerHelper::NotifyOutcome (Ptr<const Packet> packet, uint32_t nodeId,
+                                        enum Outcome outcome)
+{
+  NS_ASSERT (outcome != UNSET && outcome < N_OUTCOMES);
+
+  // Packets of other transmitters, downlinks among them, aren't followed
+  uint32_t slot = Find (GetKey (packet));
+  if (slot == NO_SLOT || nodeId >= m_receiverIndex.size () ||
+      m_receiverIndex[nodeId] == NO_RECEIVER)
+    {
+      return;
+    }
+
+  uint32_t receiver = m_receiverIndex[nodeId];
+  uint64_t &word = m_outcomes[slot * m_wordsPerRecord + receiver / OUTCOMES_PER_WORD];
+  uint32_t shift = (receiver % OUTCOMES_PER_WORD) * BITS_PER_OUTCOME;
+  if (((word >> shift) & 0x7) != UNSET)
+    {
+      NS_LOG_WARN ("Packet " << packet->GetUid () << " has two outcomes at node " << nodeId);
+      return;
+    }
+  word |= (uint64_t)outcome << shift;
+
+  if (++m_nOutcomes[slot] == m_nReceivers)
+    {
+      Retire (slot);
+    }
+}
+
+void
+CunbPacketTrackerHelper::Retire (uint32_t slot)
+{
+  bool delivered = false;
+  for (uint32_t receiver = 0; receiver < m_nReceivers; receiver++)
+    {
+      uint64_t word = m_outcomes[slot * m_wordsPerRecord + receiver / OUTCOMES_PER_WORD];
+      uint32_t outcome = (word >> ((receiver % OUTCOMES_PER_WORD) * BITS_PER_OUTCOME)) & 0x7;
+      m_outcomeCounts[outcome]++;
+      delivered = delivered || outcome == RECEIVED;
+    }
+
+  m_nRetired++;
+  if (delivered)
+    {
+      m_nDelivered++;
+    }
+  if (m_nOutcomes[slot] < m_nReceivers)
+    {
+      m_nTimedOut++;
+    }
+
+  Erase (slot);
+}
+
+void
+CunbPacketTrackerHelper::Erase (uint32_t slot)
+{
+  m_keys[slot] = 0;
+  m_nPending--;
+
+  // Backward shift deletion, so that lookups need no tombstones
+  uint32_t hole = slot;
+  for (uint32_t next = (hole + 1) & (m_capacity - 1); m_keys[next] != 0;
+       next = (next + 1) & (m_capacity - 1))
+    {
+      uint32_t home = GetHome (m_keys[next]);
+      // Move the record unless its home lies cyclically in (hole, next]
+      bool stays = (hole <= next) ? (hole < home && home <= next)
+        : (hole < home || home <= next);
+      if (stays)
+        {
+          continue;
+        }
+
+      m_keys[hole] = m_keys[next];
+      m_senders[hole] = m_senders[next];
+      m_sendTimes[hole] = m_sendTimes[next];
+      m_nOutcomes[hole] = m_nOutcomes[next];
+      std::copy (m_outcomes.begin () + next * m_wordsPerRecord,
+                 m_outcomes.begin () + (next + 1) * m_wordsPerRecord,
+                 m_outcomes.begin () + hole * m_wordsPerRecord);
+      m_keys[next] = 0;
+      hole = next;
+    }
+}
+
+void
+CunbPacketTrackerHelper::Resize (uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+
+  std::vector<uint64_t> keys (capacity, 0);
+  std::vector<uint32_t> senders (capacity);
+  std::vector<int64_t> sendTimes (capacity);
+  std::vector<uint32_t> nOutcomes (capacity);
+  std::vector<uint64_t> outcomes (capacity * m_wordsPerRecord, 0);
+
+  keys.swap (m_keys);
+  senders.swap (m_senders);
+  sendTimes.swap (m_sendTimes);
+  nOutcomes.swap (m_nOutcomes);
+  outcomes.swap (m_outcomes);
+  uint32_t oldCapacity = m_capacity;
+  m_capacity = capacity;
+
+  for (uint32_t old = 0; old < oldCapacity; old++)
+    {
+      if (keys[old] == 0)
+        {
+          continue;
+        }
+      uint32_t slot = GetHome (keys[old]);
+      while (m_keys[slot] != 0)
+        {
+          slot = (slot + 1) & (m_capacity - 1);
+        }
+      m_keys[slot] = keys[old];
+      m_senders[slot] = senders[old];
+      m_sendTimes[slot] = sendTimes[old];
+      m_nOutcomes[slot] = nOutcomes[old];
+      std::copy (outcomes.begin () + old * m_wordsPerRecord,
+                 outcomes.begin () + (old + 1) * m_wordsPerRecord,
+                 m_outcomes.begin () + slot * m_wordsPerRecord);
+    }
+}
+
+void
+CunbPacketTrackerHelper::Sweep (void)
+{
+  int64_t limit = (Simulator::Now () - m_timeout).GetTimeStep ();
+
+  // Erasing moves records back, so the slot is looked at again
+  for (uint32_t slot = 0; slot < m_capacity; )
+    {
+      if (m_keys[slot] != 0 && m_sendTimes[slot] <= limit)
+        {
+          Retire (slot);
+        }
+      else
+        {
+          slot++;
+        }
+    }
+
+  if (m_nPending > 0 && !m_sweepEvent.IsRunning ())
+    {
+      m_sweepEvent = Simulator::Schedule (m_timeout,
+                                          &CunbPacketTrackerHelper::Sweep, this);
+    }
+}
+
+void
+CunbPacketTrackerHelper::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_sweepEvent);
+  for (uint32_t slot = 0; slot < m_capacity; )
+    {
+      if (m_keys[slot] != 0)
+        {
+          Retire (slot);
+        }
+      else
+        {
+          slot++;
+        }
+    }
+}
+
+uint64_t
+CunbPacketTrackerHelper::GetNSent (void) const
+{
+  return m_nSent;
+}
+
+uint64_t
+CunbPacketTrackerHelper::GetNDelivered (void) const
+{
+  return m_nDelivered;
+}
+
+uint64_t
+CunbPacketTrackerHelper::GetNTimedOut (void) const
+{
+  return m_nTimedOut;
+}
+
+uint32_t
+CunbPacketTrackerHelper::GetNPending (void) const
+{
+  return m_nPending;
+}
+
+double
+CunbPacketTrackerHelper::GetPdr (void) const
+{
+  return m_nRetired ? (double)m_nDelivered / m_nRetired : 0;
+}
+
+uint64_t
+CunbPacketTrackerHelper::GetOutcomeCount (enum Outcome outcome) const
+{
+  NS_ASSERT (outcome < N_OUTCOMES);
+
+  return m_outcomeCounts[outcome];
+}
+
+void
+CunbPacketTrackerHelper::PrintStatistics (std::ostream &os) const
+{
+  os << "Sent: " << m_nSent << std::endl;
+  os << "Retired: " << m_nRetired << std::endl;
+  os << "Pending: " << m_nPending << std::endl;
+  os << "Delivered: " << m_nDelivered << std::endl;
+  os << "TimedOut: " << m_nTimedOut << std::endl;
+  os << "PDR: " << GetPdr () << std::endl;
+  os << "Received: " << m_outcomeCounts[RECEIVED] << std::endl;
+  os << "Interfered: " << m_outcomeCounts[INTERFERED] << std::endl;
+  os << "NoMoreReceivers: " << m_outcomeCounts[NO_MORE_RECEIVERS] << std::endl;
+  os << "UnderSensitivity: " << m_outcomeCounts[UNDER_SENSITIVITY] << std::endl;
+  os << "Unset: " << m_outcomeCounts[UNSET] << std::endl;
+}
+
+}
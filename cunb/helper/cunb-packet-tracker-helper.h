@@ -0,0 +1,211 @@
+#ifndef CUNB_PACKET_TRACKER_HELPER_H
+#define CUNB_PACKET_TRACKER_HELPER_H
+
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * This class follows the uplinks of a set of transmitters to a set of
+ * receivers, and aggregates the outcomes of their receptions.
+ *
+ * A record is opened when a transmitter's PHY starts sending a packet, and
+ * is filled in by the outcome traces of the receivers' PHYs. Once every
+ * receiver has an outcome, or after the timeout, the record is accounted
+ * for and retired.
+ *
+ * Records are kept in a preallocated open-addressing table keyed by packet
+ * UID and repetition count, the outcomes packed as 3 bits per receiver, so
+ * that the memory does not depend on the number of transmissions but only
+ * on the packets in flight. The repetitions of an uplink are copies of the
+ * same payload, which keep its UID: each of them is followed as a packet of
+ * its own. A UID is never shared by two senders, so the sender needs no
+ * place in the key.
+ *
+ * Receptions can only end with an outcome at receivers that have a
+ * reception path on the packet's frequency; since EnbCunbPhy reports an
+ * outcome for every packet it starts receiving, all of them do in the eNB
+ * setups of CunbMacHelper.
+ *
+ * The helper is bound to the traces, and must outlive the simulation.
+ */
+class CunbPacketTrackerHelper
+{
+public:
+
+  /**
+   * The outcome of a reception at a receiver.
+   */
+  enum Outcome
+  {
+    UNSET = 0,            //!< No outcome yet
+    RECEIVED,             //!< Correctly received
+    INTERFERED,           //!< Lost because of interference
+    NO_MORE_RECEIVERS,    //!< Lost for lack of a free reception path
+    UNDER_SENSITIVITY,    //!< Lost because below the sensitivity
+    N_OUTCOMES
+  };
+
+  CunbPacketTrackerHelper ();
+
+  ~CunbPacketTrackerHelper ();
+
+  /**
+   * Set the number of records the table holds before it grows. It should
+   * exceed the number of packets in flight at any time.
+   */
+  void SetCapacity (uint32_t capacity);
+
+  /**
+   * Set the time after which a record is retired, even if some receivers
+   * gave no outcome. Their receptions count as UNSET.
+   */
+  void SetTimeout (Time timeout);
+
+  /**
+   * Follow the receptions at these nodes. Receivers are installed before
+   * the first packet is sent.
+   */
+  void InstallReceivers (NodeContainer receivers);
+
+  /**
+   * Follow the packets these nodes send.
+   */
+  void InstallTransmitters (NodeContainer transmitters);
+
+  /**
+   * Open a record for a packet. Called by the StartSending trace of the
+   * transmitters, and usable to follow packets sent by other means.
+   */
+  void NotifySent (Ptr<const Packet> packet, uint32_t senderId);
+
+  /**
+   * Set the outcome of a reception, and retire the record if it was the
+   * last one. Called by the outcome traces of the receivers; packets
+   * without a record are ignored.
+   */
+  void NotifyOutcome (Ptr<const Packet> packet, uint32_t nodeId,
+                      enum Outcome outcome);
+
+  /**
+   * Retire all the records, as if they had timed out.
+   */
+  void Flush (void);
+
+  /**
+   * Get the number of packets sent, each repetition counted.
+   */
+  uint64_t GetNSent (void) const;
+
+  /**
+   * Get the number of retired packets received by at least a receiver.
+   */
+  uint64_t GetNDelivered (void) const;
+
+  /**
+   * Get the number of records retired by the timeout.
+   */
+  uint64_t GetNTimedOut (void) const;
+
+  /**
+   * Get the number of records not retired yet.
+   */
+  uint32_t GetNPending (void) const;
+
+  /**
+   * Get the packet delivery ratio of the retired packets.
+   */
+  double GetPdr (void) const;
+
+  /**
+   * Get the number of receptions with an outcome, over all receivers and
+   * retired packets.
+   */
+  uint64_t GetOutcomeCount (enum Outcome outcome) const;
+
+  /**
+   * Print the statistics, one per line.
+   */
+  void PrintStatistics (std::ostream &os) const;
+
+private:
+
+  // Not copyable: the traces are bound to this
+  CunbPacketTrackerHelper (const CunbPacketTrackerHelper &);
+  CunbPacketTrackerHelper & operator= (const CunbPacketTrackerHelper &);
+
+  static const uint32_t BITS_PER_OUTCOME = 3;
+  static const uint32_t OUTCOMES_PER_WORD = 64 / BITS_PER_OUTCOME;
+  static const uint32_t NO_SLOT = 0xFFFFFFFF;
+  static const uint32_t NO_RECEIVER = 0xFFFFFFFF;
+
+  void ReceptionCallback (Ptr<const Packet> packet, uint32_t nodeId);
+  void InterferenceCallback (Ptr<const Packet> packet, uint32_t nodeId);
+  void NoMoreReceiversCallback (Ptr<const Packet> packet, uint32_t nodeId);
+  void UnderSensitivityCallback (Ptr<const Packet> packet, uint32_t nodeId);
+
+  /**
+   * Get the key of the record of a packet: its UID and the repetition
+   * count of its uplink MAC header, plus one so that 0 marks free slots.
+   */
+  static uint64_t GetKey (Ptr<const Packet> packet);
+
+  /**
+   * Get the slot of a record, or NO_SLOT.
+   */
+  uint32_t Find (uint64_t key) const;
+
+  /**
+   * Account for a record and free its slot.
+   */
+  void Retire (uint32_t slot);
+
+  /**
+   * Free a slot, moving back the records that follow it in their probe
+   * sequence.
+   */
+  void Erase (uint32_t slot);
+
+  /**
+   * Allocate a table of the given capacity and move the records to it.
+   */
+  void Resize (uint32_t capacity);
+
+  /**
+   * Retire the records older than the timeout.
+   */
+  void Sweep (void);
+
+  uint32_t GetHome (uint64_t key) const;
+
+  uint32_t m_capacity;                 //!< Slots in the table, a power of 2
+  uint32_t m_nPending;                 //!< Slots in use
+  std::vector<uint64_t> m_keys;        //!< Key of the record, 0 for a free slot
+  std::vector<uint32_t> m_senders;     //!< Node id of the sender
+  std::vector<int64_t> m_sendTimes;    //!< Time of the send, in time steps
+  std::vector<uint32_t> m_nOutcomes;   //!< Receivers with an outcome
+  std::vector<uint64_t> m_outcomes;    //!< Outcomes, m_wordsPerRecord per slot
+  uint32_t m_wordsPerRecord;
+
+  std::vector<uint32_t> m_receiverIndex; //!< Index of a receiver, by node id
+  uint32_t m_nReceivers;
+
+  Time m_timeout;
+  EventId m_sweepEvent;
+
+  uint64_t m_nSent;
+  uint64_t m_nRetired;
+  uint64_t m_nDelivered;
+  uint64_t m_nTimedOut;
+  uint64_t m_outcomeCounts[N_OUTCOMES];
+};
+
+} // namespace ns3
+
+#endif /* CUNB_PACKET_TRACKER_HELPER_H */
@@ -0,0 +1,387 @@
+#include "ns3/cunb-topology-loader.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/mobility-building-info.h"
+#include "ns3/buildings-helper.h"
+#include "ns3/log.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbTopologyLoader");
+
+static const char TOPOLOGY_MAGIC[8] = { 'C', 'U', 'N', 'B', 'T', 'O', 'P', '1' };
+
+CunbTopologyLoader::CunbTopologyLoader () :
+  m_enbHeight (0),
+  m_buildingInfo (false),
+  m_nSkipped (0)
+{
+}
+
+CunbTopologyLoader::~CunbTopologyLoader ()
+{
+}
+
+void
+CunbTopologyLoader::SetEnbHeight (double height)
+{
+  m_enbHeight = height;
+}
+
+void
+CunbTopologyLoader::SetBuildingInfo (bool buildingInfo)
+{
+  m_buildingInfo = buildingInfo;
+}
+
+bool
+CunbTopologyLoader::Load (std::string fileName)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  int fd = open (fileName.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      NS_LOG_ERROR ("Cannot open the topology file " << fileName);
+      return false;
+    }
+  struct stat st;
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return false;
+    }
+
+  m_meters.clear ();
+  m_enbs.clear ();
+  m_nSkipped = 0;
+
+  size_t size = st.st_size;
+  if (size == 0)
+    {
+      close (fd);
+      return true;
+    }
+
+  void *data = mmap (0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    {
+      NS_LOG_ERROR ("Cannot map the topology file " << fileName);
+      return false;
+    }
+  madvise (data, size, MADV_SEQUENTIAL);
+
+  const char *begin = static_cast<const char *> (data);
+  const char *end = begin + size;
+  bool ok;
+  if (size >= sizeof (TOPOLOGY_MAGIC) &&
+      std::memcmp (begin, TOPOLOGY_MAGIC, sizeof (TOPOLOGY_MAGIC)) == 0)
+    {
+      ok = ReadCache (begin, end);
+    }
+  else
+    {
+      ok = ParseText (begin, end);
+    }
+  munmap (data, size);
+
+  NS_LOG_INFO ("Loaded " << m_meters.size () << " meters and " <<
+               m_enbs.size () << " eNBs from " << fileName);
+  return ok;
+}
+
+/**
+ * Parse a decimal number, with an optional sign, fraction and exponent,
+ * never reading beyond end.
+ */
+static bool
+ParseDouble (const char *&p, const char *end, double &value)
+{
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+      negative = *p == '-';
+      p++;
+    }
+
+  const char *digits = p;
+  double mantissa = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+    {
+      mantissa = mantissa * 10 + (*p++ - '0');
+    }
+  int exponent = 0;
+  if (p < end && *p == '.')
+    {
+      p++;
+      while (p < end && *p >= '0' && *p <= '9')
+        {
+          mantissa = mantissa * 10 + (*p++ - '0');
+          exponent--;
+        }
+    }
+  if (p == digits || (p == digits + 1 && *digits == '.'))
+    {
+      return false;
+    }
+  if (p < end && (*p == 'e' || *p == 'E'))
+    {
+      const char *e = p + 1;
+      bool negativeExponent = false;
+      if (e < end && (*e == '-' || *e == '+'))
+        {
+          negativeExponent = *e == '-';
+          e++;
+        }
+      if (e < end && *e >= '0' && *e <= '9')
+        {
+          // Beyond some 400 any double is 0 or infinite, so the digits
+          // that follow are skipped rather than overflow the count
+          int n = 0;
+          while (e < end && *e >= '0' && *e <= '9')
+            {
+              if (n < 400)
+                {
+                  n = n * 10 + (*e - '0');
+                }
+              e++;
+            }
+          exponent += negativeExponent ? -n : n;
+          p = e;
+        }
+    }
+
+  // Scale by the exact powers of ten, so that short decimals round as
+  // strtod would
+  static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                   1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                   1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+                                   1e22 };
+  while (exponent < -22)
+    {
+      mantissa /= 1e22;
+      exponent += 22;
+    }
+  while (exponent > 22)
+    {
+      mantissa *= 1e22;
+      exponent -= 22;
+    }
+  value = exponent < 0 ? mantissa / powers[-exponent] : mantissa * powers[exponent];
+  if (negative)
+    {
+      value = -value;
+    }
+  return true;
+}
+
+static inline void
+SkipBlanks (const char *&p, const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    {
+      p++;
+    }
+}
+
+bool
+CunbTopologyLoader::ParseText (const char *begin, const char *end)
+{
+  // Rows are some 20 bytes long
+  m_meters.reserve ((end - begin) / 20);
+
+  const char *p = begin;
+  while (p < end)
+    {
+      const char *lineEnd = static_cast<const char *> (std::memchr (p, '\n', end - p));
+      if (lineEnd == 0)
+        {
+          lineEnd = end;
+        }
+
+      SkipBlanks (p, lineEnd);
+      if (p == lineEnd || *p == '#')
+        {
+          p = lineEnd + 1;
+          continue;
+        }
+
+      const char *line = p;
+      double x, y, z = 0;
+      bool ok = ParseDouble (p, lineEnd, x);
+      SkipBlanks (p, lineEnd);
+      ok = ok && ParseDouble (p, lineEnd, y);
+      SkipBlanks (p, lineEnd);
+      bool enb = false;
+      if (ok && ((lineEnd - p >= 3 && std::strncmp (p, "ENB", 3) == 0) ||
+                 (lineEnd - p >= 2 && std::strncmp (p, "GW", 2) == 0)))
+        {
+          enb = true;
+        }
+      else
+        {
+          ok = ok && ParseDouble (p, lineEnd, z);
+        }
+
+      if (!ok)
+        {
+          NS_LOG_WARN ("Skipping the line " << std::string (line, lineEnd - line));
+          m_nSkipped++;
+        }
+      else if (enb)
+        {
+          m_enbs.push_back (Vector (x, y, m_enbHeight));
+        }
+      else
+        {
+          m_meters.push_back (Vector (x, y, z));
+        }
+      p = lineEnd + 1;
+    }
+  return true;
+}
+
+bool
+CunbTopologyLoader::ReadCache (const char *begin, const char *end)
+{
+  const char *p = begin + sizeof (TOPOLOGY_MAGIC);
+  uint64_t counts[2];
+  if (end - p < (ptrdiff_t) sizeof (counts))
+    {
+      NS_LOG_ERROR ("Truncated topology cache");
+      return false;
+    }
+  std::memcpy (counts, p, sizeof (counts));
+  p += sizeof (counts);
+
+  // Compare the counts to the positions the file can hold, one at a time
+  // so that corrupted ones can't overflow the size they make up
+  uint64_t room = (end - p) / (3 * sizeof (double));
+  if (counts[0] > room || counts[1] > room - counts[0])
+    {
+      NS_LOG_ERROR ("Truncated topology cache");
+      return false;
+    }
+
+  std::vector<Vector> *lists[2] = { &m_meters, &m_enbs };
+  for (uint32_t l = 0; l < 2; l++)
+    {
+      lists[l]->resize (counts[l]);
+      for (uint64_t i = 0; i < counts[l]; i++)
+        {
+          double xyz[3];
+          std::memcpy (xyz, p, sizeof (xyz));
+          p += sizeof (xyz);
+          (*lists[l])[i] = Vector (xyz[0], xyz[1], xyz[2]);
+        }
+    }
+  return true;
+}
+
+bool
+CunbTopologyLoader::WriteCache (std::string fileName) const
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  std::FILE *file = std::fopen (fileName.c_str (), "wb");
+  if (file == 0)
+    {
+      NS_LOG_ERROR ("Cannot create the topology cache " << fileName);
+      return false;
+    }
+
+  uint64_t counts[2] = { m_meters.size (), m_enbs.size () };
+  bool ok = std::fwrite (TOPOLOGY_MAGIC, sizeof (TOPOLOGY_MAGIC), 1, file) == 1 &&
+    std::fwrite (counts, sizeof (counts), 1, file) == 1;
+
+  const std::vector<Vector> *lists[2] = { &m_meters, &m_enbs };
+  std::vector<double> block;
+  for (uint32_t l = 0; l < 2 && ok; l++)
+    {
+      block.resize (lists[l]->size () * 3);
+      for (uint32_t i = 0; i < lists[l]->size (); i++)
+        {
+          block[3 * i] = (*lists[l])[i].x;
+          block[3 * i + 1] = (*lists[l])[i].y;
+          block[3 * i + 2] = (*lists[l])[i].z;
+        }
+      ok = block.empty () ||
+        std::fwrite (block.data (), sizeof (double), block.size (), file) == block.size ();
+    }
+
+  ok = (std::fclose (file) == 0) && ok;
+  return ok;
+}
+
+uint32_t
+CunbTopologyLoader::GetNMeters (void) const
+{
+  return m_meters.size ();
+}
+
+uint32_t
+CunbTopologyLoader::GetNEnbs (void) const
+{
+  return m_enbs.size ();
+}
+
+uint32_t
+CunbTopologyLoader::GetNSkipped (void) const
+{
+  return m_nSkipped;
+}
+
+const std::vector<Vector> &
+CunbTopologyLoader::GetMeterPositions (void) const
+{
+  return m_meters;
+}
+
+const std::vector<Vector> &
+CunbTopologyLoader::GetEnbPositions (void) const
+{
+  return m_enbs;
+}
+
+void
+CunbTopologyLoader::InstallMeters (NodeContainer meters) const
+{
+  Install (meters, m_meters);
+}
+
+void
+CunbTopologyLoader::InstallEnbs (NodeContainer enbs) const
+{
+  Install (enbs, m_enbs);
+}
+
+void
+CunbTopologyLoader::Install (NodeContainer nodes,
+                             const std::vector<Vector> &positions) const
+{
+  NS_LOG_FUNCTION (this << nodes.GetN ());
+
+  NS_ASSERT_MSG (nodes.GetN () <= positions.size (), "Only " << positions.size () <<
+                 " positions for " << nodes.GetN () << " nodes");
+
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility =
+        CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (positions[i]);
+      if (m_buildingInfo)
+        {
+          mobility->AggregateObject (CreateObject<MobilityBuildingInfo> ());
+          BuildingsHelper::MakeConsistent (mobility);
+        }
+      nodes.Get (i)->AggregateObject (mobility);
+    }
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef CUNB_TOPOLOGY_LOADER_H
+#define CUNB_TOPOLOGY_LOADER_H
+
+#include "ns3/node-container.h"
+#include "ns3/vector.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * This class loads the positions of the meters and eNBs of a scenario from
+ * a file, and gives the nodes constant position mobility models.
+ *
+ * Text files, such as examples/endDevices.dat, have a node per line: "x y z"
+ * for a meter, "x y ENB" (or "x y GW") for an eNB, whose height is set with
+ * SetEnbHeight. Empty lines and lines starting with '#' are skipped. The
+ * file is memory-mapped and parsed in place, without iostreams.
+ *
+ * Once loaded, the positions can be saved with WriteCache to a binary file,
+ * which Load recognizes and reads back without parsing: the 8-byte magic
+ * "CUNBTOP1", the uint64_t meter and eNB counts, then the x, y, z doubles
+ * of the meters and of the eNBs, all in host byte order.
+ */
+class CunbTopologyLoader
+{
+public:
+
+  CunbTopologyLoader ();
+
+  ~CunbTopologyLoader ();
+
+  /**
+   * Set the height given to the eNBs of text files, in meters.
+   */
+  void SetEnbHeight (double height);
+
+  /**
+   * Aggregate a MobilityBuildingInfo to the mobility models that are
+   * installed, for the buildings propagation loss models.
+   */
+  void SetBuildingInfo (bool buildingInfo);
+
+  /**
+   * Load the positions of a text or cache file, replacing the previous
+   * ones.
+   *
+   * \return false if the file couldn't be read.
+   */
+  bool Load (std::string fileName);
+
+  /**
+   * Save the positions to a binary cache file.
+   *
+   * \return false if the file couldn't be written.
+   */
+  bool WriteCache (std::string fileName) const;
+
+  uint32_t GetNMeters (void) const;
+
+  uint32_t GetNEnbs (void) const;
+
+  /**
+   * Get the number of lines of the last text file that couldn't be parsed.
+   */
+  uint32_t GetNSkipped (void) const;
+
+  const std::vector<Vector> & GetMeterPositions (void) const;
+
+  const std::vector<Vector> & GetEnbPositions (void) const;
+
+  /**
+   * Give the nodes the meter positions, in order. There must be at least
+   * as many positions as nodes.
+   */
+  void InstallMeters (NodeContainer meters) const;
+
+  /**
+   * Give the nodes the eNB positions, in order. There must be at least as
+   * many positions as nodes.
+   */
+  void InstallEnbs (NodeContainer enbs) const;
+
+private:
+
+  bool ParseText (const char *begin, const char *end);
+  bool ReadCache (const char *begin, const char *end);
+  void Install (NodeContainer nodes, const std::vector<Vector> &positions) const;
+
+  double m_enbHeight;
+  bool m_buildingInfo;
+
+  std::vector<Vector> m_meters;
+  std::vector<Vector> m_enbs;
+  uint32_t m_nSkipped;
+};
+
+} // namespace ns3
+
+#endif /* CUNB_TOPOLOGY_LOADER_H */
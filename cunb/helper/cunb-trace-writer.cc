@@ -0,0 +1,278 @@
+#include "ns3/cunb-trace-writer.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/cunb-phy.h"
+#include "ns3/cunb-mac.h"
+#include "ns3/enb-cunb-phy.h"
+#include "ns3/ms-cunb-phy.h"
+#include "ns3/enb-cunb-mac.h"
+#include "ns3/ms-cunb-mac.h"
+#include "ns3/cunb-tag.h"
+#include "ns3/simulator.h"
+#include "ns3/log.h"
+#include <cstdio>
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbTraceWriter");
+
+const uint32_t CunbTraceWriter::RECORD_SIZE;
+
+static const char TRACE_MAGIC[8] = { 'C', 'U', 'N', 'B', 'T', 'R', '0', '1' };
+
+CunbTraceWriter::CunbTraceWriter () :
+  m_used (0),
+  m_nRecords (0)
+{
+  SetBlockSize (1 << 20);
+}
+
+CunbTraceWriter::~CunbTraceWriter ()
+{
+  Close ();
+}
+
+void
+CunbTraceWriter::SetBlockSize (uint32_t blockSize)
+{
+  NS_ASSERT (blockSize >= RECORD_SIZE);
+
+  WriteBlock ();
+  m_block.resize (blockSize - blockSize % RECORD_SIZE);
+}
+
+bool
+CunbTraceWriter::Open (std::string fileName)
+{
+  NS_LOG_FUNCTION (this << fileName);
+
+  Close ();
+  m_file.open (fileName.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file.is_open ())
+    {
+      NS_LOG_ERROR ("Cannot create the trace file " << fileName);
+      return false;
+    }
+  m_file.write (TRACE_MAGIC, sizeof (TRACE_MAGIC));
+  return true;
+}
+
+void
+CunbTraceWriter::Close (void)
+{
+  if (m_file.is_open ())
+    {
+      WriteBlock ();
+      m_file.close ();
+    }
+}
+
+void
+CunbTraceWriter::Install (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator i = nodes.Begin (); i != nodes.End (); ++i)
+    {
+      Install (*i);
+    }
+}
+
+void
+CunbTraceWriter::Install (Ptr<Node> node)
+{
+  NS_LOG_FUNCTION (this << node->GetId ());
+
+  Ptr<CunbNetDevice> device = node->GetDevice (0)->GetObject<CunbNetDevice> ();
+  NS_ASSERT_MSG (device, "Node " << node->GetId () << " has no CUNB device");
+  Ptr<CunbPhy> phy = device->GetPhy ();
+  Ptr<CunbMac> mac = device->GetMac ();
+  uint32_t nodeId = node->GetId ();
+
+  Connect (phy, "StartSending", PHY_TX_START, true, nodeId);
+  Connect (phy, "PhyRxBegin", PHY_RX_BEGIN, false, nodeId);
+  Connect (phy, "ReceivedPacket", PHY_RX_OK, true, nodeId);
+  Connect (phy, "LostPacketBecauseInterference", PHY_LOST_INTERFERENCE, true, nodeId);
+  Connect (phy, "LostPacketBecauseUnderSensitivity", PHY_LOST_UNDER_SENSITIVITY, true, nodeId);
+  if (DynamicCast<EnbCunbPhy> (phy))
+    {
+      Connect (phy, "LostPacketBecauseNoMoreReceivers", PHY_LOST_NO_MORE_RECEIVERS, true, nodeId);
+    }
+  if (DynamicCast<MSCunbPhy> (phy))
+    {
+      Connect (phy, "LostPacketBecauseWrongFrequency", PHY_LOST_WRONG_FREQUENCY, true, nodeId);
+    }
+
+  Connect (mac, "StartSendingData", MAC_TX_START, false, nodeId);
+  Connect (mac, "ReceivedPacket", MAC_RX, false, nodeId);
+  Connect (mac, "CannotSendBecauseDutyCycle", MAC_DUTY_CYCLE, false, nodeId);
+  if (DynamicCast<MSCunbMac> (mac))
+    {
+      Connect (mac, "SentAAResponse", MS_MAC_AA_RESPONSE, false, nodeId);
+      Connect (mac, "HelloSent", MS_MAC_HELLO, false, nodeId);
+      Connect (mac, "HelloResent", MS_MAC_HELLO_RESENT, false, nodeId);
+      Connect (mac, "DataResent", MS_MAC_DATA_RESENT, false, nodeId);
+    }
+  if (DynamicCast<EnbCunbMac> (mac))
+    {
+      Connect (mac, "SentAARequest", ENB_MAC_AA_REQUEST, false, nodeId);
+      Connect (mac, "SentGETRequest", ENB_MAC_GET_REQUEST, false, nodeId);
+      Connect (mac, "SentGroupRequest", ENB_MAC_GROUP_REQUEST, false, nodeId);
+    }
+}
+
+void
+CunbTraceWriter::Connect (Ptr<Object> object, std::string name, uint8_t type,
+                          bool withNode, uint32_t nodeId)
+{
+  Binding binding;
+  binding.writer = this;
+  binding.node = nodeId;
+  binding.type = type;
+  m_bindings.push_back (binding);
+  Binding *bound = &m_bindings.back ();
+
+  bool connected = withNode ?
+    object->TraceConnectWithoutContext
+      (name, MakeBoundCallback (&CunbTraceWriter::PacketNodeEvent, bound)) :
+    object->TraceConnectWithoutContext
+      (name, MakeBoundCallback (&CunbTraceWriter::PacketEvent, bound));
+  NS_ASSERT_MSG (connected, "No trace source " << name);
+}
+
+void
+CunbTraceWriter::PacketEvent (Binding *binding, Ptr<const Packet> packet)
+{
+  binding->writer->Write (binding->node, binding->type, packet);
+}
+
+void
+CunbTraceWriter::PacketNodeEvent (Binding *binding, Ptr<const Packet> packet,
+                                  uint32_t nodeId)
+{
+  binding->writer->Write (binding->node, binding->type, packet);
+}
+
+void
+CunbTraceWriter::Write (uint32_t node, uint8_t type, Ptr<const Packet> packet)
+{
+  if (!m_file.is_open ())
+    {
+      return;
+    }
+
+  int64_t timeNs = Simulator::Now ().GetNanoSeconds ();
+  uint64_t uid = packet->GetUid ();
+  double frequency = 0;
+  double rxPower = 0;
+  CunbTag tag;
+  if (packet->PeekPacketTag (tag))
+    {
+      frequency = tag.GetFrequency ();
+      rxPower = tag.GetReceivePower ();
+    }
+
+  char *p = &m_block[m_used];
+  std::memcpy (p, &timeNs, 8); p += 8;
+  std::memcpy (p, &uid, 8); p += 8;
+  std::memcpy (p, &frequency, 8); p += 8;
+  std::memcpy (p, &rxPower, 8); p += 8;
+  std::memcpy (p, &node, 4); p += 4;
+  std::memcpy (p, &type, 1);
+  m_used += RECORD_SIZE;
+  m_nRecords++;
+
+  if (m_used == m_block.size ())
+    {
+      WriteBlock ();
+    }
+}
+
+void
+CunbTraceWriter::WriteBlock (void)
+{
+  if (m_used > 0 && m_file.is_open ())
+    {
+      m_file.write (m_block.data (), m_used);
+    }
+  m_used = 0;
+}
+
+uint64_t
+CunbTraceWriter::GetNRecords (void) const
+{
+  return m_nRecords;
+}
+
+std::string
+CunbTraceWriter::GetEventName (uint8_t type)
+{
+  static const char *names[N_EVENT_TYPES] = {
+    "PhyTxStart",
+    "PhyRxBegin",
+    "PhyRxOk",
+    "PhyLostInterference",
+    "PhyLostUnderSensitivity",
+    "PhyLostNoMoreReceivers",
+    "PhyLostWrongFrequency",
+    "MacTxStart",
+    "MacRx",
+    "MacDutyCycle",
+    "MsMacAaResponse",
+    "MsMacHello",
+    "MsMacHelloResent",
+    "MsMacDataResent",
+    "EnbMacAaRequest",
+    "EnbMacGetRequest",
+    "EnbMacGroupRequest"
+  };
+
+  return type < N_EVENT_TYPES ? names[type] : "Unknown";
+}
+
+int64_t
+CunbTraceWriter::Decode (std::string fileName, std::ostream &os)
+{
+  std::ifstream file (fileName.c_str (), std::ios::in | std::ios::binary);
+  char magic[sizeof (TRACE_MAGIC)];
+  if (!file.read (magic, sizeof (magic)) ||
+      std::memcmp (magic, TRACE_MAGIC, sizeof (magic)) != 0)
+    {
+      return -1;
+    }
+
+  os << "time,node,event,uid,frequency,rxPower" << std::endl;
+
+  // Read back in blocks, as they were written
+  std::vector<char> block (RECORD_SIZE * 4096);
+  int64_t nRecords = 0;
+  while (file)
+    {
+      file.read (block.data (), block.size ());
+      uint32_t n = file.gcount () / RECORD_SIZE;
+      for (uint32_t i = 0; i < n; i++)
+        {
+          const char *p = &block[i * RECORD_SIZE];
+          int64_t timeNs;
+          uint64_t uid;
+          double frequency;
+          double rxPower;
+          uint32_t node;
+          uint8_t type;
+          std::memcpy (&timeNs, p, 8); p += 8;
+          std::memcpy (&uid, p, 8); p += 8;
+          std::memcpy (&frequency, p, 8); p += 8;
+          std::memcpy (&rxPower, p, 8); p += 8;
+          std::memcpy (&node, p, 4); p += 4;
+          std::memcpy (&type, p, 1);
+
+          char line[160];
+          std::snprintf (line, sizeof (line), "%.9f,%u,%s,%llu,%.6f,%.2f\n",
+                         timeNs / 1e9, node, GetEventName (type).c_str (),
+                         (unsigned long long)uid, frequency, rxPower);
+          os << line;
+        }
+      nRecords += n;
+    }
+  return nRecords;
+}
+
+}
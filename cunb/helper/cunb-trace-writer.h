@@ -0,0 +1,156 @@
+#ifndef CUNB_TRACE_WRITER_H
+#define CUNB_TRACE_WRITER_H
+
+#include "ns3/node-container.h"
+#include "ns3/packet.h"
+#include <deque>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * This class writes the PHY and MAC events of a set of nodes to a binary
+ * file, for offline analysis.
+ *
+ * Each event is a fixed-size record, appended to a preallocated block that
+ * is written to the file when full and when the writer is closed, so that
+ * tracing costs a few memory copies per event. The file starts with the
+ * 8-byte magic "CUNBTR01", followed by records laid out as below, without
+ * padding and in host byte order (8+8+8+8+4+1 = 37 bytes):
+ *
+ *   int64_t  timeNs     simulation time, in nanoseconds
+ *   uint64_t uid        packet UID
+ *   double   frequency  from the packet's CunbTag, in MHz, 0 if unknown
+ *   double   rxPower    from the packet's CunbTag, in dBm, 0 if unknown
+ *   uint32_t node       node id
+ *   uint8_t  event      an EventType
+ *
+ * The PHY traces carry neither the frequency nor the receive power: the
+ * frequency is the one the sender tagged the packet with, and the receive
+ * power is only known for MAC_RX records of eNBs, whose PHY tags the
+ * packets it hands up. The records can be read back with Decode, or as a
+ * structured array by any tool that knows the layout.
+ *
+ * The writer is bound to the traces, and must outlive the simulation.
+ */
+class CunbTraceWriter
+{
+public:
+
+  /**
+   * The type of a traced event.
+   */
+  enum EventType
+  {
+    PHY_TX_START = 0,
+    PHY_RX_BEGIN,
+    PHY_RX_OK,
+    PHY_LOST_INTERFERENCE,
+    PHY_LOST_UNDER_SENSITIVITY,
+    PHY_LOST_NO_MORE_RECEIVERS,
+    PHY_LOST_WRONG_FREQUENCY,
+    MAC_TX_START,
+    MAC_RX,
+    MAC_DUTY_CYCLE,
+    MS_MAC_AA_RESPONSE,
+    MS_MAC_HELLO,
+    MS_MAC_HELLO_RESENT,
+    MS_MAC_DATA_RESENT,
+    ENB_MAC_AA_REQUEST,
+    ENB_MAC_GET_REQUEST,
+    ENB_MAC_GROUP_REQUEST,
+    N_EVENT_TYPES
+  };
+
+  CunbTraceWriter ();
+
+  /**
+   * Close the file, if it is still open.
+   */
+  ~CunbTraceWriter ();
+
+  /**
+   * Set the size of the blocks written to the file, in bytes.
+   */
+  void SetBlockSize (uint32_t blockSize);
+
+  /**
+   * Create the trace file.
+   *
+   * \return false if the file couldn't be created.
+   */
+  bool Open (std::string fileName);
+
+  /**
+   * Write the buffered records and close the file.
+   */
+  void Close (void);
+
+  /**
+   * Trace the events of the CUNB devices of these nodes, eNBs and meters
+   * alike.
+   */
+  void Install (NodeContainer nodes);
+
+  void Install (Ptr<Node> node);
+
+  /**
+   * Get the number of records written or buffered.
+   */
+  uint64_t GetNRecords (void) const;
+
+  /**
+   * Get the name of an event type, as written by Decode.
+   */
+  static std::string GetEventName (uint8_t type);
+
+  /**
+   * Convert a trace file to CSV, with a header line.
+   *
+   * \return the number of records, or -1 if the file isn't a trace file.
+   */
+  static int64_t Decode (std::string fileName, std::ostream &os);
+
+  static const uint32_t RECORD_SIZE = 37;
+
+private:
+
+  // Not copyable: the traces are bound to this
+  CunbTraceWriter (const CunbTraceWriter &);
+  CunbTraceWriter & operator= (const CunbTraceWriter &);
+
+  /**
+   * What a trace sink needs to know about the source it is connected to.
+   */
+  struct Binding
+  {
+    CunbTraceWriter *writer;
+    uint32_t node;
+    uint8_t type;
+  };
+
+  static void PacketEvent (Binding *binding, Ptr<const Packet> packet);
+  static void PacketNodeEvent (Binding *binding, Ptr<const Packet> packet,
+                               uint32_t nodeId);
+
+  void Connect (Ptr<Object> object, std::string name, uint8_t type,
+                bool withNode, uint32_t nodeId);
+
+  void Write (uint32_t node, uint8_t type, Ptr<const Packet> packet);
+
+  void WriteBlock (void);
+
+  std::ofstream m_file;
+  std::vector<char> m_block; //!< Records waiting to be written
+  uint32_t m_used;           //!< Bytes of m_block in use
+  uint64_t m_nRecords;
+
+  std::deque<Binding> m_bindings; //!< Never moved, the traces point to them
+};
+
+} // namespace ns3
+
+#endif /* CUNB_TRACE_WRITER_H */
@@ -0,0 +1,92 @@
+#include "ns3/cunb-adr-engine.h"
+#include "ns3/cunb-mac-command.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbAdrEngine");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbAdrEngine);
+
+TypeId
+CunbAdrEngine::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbAdrEngine")
+    .SetParent<Object> ()
+    .AddConstructor<CunbAdrEngine> ()
+    .AddAttribute ("InstallationMargin",
+                   "Link margin, in dB, a MS is left with after its TX power "
+                   "is lowered",
+                   DoubleValue (10),
+                   MakeDoubleAccessor (&CunbAdrEngine::m_installationMargin),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("MaxTxPowerIndex",
+                   "Largest TX power step a MS can be asked to use, each "
+                   "step lowering its power from the maximum",
+                   UintegerValue (7),
+                   MakeUintegerAccessor (&CunbAdrEngine::m_maxTxPowerIndex),
+                   MakeUintegerChecker<uint8_t> (0, 15))
+    .AddAttribute ("HistoryLength",
+                   "Number of uplinks a decision is based on",
+                   UintegerValue (MSStatus::MARGIN_HISTORY),
+                   MakeUintegerAccessor (&CunbAdrEngine::m_historyLength),
+                   MakeUintegerChecker<uint8_t> (1, MSStatus::MARGIN_HISTORY))
+    .AddTraceSource ("TxPowerChanged",
+                     "A MS was asked to change its TX power",
+                     MakeTraceSourceAccessor (&CunbAdrEngine::m_txPowerChanged),
+                     "ns3::CunbAdrEngine::TxPowerCallback")
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbAdrEngine::CunbAdrEngine () :
+  m_installationMargin (10),
+  m_maxTxPowerIndex (7),
+  m_historyLength (MSStatus::MARGIN_HISTORY)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbAdrEngine::~CunbAdrEngine ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+CunbAdrEngine::Decide (CunbDeviceAddress address, const MSStatus &status,
+                       uint8_t &txPowerIndex)
+{
+  NS_LOG_FUNCTION (this << address);
+
+  if (status.GetNMarginSamples () < m_historyLength)
+    {
+      return false;
+    }
+
+  // Whole power steps the MS can spare (positive) or lacks (negative),
+  // judging from the last HistoryLength uplinks only
+  double margin = status.GetMaxMargin (m_historyLength);
+  double spare = margin - m_installationMargin;
+  int steps = (int) std::floor (spare / LinkAdrReq::TX_POWER_STEP);
+
+  int current = status.GetTxPowerIndex ();
+  int target = std::max (0, std::min<int> (current + steps, m_maxTxPowerIndex));
+
+  if (target == current)
+    {
+      return false;
+    }
+
+  NS_LOG_DEBUG ("MS " << address << ": margin " << margin
+                      << " dB, TX power step " << current << " -> " << target);
+
+  txPowerIndex = target;
+  m_txPowerChanged (address.Get (), current, target);
+  return true;
+}
+
+}
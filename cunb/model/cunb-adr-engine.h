@@ -0,0 +1,65 @@
+#ifndef CUNB_ADR_ENGINE_H
+#define CUNB_ADR_ENGINE_H
+
+#include "ns3/object.h"
+#include "ns3/traced-callback.h"
+#include "ns3/cunb-device-address.h"
+#include "ns3/ms-status.h"
+
+namespace ns3 {
+
+/**
+ * The server side of Adaptive Data Rate.
+ *
+ * For every MS, the server keeps the link margin of its last uplinks in its
+ * MSStatus. Once HistoryLength uplinks have been collected, the engine
+ * compares the best of the last HistoryLength ones with the
+ * InstallationMargin the MS should keep, and asks the MS to lower its TX power by one LinkAdrReq::TX_POWER_STEP
+ * for every step of extra margin, or to raise it for every step missing.
+ *
+ * The uplink bit rate of CUNB is fixed, so the engine only acts on the TX
+ * power, and the LinkAdrReq it sends asks the MS to keep its data rate.
+ */
+class CunbAdrEngine : public Object
+{
+public:
+
+  /**
+   * TracedCallback signature for TX power changes.
+   *
+   * \param address The CunbDeviceAddress of the MS, as an integer.
+   * \param oldTxPowerIndex The TX power step the MS was using.
+   * \param newTxPowerIndex The TX power step the MS is asked to use.
+   */
+  typedef void (* TxPowerCallback)(uint32_t address, uint8_t oldTxPowerIndex,
+                                   uint8_t newTxPowerIndex);
+
+  static TypeId GetTypeId (void);
+
+  CunbAdrEngine ();
+  virtual ~CunbAdrEngine ();
+
+  /**
+   * Decide whether a MS should change its TX power.
+   *
+   * \param address The address of the MS.
+   * \param status What the server knows about the MS.
+   * \param txPowerIndex Set to the TX power step the MS should use, if a
+   * change is needed.
+   * \return True if the MS should be sent a LinkAdrReq.
+   */
+  bool Decide (CunbDeviceAddress address, const MSStatus &status,
+               uint8_t &txPowerIndex);
+
+private:
+
+  double m_installationMargin; //!< Margin kept for fading, in dB
+  uint8_t m_maxTxPowerIndex;   //!< Lowest TX power a MS may be asked to use
+  uint8_t m_historyLength;     //!< Uplinks a decision is based on
+
+  TracedCallback<uint32_t, uint8_t, uint8_t> m_txPowerChanged;
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_ADR_ENGINE_H */
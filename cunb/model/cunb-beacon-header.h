@@ -13,6 +13,15 @@ class CunbBeaconHeader : public Header
 {
 public:
 
+  /**
+   * What the beacon is for, as announced by its Sys Group Type. Either way,
+   * a CunbBeaconPayload follows the header.
+   */
+  enum GroupType
+  {
+    SYSTEM_INFO = 1,  //!< System information, such as the TX power
+    GROUP_REQUEST = 2 //!< A request to a group of MSs, after the payload
+  };
 
   static TypeId GetTypeId (void);
 
@@ -0,0 +1,310 @@
+#include "ns3/cunb-beacon-payload.h"
+#include "ns3/log.h"
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbBeaconPayload");
+
+const uint32_t CunbBeaconPayload::MAX_SIZE;
+
+// Initialization list
+CunbBeaconPayload::CunbBeaconPayload () :
+  m_present (0),
+  m_txPower (0),
+  m_slotCount (0),
+  m_slotDuration (0),
+  m_groupId (0),
+  m_groupSlotCount (0),
+  m_groupSlotDuration (0),
+  m_networkTimeS (0),
+  m_networkTimeMs (0)
+{
+}
+
+CunbBeaconPayload::~CunbBeaconPayload ()
+{
+}
+
+TypeId
+CunbBeaconPayload::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("CunbBeaconPayload")
+    .SetParent<Header> ()
+    .AddConstructor<CunbBeaconPayload> ()
+  ;
+  return tid;
+}
+
+TypeId
+CunbBeaconPayload::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint8_t
+CunbBeaconPayload::GetElementLength (uint8_t type)
+{
+  switch (type)
+    {
+    case TX_POWER:
+      return 1;
+    case SLOT_CONFIG:
+      return 4;
+    case GROUP_INFO:
+      return 6;
+    case NETWORK_TIME:
+      return 6;
+    default:
+      return 0;
+    }
+}
+
+uint32_t
+CunbBeaconPayload::GetSerializedSize (void) const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  // The length byte, then type, length and value of each element
+  uint32_t size = 1;
+  for (uint8_t type = TX_POWER; type <= NETWORK_TIME; type++)
+    {
+      if (m_present & (1 << type))
+        {
+          size += 2 + GetElementLength (type);
+        }
+    }
+  return size;
+}
+
+void
+CunbBeaconPayload::Serialize (Buffer::Iterator start) const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  start.WriteU8 (GetSerializedSize () - 1);
+
+  for (uint8_t type = TX_POWER; type <= NETWORK_TIME; type++)
+    {
+      if (!(m_present & (1 << type)))
+        {
+          continue;
+        }
+
+      start.WriteU8 (type);
+      start.WriteU8 (GetElementLength (type));
+      switch (type)
+        {
+        case TX_POWER:
+          start.WriteU8 ((uint8_t)m_txPower);
+          break;
+        case SLOT_CONFIG:
+          start.WriteU16 (m_slotCount);
+          start.WriteU16 (m_slotDuration);
+          break;
+        case GROUP_INFO:
+          start.WriteU16 (m_groupId);
+          start.WriteU16 (m_groupSlotCount);
+          start.WriteU16 (m_groupSlotDuration);
+          break;
+        case NETWORK_TIME:
+          start.WriteU32 (m_networkTimeS);
+          start.WriteU16 (m_networkTimeMs);
+          break;
+        }
+    }
+}
+
+uint32_t
+CunbBeaconPayload::Deserialize (Buffer::Iterator start)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  m_present = 0;
+
+  uint8_t length = start.ReadU8 ();
+  uint8_t consumed = 0;
+
+  // Every element takes at least its type and length bytes
+  while (consumed + 2 <= length)
+    {
+      uint8_t type = start.ReadU8 ();
+      uint8_t elementLength = start.ReadU8 ();
+      consumed += 2;
+
+      if (consumed + elementLength > length)
+        {
+          NS_LOG_WARN ("Truncated beacon element of type " << unsigned (type));
+          break;
+        }
+      consumed += elementLength;
+
+      if (elementLength == 0 || elementLength != GetElementLength (type))
+        {
+          NS_LOG_DEBUG ("Skipping beacon element of type " << unsigned (type));
+          start.Next (elementLength);
+          continue;
+        }
+
+      switch (type)
+        {
+        case TX_POWER:
+          m_txPower = (int8_t)start.ReadU8 ();
+          break;
+        case SLOT_CONFIG:
+          m_slotCount = start.ReadU16 ();
+          m_slotDuration = start.ReadU16 ();
+          break;
+        case GROUP_INFO:
+          m_groupId = start.ReadU16 ();
+          m_groupSlotCount = start.ReadU16 ();
+          m_groupSlotDuration = start.ReadU16 ();
+          break;
+        case NETWORK_TIME:
+          m_networkTimeS = start.ReadU32 ();
+          m_networkTimeMs = start.ReadU16 ();
+          break;
+        }
+      m_present |= 1 << type;
+    }
+
+  // Skip whatever doesn't make a whole element
+  start.Next (length - consumed);
+
+  return 1 + length;   // the number of bytes consumed.
+}
+
+void
+CunbBeaconPayload::Print (std::ostream &os) const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  if (Has (TX_POWER))
+    {
+      os << "TxPower=" << GetTxPower () << "dBm" << std::endl;
+    }
+  if (Has (SLOT_CONFIG))
+    {
+      os << "SlotCount=" << m_slotCount << std::endl;
+      os << "SlotDuration=" << GetSlotDuration ().GetSeconds () << "s" << std::endl;
+    }
+  if (Has (GROUP_INFO))
+    {
+      os << "GroupId=" << m_groupId << std::endl;
+      os << "GroupSlotCount=" << m_groupSlotCount << std::endl;
+      os << "GroupSlotDuration=" << GetGroupSlotDuration ().GetSeconds () << "s" << std::endl;
+    }
+  if (Has (NETWORK_TIME))
+    {
+      os << "NetworkTime=" << GetNetworkTime ().GetSeconds () << "s" << std::endl;
+    }
+}
+
+bool
+CunbBeaconPayload::Has (enum ElementType type) const
+{
+  return m_present & (1 << type);
+}
+
+void
+CunbBeaconPayload::Clear (void)
+{
+  m_present = 0;
+}
+
+uint16_t
+CunbBeaconPayload::ToUnits (Time duration)
+{
+  int64_t units = duration.GetMilliSeconds () / 10;
+  NS_ASSERT_MSG (units >= 0 && units <= 0xFFFF, "Duration out of range");
+
+  return units;
+}
+
+Time
+CunbBeaconPayload::FromUnits (uint16_t units)
+{
+  return MilliSeconds (10 * units);
+}
+
+void
+CunbBeaconPayload::SetTxPower (double txPowerDbm)
+{
+  NS_ASSERT (txPowerDbm >= -128 && txPowerDbm <= 127);
+
+  m_txPower = (int8_t)std::floor (txPowerDbm + 0.5);
+  m_present |= 1 << TX_POWER;
+}
+
+double
+CunbBeaconPayload::GetTxPower (void) const
+{
+  return m_txPower;
+}
+
+void
+CunbBeaconPayload::SetSlotConfig (uint16_t slotCount, Time slotDuration)
+{
+  m_slotCount = slotCount;
+  m_slotDuration = ToUnits (slotDuration);
+  m_present |= 1 << SLOT_CONFIG;
+}
+
+uint16_t
+CunbBeaconPayload::GetSlotCount (void) const
+{
+  return m_slotCount;
+}
+
+Time
+CunbBeaconPayload::GetSlotDuration (void) const
+{
+  return FromUnits (m_slotDuration);
+}
+
+void
+CunbBeaconPayload::SetGroupInfo (uint16_t groupId, uint16_t slotCount,
+                                 Time slotDuration)
+{
+  m_groupId = groupId;
+  m_groupSlotCount = slotCount;
+  m_groupSlotDuration = ToUnits (slotDuration);
+  m_present |= 1 << GROUP_INFO;
+}
+
+uint16_t
+CunbBeaconPayload::GetGroupId (void) const
+{
+  return m_groupId;
+}
+
+uint16_t
+CunbBeaconPayload::GetGroupSlotCount (void) const
+{
+  return m_groupSlotCount;
+}
+
+Time
+CunbBeaconPayload::GetGroupSlotDuration (void) const
+{
+  return FromUnits (m_groupSlotDuration);
+}
+
+void
+CunbBeaconPayload::SetNetworkTime (Time networkTime)
+{
+  int64_t ms = networkTime.GetMilliSeconds ();
+  NS_ASSERT (ms >= 0);
+
+  m_networkTimeS = ms / 1000;
+  m_networkTimeMs = ms % 1000;
+  m_present |= 1 << NETWORK_TIME;
+}
+
+Time
+CunbBeaconPayload::GetNetworkTime (void) const
+{
+  return Seconds (m_networkTimeS) + MilliSeconds (m_networkTimeMs);
+}
+
+}
@@ -0,0 +1,146 @@
+#ifndef CUNB_BEACON_PAYLOAD_H
+#define CUNB_BEACON_PAYLOAD_H
+
+#include "ns3/header.h"
+#include "ns3/nstime.h"
+
+namespace ns3 {
+
+/**
+ * This class represents the payload of a beacon, which follows its
+ * CunbBeaconHeader.
+ *
+ * The payload is a length byte followed by a sequence of TLV (type, length,
+ * value) elements, each of them optional. Elements of an unknown type, or
+ * whose length doesn't match their type, are skipped, so that receivers keep
+ * working when new elements are added. All fields are held by value, so that
+ * encoding and decoding a beacon never allocates memory, and decoding takes
+ * a bounded time, since a payload is at most MAX_SIZE bytes long.
+ *
+ * Durations travel in units of 10 ms, and are therefore rounded down to a
+ * multiple of that.
+ */
+class CunbBeaconPayload : public Header
+{
+public:
+
+  /**
+   * The types of the TLV elements.
+   */
+  enum ElementType
+  {
+    TX_POWER = 1,     //!< Highest TX power of the MSs: 8 bits, dBm, signed
+    SLOT_CONFIG = 2,  //!< Superframe: 16 bits slot count, 16 bits slot duration
+    GROUP_INFO = 3,   //!< Group downlink: 16 bits group id, 16 bits slot
+                      //!count, 16 bits slot duration
+    NETWORK_TIME = 4  //!< Time of the network: 32 bits seconds, 16 bits ms
+  };
+
+  CunbBeaconPayload ();
+  ~CunbBeaconPayload ();
+
+  // Methods inherited from Header
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  /**
+   * Return the size required for serialization of this payload
+   *
+   * \return The serialized size in bytes
+   */
+  virtual uint32_t GetSerializedSize (void) const;
+
+  /**
+   * Serialize the payload, only writing the elements that were set.
+   *
+   * \param start A pointer to the buffer that will be filled with the
+   * serialization.
+   */
+  virtual void Serialize (Buffer::Iterator start) const;
+
+  /**
+   * Deserialize the contents of the buffer into a CunbBeaconPayload object.
+   *
+   * \param start A pointer to the buffer we need to deserialize.
+   * \return The number of consumed bytes.
+   */
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+
+  /**
+   * Print the payload in a human-readable format.
+   *
+   * \param os The std::ostream on which to print the payload.
+   */
+  virtual void Print (std::ostream &os) const;
+
+  /**
+   * Check whether the payload holds an element of the given type.
+   */
+  bool Has (enum ElementType type) const;
+
+  /**
+   * Drop all elements.
+   */
+  void Clear (void);
+
+  void SetTxPower (double txPowerDbm);
+
+  double GetTxPower (void) const;
+
+  /**
+   * Announce a superframe of slotCount uplink slots starting with the
+   * beacon. A slotCount of 0 tells the MSs to use pure ALOHA.
+   */
+  void SetSlotConfig (uint16_t slotCount, Time slotDuration);
+
+  uint16_t GetSlotCount (void) const;
+
+  Time GetSlotDuration (void) const;
+
+  /**
+   * Address a request to a group of MSs, which answer in slotCount response
+   * slots starting with the beacon.
+   */
+  void SetGroupInfo (uint16_t groupId, uint16_t slotCount, Time slotDuration);
+
+  uint16_t GetGroupId (void) const;
+
+  uint16_t GetGroupSlotCount (void) const;
+
+  Time GetGroupSlotDuration (void) const;
+
+  void SetNetworkTime (Time networkTime);
+
+  Time GetNetworkTime (void) const;
+
+  /**
+   * The largest size of the serialized payload, length byte included.
+   */
+  static const uint32_t MAX_SIZE = 256;
+
+private:
+
+  /**
+   * Get the length of the value of the elements of the given type.
+   */
+  static uint8_t GetElementLength (uint8_t type);
+
+  static uint16_t ToUnits (Time duration);
+
+  static Time FromUnits (uint16_t units);
+
+  uint8_t m_present; //!< Bit i set if the element of type i is present
+
+  int8_t m_txPower;
+  uint16_t m_slotCount;
+  uint16_t m_slotDuration; // In units of 10 ms
+  uint16_t m_groupId;
+  uint16_t m_groupSlotCount;
+  uint16_t m_groupSlotDuration; // In units of 10 ms
+  uint32_t m_networkTimeS;
+  uint16_t m_networkTimeMs;
+};
+
+}
+
+#endif
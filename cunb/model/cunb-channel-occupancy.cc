@@ -0,0 +1,212 @@
+#include "ns3/cunb-channel-occupancy.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/enb-cunb-phy.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbChannelOccupancy");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbChannelOccupancy);
+
+TypeId
+CunbChannelOccupancy::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbChannelOccupancy")
+    .SetParent<Object> ()
+    .AddConstructor<CunbChannelOccupancy> ()
+    .AddAttribute ("StartFrequency",
+                   "Lower edge of the channel plan, in MHz",
+                   DoubleValue (868.1),
+                   MakeDoubleAccessor (&CunbChannelOccupancy::m_startFrequency),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("EndFrequency",
+                   "Upper edge of the channel plan, in MHz",
+                   DoubleValue (868.3),
+                   MakeDoubleAccessor (&CunbChannelOccupancy::m_endFrequency),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("Channels",
+                   "Number of micro channels in the plan",
+                   UintegerValue (150),
+                   MakeUintegerAccessor (&CunbChannelOccupancy::m_nChannels),
+                   MakeUintegerChecker<uint32_t> (1))
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbChannelOccupancy::CunbChannelOccupancy ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbChannelOccupancy::~CunbChannelOccupancy ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbChannelOccupancy::Install (NodeContainer enbs)
+{
+  NS_LOG_FUNCTION (this << enbs.GetN ());
+
+  for (NodeContainer::Iterator i = enbs.Begin (); i != enbs.End (); ++i)
+    {
+      Ptr<EnbCunbPhy> phy = DynamicCast<EnbCunbPhy>
+          ((*i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ());
+      NS_ASSERT_MSG (phy, "Node " << (*i)->GetId () << " is not an eNB");
+
+      phy->SetChannelOccupancy (this, m_nodeIds.size ());
+      m_nodeIds.push_back ((*i)->GetId ());
+    }
+
+  Cell empty = { 0, 0, 0, 0, 0, 0 };
+  m_cells.resize (m_nodeIds.size () * m_nChannels, empty);
+}
+
+CunbChannelOccupancy::Cell *
+CunbChannelOccupancy::GetCell (uint32_t row, double frequencyMHz)
+{
+  NS_ASSERT (row < m_nodeIds.size ());
+
+  double channel = std::floor ((frequencyMHz - m_startFrequency) * m_nChannels /
+                               (m_endFrequency - m_startFrequency));
+  if (channel < 0 || channel >= m_nChannels)
+    {
+      return 0;
+    }
+  return &m_cells[row * m_nChannels + (uint32_t) channel];
+}
+
+void
+CunbChannelOccupancy::NotifyArrival (uint32_t row, double frequencyMHz, Time duration)
+{
+  Cell *cell = GetCell (row, frequencyMHz);
+  if (cell == 0)
+    {
+      return;
+    }
+
+  // Signals arrive in time order, so the union of their intervals only
+  // needs the end of the latest one
+  int64_t start = Simulator::Now ().GetTimeStep ();
+  int64_t end = start + duration.GetTimeStep ();
+  if (start < cell->busyUntil)
+    {
+      cell->overlaps++;
+      cell->busy += std::max<int64_t> (0, end - cell->busyUntil);
+    }
+  else
+    {
+      cell->busy += end - start;
+    }
+  cell->busyUntil = std::max (cell->busyUntil, end);
+  cell->arrivals++;
+}
+
+void
+CunbChannelOccupancy::NotifyDestroyed (uint32_t row, double frequencyMHz)
+{
+  Cell *cell = GetCell (row, frequencyMHz);
+  if (cell != 0)
+    {
+      cell->destroyed++;
+    }
+}
+
+void
+CunbChannelOccupancy::NotifyNoMoreReceivers (uint32_t row, double frequencyMHz)
+{
+  Cell *cell = GetCell (row, frequencyMHz);
+  if (cell != 0)
+    {
+      cell->noMoreReceivers++;
+    }
+}
+
+uint32_t
+CunbChannelOccupancy::GetNEnbs (void) const
+{
+  return m_nodeIds.size ();
+}
+
+uint32_t
+CunbChannelOccupancy::GetNChannels (void) const
+{
+  return m_nChannels;
+}
+
+double
+CunbChannelOccupancy::GetChannelFrequency (uint32_t channel) const
+{
+  double width = (m_endFrequency - m_startFrequency) / m_nChannels;
+  return m_startFrequency + (channel + 0.5) * width;
+}
+
+double
+CunbChannelOccupancy::GetValue (enum Metric metric, uint32_t row, uint32_t channel) const
+{
+  NS_ASSERT (row < m_nodeIds.size () && channel < m_nChannels);
+
+  const Cell &cell = m_cells[row * m_nChannels + channel];
+  switch (metric)
+    {
+    case BUSY_TIME:
+      return TimeStep (cell.busy).GetSeconds ();
+    case ARRIVALS:
+      return cell.arrivals;
+    case OVERLAPS:
+      return cell.overlaps;
+    case DESTROYED:
+      return cell.destroyed;
+    case NO_MORE_RECEIVERS:
+      return cell.noMoreReceivers;
+    default:
+      NS_ASSERT_MSG (false, "Unknown metric " << metric);
+      return 0;
+    }
+}
+
+void
+CunbChannelOccupancy::PrintMatrix (std::ostream &os, enum Metric metric) const
+{
+  // Micro channels are a few kHz apart
+  std::streamsize precision = os.precision (9);
+  os << "node";
+  for (uint32_t channel = 0; channel < m_nChannels; channel++)
+    {
+      os << "," << GetChannelFrequency (channel);
+    }
+  os << std::endl;
+  os.precision (precision);
+
+  for (uint32_t row = 0; row < m_nodeIds.size (); row++)
+    {
+      os << m_nodeIds[row];
+      for (uint32_t channel = 0; channel < m_nChannels; channel++)
+        {
+          os << "," << GetValue (metric, row, channel);
+        }
+      os << std::endl;
+    }
+}
+
+void
+CunbChannelOccupancy::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Keep the end of the signals on the air, for the next overlaps
+  for (uint32_t i = 0; i < m_cells.size (); i++)
+    {
+      int64_t busyUntil = m_cells[i].busyUntil;
+      Cell empty = { busyUntil, 0, 0, 0, 0, 0 };
+      m_cells[i] = empty;
+    }
+}
+
+}
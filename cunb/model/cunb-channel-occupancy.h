@@ -0,0 +1,131 @@
+#ifndef CUNB_CHANNEL_OCCUPANCY_H
+#define CUNB_CHANNEL_OCCUPANCY_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+#include <ostream>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * Per micro channel and per eNB statistics of the uplink receptions.
+ *
+ * The EnbCunbPhys this object is installed on notify it of every signal
+ * they start receiving, of every reception destroyed by interference and
+ * of every signal they had no free reception path for. For each eNB and
+ * each micro channel of the channel plan, this object accumulates:
+ *  - the busy time, during which at least a signal was on the air;
+ *  - the arrivals, signals under the sensitivity included, since they
+ *    still interfere;
+ *  - the overlaps, arrivals while another signal was on the air;
+ *  - the receptions destroyed by interference;
+ *  - the signals lost for lack of a free reception path.
+ *
+ * Every notification is O(1), and the statistics can be printed as one
+ * matrix per metric, an eNB per row and a micro channel per column.
+ */
+class CunbChannelOccupancy : public Object
+{
+public:
+
+  enum Metric
+  {
+    BUSY_TIME = 0,      //!< In seconds
+    ARRIVALS,
+    OVERLAPS,
+    DESTROYED,
+    NO_MORE_RECEIVERS,
+    N_METRICS
+  };
+
+  static TypeId GetTypeId (void);
+
+  CunbChannelOccupancy ();
+  virtual ~CunbChannelOccupancy ();
+
+  /**
+   * Observe the receptions of these eNBs. Each eNB gets the next row of
+   * the matrices.
+   */
+  void Install (NodeContainer enbs);
+
+  /**
+   * A signal started arriving at an eNB.
+   */
+  void NotifyArrival (uint32_t row, double frequencyMHz, Time duration);
+
+  /**
+   * A reception at an eNB was destroyed by interference.
+   */
+  void NotifyDestroyed (uint32_t row, double frequencyMHz);
+
+  /**
+   * A signal arrived at an eNB that had no free reception path for it.
+   */
+  void NotifyNoMoreReceivers (uint32_t row, double frequencyMHz);
+
+  /**
+   * Get the number of eNBs, i.e., of rows.
+   */
+  uint32_t GetNEnbs (void) const;
+
+  /**
+   * Get the number of micro channels, i.e., of columns.
+   */
+  uint32_t GetNChannels (void) const;
+
+  /**
+   * Get the center frequency of a micro channel, in MHz.
+   */
+  double GetChannelFrequency (uint32_t channel) const;
+
+  /**
+   * Get a metric for an eNB and a micro channel.
+   */
+  double GetValue (enum Metric metric, uint32_t row, uint32_t channel) const;
+
+  /**
+   * Print the matrix of a metric as CSV: a header with the channel center
+   * frequencies, then a row per eNB, starting with its node id.
+   */
+  void PrintMatrix (std::ostream &os, enum Metric metric) const;
+
+  /**
+   * Bring all statistics back to zero.
+   */
+  void Reset (void);
+
+private:
+
+  /**
+   * The statistics of an eNB on a micro channel.
+   */
+  struct Cell
+  {
+    int64_t busyUntil;   //!< End of the latest signal, in time steps
+    int64_t busy;        //!< Busy time, in time steps
+    uint64_t arrivals;
+    uint64_t overlaps;
+    uint64_t destroyed;
+    uint64_t noMoreReceivers;
+  };
+
+  /**
+   * Get the cell of a notification, or 0 if the frequency is not in the
+   * channel plan.
+   */
+  Cell * GetCell (uint32_t row, double frequencyMHz);
+
+  double m_startFrequency;  //!< Lower edge of the channel plan, in MHz
+  double m_endFrequency;    //!< Upper edge of the channel plan, in MHz
+  uint32_t m_nChannels;     //!< Micro channels in the plan
+
+  std::vector<uint32_t> m_nodeIds; //!< Node id of the eNB of each row
+  std::vector<Cell> m_cells;       //!< m_nChannels cells per row
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_CHANNEL_OCCUPANCY_H */
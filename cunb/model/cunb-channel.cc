@@ -19,6 +19,7 @@
  */
 
 #include "ns3/cunb-channel.h"
+#include "ns3/cunb-profiler.h"
 #include "ns3/log.h"
 #include "ns3/pointer.h"
 #include "ns3/object-factory.h"
@@ -119,6 +120,8 @@ CunbChannel::Send (Ptr< CunbPhy > sender, Ptr< Packet > packet,
                    double txPowerDbm, CunbTxParameters txParams,
                    Time duration, double frequencyMHz) const
 {
+  CUNB_PROFILE_SCOPE ("CunbChannel::Send");
+
   NS_LOG_FUNCTION (this << sender << packet << txPowerDbm << txParams << duration << frequencyMHz);
 
   // Get the mobility model of the sender
@@ -4,6 +4,7 @@
 #include "ns3/header.h"
 #include "ns3/cunb-device-address.h"
 #include "ns3/cunb-mac-command.h"
+#include <list>
 
 namespace ns3 {
 
@@ -14,6 +15,12 @@ namespace ns3 {
  * implementation considers them as a unique entity (i.e., FPort is treated as
  * if it were a part of FHDR).
  *
+ * The header is made of the device address and the FPort. When there are
+ * options, the highest bit of the FPort byte is set, and it is followed by a
+ * FCtrl byte whose 4 lowest bits hold the length of the options (FOptsLen)
+ * and by up to MAX_FOPTS_LENGTH bytes of MAC commands (FOpts). A header
+ * without options thus takes the same 5 bytes as before FOpts existed.
+ *
  * \remark Prior to using it, this class needs to be informed of whether the
  * header is for an uplink or downlink message. This is necessary due to the
  * fact that UL and DL messages have subtly different structure and, hence,
@@ -66,7 +73,7 @@ public:
   /**
    * Set the FPort value.
    *
-   * \param fPort The FPort to set.
+   * \param fPort The FPort to set, below 128.
    */
   void SetFPort (uint8_t fPort);
 
@@ -91,9 +98,44 @@ public:
    */
   CunbDeviceAddress GetAddress (void) const;
 
+  /**
+   * Add a MAC command to the options (FOpts) of this header.
+   *
+   * \param command The command to add.
+   * \param budget The number of option bytes the frame can afford, at most
+   * MAX_FOPTS_LENGTH.
+   * \return True if the command fit in the budget and was added.
+   */
+  bool AddCommand (Ptr<CunbMacCommand> command,
+                   uint8_t budget = MAX_FOPTS_LENGTH);
+
+  /**
+   * Get the MAC commands carried by this header.
+   */
+  const std::list<Ptr<CunbMacCommand> > & GetCommands (void) const;
+
+  /**
+   * Get the number of bytes taken by the options.
+   */
+  uint8_t GetFOptsLength (void) const;
+
+  /**
+   * The largest number of option bytes a header can carry, as it must fit
+   * in the 4 bits of FOptsLen.
+   */
+  static const uint8_t MAX_FOPTS_LENGTH = 15;
+
+  /**
+   * The bit of the FPort byte telling that FCtrl and FOpts follow, which
+   * leaves 7 bits to the FPort itself.
+   */
+  static const uint8_t FCTRL_PRESENT = 0x80;
+
 private:
 
   uint8_t m_fPort;
+  uint8_t m_fOptsLen; //!< Bytes taken by m_commands
+  std::list<Ptr<CunbMacCommand> > m_commands; //!< The options (FOpts)
   CunbDeviceAddress m_address;
 
 };
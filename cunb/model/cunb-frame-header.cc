@@ -1,14 +1,19 @@
 #include "ns3/cunb-frame-header.h"
 #include "ns3/log.h"
 #include <bitset>
+#include <algorithm>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("CunbFrameHeader");
 
+const uint8_t CunbFrameHeader::MAX_FOPTS_LENGTH;
+const uint8_t CunbFrameHeader::FCTRL_PRESENT;
+
 // Initialization list
 CunbFrameHeader::CunbFrameHeader () :
   m_fPort     (0),
+  m_fOptsLen  (0),
   m_address   (CunbDeviceAddress (0,0))
 {
 }
@@ -38,8 +43,8 @@ CunbFrameHeader::GetSerializedSize (void) const
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-
-  return 5;
+  // Address and FPort, then FCtrl and FOpts if there are options
+  return m_fOptsLen > 0 ? 6 + m_fOptsLen : 5;
 }
 
 void
@@ -49,8 +54,20 @@ CunbFrameHeader::Serialize (Buffer::Iterator start) const
 
   // Device Address field
   start.WriteU32 (m_address.Get ());
-  // FPort
-  start.WriteU8 (m_fPort);
+  // FPort, whose highest bit tells whether FCtrl follows
+  start.WriteU8 (m_fPort | (m_fOptsLen > 0 ? FCTRL_PRESENT : 0));
+  if (m_fOptsLen == 0)
+    {
+      return;
+    }
+  // FCtrl, only holding FOptsLen
+  start.WriteU8 (m_fOptsLen & 0x0f);
+  // FOpts
+  std::list<Ptr<CunbMacCommand> >::const_iterator it;
+  for (it = m_commands.begin (); it != m_commands.end (); ++it)
+    {
+      (*it)->Serialize (start);
+    }
 }
 
 uint32_t
@@ -61,12 +78,33 @@ CunbFrameHeader::Deserialize (Buffer::Iterator start)
   // Read from buffer and save into local variables
   m_address.Set (start.ReadU32 ());
 
-  NS_LOG_DEBUG ("Deserialized data: ");
-  NS_LOG_DEBUG ("Address: " << m_address.Print ());
-
-  m_fPort = uint8_t (start.ReadU8 ());
-
-  return 5;   // the number of bytes consumed.
+  uint8_t fPort = start.ReadU8 ();
+  m_fPort = fPort & ~FCTRL_PRESENT;
+  m_fOptsLen = 0;
+  m_commands.clear ();
+  if ((fPort & FCTRL_PRESENT) == 0)
+    {
+      return 5;
+    }
+
+  m_fOptsLen = start.ReadU8 () & 0x0f;
+
+  // Read the commands until the options are over
+  uint8_t consumed = 0;
+  while (consumed < m_fOptsLen)
+    {
+      Ptr<CunbMacCommand> command = CunbMacCommand::DeserializeCommand (start, true);
+      if (command == 0)
+        {
+          // Nothing after an unknown command can be read, skip the rest
+          start.Next (m_fOptsLen - consumed);
+          break;
+        }
+      consumed += command->GetSerializedSize ();
+      m_commands.push_back (command);
+    }
+
+  return 6 + m_fOptsLen;   // the number of bytes consumed.
 }
 
 void
@@ -76,11 +114,17 @@ CunbFrameHeader::Print (std::ostream &os) const
 
   os << "Address=" << m_address.Print () << std::endl;
   os << "FPort=" << unsigned(m_fPort) << std::endl;
+  std::list<Ptr<CunbMacCommand> >::const_iterator it;
+  for (it = m_commands.begin (); it != m_commands.end (); ++it)
+    {
+      (*it)->Print (os);
+    }
 }
 
 void
 CunbFrameHeader::SetFPort (uint8_t fPort)
 {
+  NS_ASSERT_MSG ((fPort & FCTRL_PRESENT) == 0, "The FPort only has 7 bits");
   m_fPort = fPort;
 }
 
@@ -102,4 +146,32 @@ CunbFrameHeader::GetAddress (void) const
   return m_address;
 }
 
+bool
+CunbFrameHeader::AddCommand (Ptr<CunbMacCommand> command, uint8_t budget)
+{
+  NS_LOG_FUNCTION (this << command);
+
+  budget = std::min (budget, MAX_FOPTS_LENGTH);
+  if (m_fOptsLen + command->GetSerializedSize () > budget)
+    {
+      return false;
+    }
+
+  m_commands.push_back (command);
+  m_fOptsLen += command->GetSerializedSize ();
+  return true;
+}
+
+const std::list<Ptr<CunbMacCommand> > &
+CunbFrameHeader::GetCommands (void) const
+{
+  return m_commands;
+}
+
+uint8_t
+CunbFrameHeader::GetFOptsLength (void) const
+{
+  return m_fOptsLen;
+}
+
 }
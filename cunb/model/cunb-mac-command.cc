@@ -7,6 +7,9 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("CunbMacCommand");
 
+constexpr double LinkAdrReq::TX_POWER_STEP;
+const uint8_t LinkAdrReq::KEEP_DATA_RATE;
+
 NS_OBJECT_ENSURE_REGISTERED (CunbMacCommand);
 
 TypeId
@@ -1180,4 +1183,72 @@ TxParamSetupAns::Print (std::ostream &os) const
   os << "TxParamSetupAns" << std::endl;
 }
 
+///////////////////////////////
+// Command (de)serialization //
+///////////////////////////////
+
+Ptr<CunbMacCommand>
+CunbMacCommand::DeserializeCommand (Buffer::Iterator &start, bool downlink)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  // Peek the CID, the command itself consumes it
+  Buffer::Iterator peek = start;
+  uint8_t cid = peek.ReadU8 ();
+
+  Ptr<CunbMacCommand> command;
+  switch (cid)
+    {
+    case 0x02:
+      command = downlink ? Ptr<CunbMacCommand> (Create<LinkCheckAns> ())
+        : Ptr<CunbMacCommand> (Create<LinkCheckReq> ());
+      break;
+    case 0x03:
+      command = downlink ? Ptr<CunbMacCommand> (Create<LinkAdrReq> ())
+        : Ptr<CunbMacCommand> (Create<LinkAdrAns> ());
+      break;
+    case 0x04:
+      command = downlink ? Ptr<CunbMacCommand> (Create<DutyCycleReq> ())
+        : Ptr<CunbMacCommand> (Create<DutyCycleAns> ());
+      break;
+    case 0x05:
+      command = downlink ? Ptr<CunbMacCommand> (Create<RxParamSetupReq> ())
+        : Ptr<CunbMacCommand> (Create<RxParamSetupAns> ());
+      break;
+    case 0x06:
+      command = downlink ? Ptr<CunbMacCommand> (Create<DevStatusReq> ())
+        : Ptr<CunbMacCommand> (Create<DevStatusAns> ());
+      break;
+    case 0x07:
+      command = downlink ? Ptr<CunbMacCommand> (Create<NewChannelReq> ())
+        : Ptr<CunbMacCommand> (Create<NewChannelAns> ());
+      break;
+    case 0x08:
+      command = downlink ? Ptr<CunbMacCommand> (Create<RxTimingSetupReq> ())
+        : Ptr<CunbMacCommand> (Create<RxTimingSetupAns> ());
+      break;
+    case 0x09:
+      command = downlink ? Ptr<CunbMacCommand> (Create<TxParamSetupReq> ())
+        : Ptr<CunbMacCommand> (Create<TxParamSetupAns> ());
+      break;
+    case 0x0A:
+      if (!downlink)
+        {
+          command = Create<DlChannelAns> ();
+        }
+      break;
+    default:
+      break;
+    }
+
+  if (command == 0)
+    {
+      NS_LOG_WARN ("Unknown CID " << unsigned (cid));
+      return 0;
+    }
+
+  command->Deserialize (start);
+  return command;
+}
+
 }
@@ -92,6 +92,18 @@ public:
    */
   static uint8_t GetCIDFromMacCommand (enum MacCommandType commandType);
 
+  /**
+   * Create the MAC command whose CID is at the iterator, and deserialize it.
+   *
+   * \param start The iterator, moved past the command.
+   * \param downlink Whether the command was sent by the server, which tells
+   * requests from answers, since they share the same CID.
+   * \return The command, or 0 if the CID is unknown, in which case the
+   * iterator is left untouched.
+   */
+  static Ptr<CunbMacCommand> DeserializeCommand (Buffer::Iterator &start,
+                                                 bool downlink);
+
 protected:
 
   /**
@@ -238,6 +250,17 @@ public:
    */
   int GetRepetitions (void);
 
+  /**
+   * The TX power encoded as 0 is the maximum TX power of the device, and
+   * every step above lowers it by this amount, in dB.
+   */
+  static constexpr double TX_POWER_STEP = 2;
+
+  /**
+   * Data rate value that asks the device to keep its current data rate.
+   */
+  static const uint8_t KEEP_DATA_RATE = 0xF;
+
 private:
   uint8_t m_dataRate;
   uint8_t m_txPower;
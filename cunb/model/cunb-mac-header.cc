@@ -7,7 +7,7 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("CunbMacHeader");
 
-CunbMacHeader::CunbMacHeader():m_preamble(3),m_mtype(7),m_payload_size(4),m_ack_bits(34)
+CunbMacHeader::CunbMacHeader():m_preamble(3),m_mtype(7),m_payload_size(4),m_ack_bits(34),m_link_margin(0),m_enb_count(0)
 {
 
 }
@@ -55,7 +55,11 @@ CunbMacHeader::Serialize (Buffer::Iterator start) const
 
     header |= m_payload_size*(uint64_t)pow(2,32);
 
-    header |= m_ack_bits;
+    header |= m_link_margin*(uint64_t)pow(2,24);
+
+    header |= m_enb_count*(uint64_t)pow(2,16);
+
+    header |= m_ack_bits & 0xffff;
 
     // Write the byte
     start.WriteU64 (header);
@@ -76,6 +80,10 @@ CunbMacHeader::Deserialize (Buffer::Iterator start)
     // Get the 2 least significant bits to have the Major
     m_ack_bits = data & 0xffff;
 
+    m_enb_count = (data >> 16) & 0xff;
+
+    m_link_margin = (data >> 24) & 0xff;
+
     m_preamble = (data >> 48) & 0xf;
 
     m_mtype = (data >> 40) & 0xf;
@@ -92,6 +100,8 @@ CunbMacHeader::Print (std::ostream &os) const
   os << "Preamble=" << unsigned(m_preamble) << std::endl;
   os << "MType=" << unsigned(m_mtype) << std::endl;
   os << "PayloadSize=" << unsigned(m_payload_size) << std::endl;
+  os << "LinkMargin=" << unsigned(m_link_margin) << std::endl;
+  os << "EnbCount=" << unsigned(m_enb_count) << std::endl;
 }
 
 
@@ -183,5 +193,37 @@ CunbMacHeader::GetAckBits (void) const
   return m_ack_bits;
 }
 
+void
+CunbMacHeader::SetLinkMargin (uint8_t margin)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  m_link_margin = margin;
+}
+
+uint8_t
+CunbMacHeader::GetLinkMargin (void) const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  return m_link_margin;
+}
+
+void
+CunbMacHeader::SetEnbCount (uint8_t enbCount)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  m_enb_count = enbCount;
+}
+
+uint8_t
+CunbMacHeader::GetEnbCount (void) const
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  return m_enb_count;
+}
+
 
 }
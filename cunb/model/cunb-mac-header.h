@@ -92,6 +92,20 @@ public:
 
    uint64_t GetData(void) const;
 
+   /**
+    * Set the demodulation margin, in dB, the server measured on the uplink
+    * this header answers.
+    */
+   void SetLinkMargin (uint8_t margin);
+   uint8_t GetLinkMargin (void) const;
+
+   /**
+    * Set the number of eNBs the server knows to hear the MS, zero if the
+    * header carries no link information.
+    */
+   void SetEnbCount (uint8_t enbCount);
+   uint8_t GetEnbCount (void) const;
+
 
 private:
 
@@ -101,13 +115,16 @@ private:
    *    a. a preamble for frame detection and bit rate synchronization
    *    b. a frame type
    *    c. a payload length
-   *    d. acknowledgement bits
+   *    d. acknowledgement bits (16 bits)
+   *    e. eNB count and link margin (8 bits each)
    */
 
   uint8_t m_preamble;
   uint8_t m_mtype;
   uint8_t m_payload_size;
   uint32_t m_ack_bits;
+  uint8_t m_link_margin;
+  uint8_t m_enb_count;
 
   uint64_t m_data;
 
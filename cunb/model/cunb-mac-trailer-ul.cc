@@ -1,4 +1,5 @@
 #include "cunb-mac-trailer-ul.h"
+#include "ns3/cunb-profiler.h"
 #include <ns3/packet.h>
 #include "crypto++/aes.h"
 #include "crypto++/modes.h"
@@ -90,6 +91,8 @@ CunbMacTrailerUl::GetFcsUl (void) const
 void
 CunbMacTrailerUl::SetFcsUl (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailerUl::SetFcsUl");
+
   if (m_calcFcs)
     {
       uint16_t size = p->GetSize ();
@@ -109,6 +112,8 @@ CunbMacTrailerUl::SetFcsUl (Ptr<const Packet> p)
 bool
 CunbMacTrailerUl::CheckFcsUl (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailerUl::CheckFcsUl");
+
   if (!m_calcFcs)
     {
       return true;
@@ -149,6 +154,8 @@ CunbMacTrailerUl::GetAuthUl(void) const
 void
 CunbMacTrailerUl::SetAuthUl (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailerUl::SetAuthUl");
+
 	// Implementation of SHA-1 Hash
 
 	// as the Hash returns 128 bits, we use only the last 16 bits
@@ -165,6 +172,8 @@ CunbMacTrailerUl::SetAuthUl (Ptr<const Packet> p)
 bool
 CunbMacTrailerUl::CheckAuthUl (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailerUl::CheckAuthUl");
+
 	uint16_t checkAuth;
     uint16_t size = p->GetSize ();
 	uint8_t *serial_packet = new uint8_t[size];
@@ -1,4 +1,5 @@
 #include "cunb-mac-trailer.h"
+#include "ns3/cunb-profiler.h"
 #include <ns3/packet.h>
 #include "crypto++/aes.h"
 #include "crypto++/modes.h"
@@ -87,6 +88,8 @@ CunbMacTrailer::GetFcs (void) const
 void
 CunbMacTrailer::SetFcs (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::SetFcs");
+
   if (m_calcFcs)
     {
       uint16_t size = p->GetSize ();
@@ -119,6 +122,8 @@ CunbMacTrailer::SetMacHeader(CunbMacHeaderUl macHdr)
 bool
 CunbMacTrailer::CheckFcs (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::CheckFcs");
+
   if (!m_calcFcs)
     {
       return true;
@@ -158,6 +163,8 @@ CunbMacTrailer::GetAuth(void) const
 void
 CunbMacTrailer::SetAuth (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::SetAuth");
+
 	// Implementation of SHA-1 Hash
 
 	// as the Hash returns 128 bits, we use only the last 16 bits
@@ -176,6 +183,8 @@ CunbMacTrailer::SetAuth (Ptr<const Packet> p)
 
 bool CunbMacTrailer::CheckAuth (Ptr<const Packet> p)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::CheckAuth");
+
 	uint16_t checkAuth;
 	uint16_t size = p->GetSize ();
 	uint8_t *serial_packet = new uint8_t[size];
@@ -195,6 +204,8 @@ bool CunbMacTrailer::CheckAuth (Ptr<const Packet> p)
 void
 CunbMacTrailer::SetAuthDL (Ptr<const Packet> p, uint8_t seqCnt, uint16_t ident)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::SetAuthDL");
+
 	// Implementation of SHA-1 Hash
 
 	// as the Hash returns 128 bits, we use only the last 16 bits
@@ -212,6 +223,8 @@ CunbMacTrailer::SetAuthDL (Ptr<const Packet> p, uint8_t seqCnt, uint16_t ident)
 
 bool CunbMacTrailer::CheckAuthDL (Ptr<const Packet> p, uint8_t seqCnt, uint16_t ident)
 {
+  CUNB_PROFILE_SCOPE ("CunbMacTrailer::CheckAuthDL");
+
 	uint16_t checkAuth;
 	uint16_t size = p->GetSize ();
 	uint8_t *serial_packet = new uint8_t[size];
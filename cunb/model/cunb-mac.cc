@@ -1,5 +1,7 @@
 #include "ns3/cunb-mac.h"
+#include "ns3/cunb-frame-header.h"
 #include "ns3/log.h"
+#include <algorithm>
 
 namespace ns3 {
 
@@ -123,6 +125,25 @@ CunbMac::SetMaxAppPayloadForDataRate (std::vector<uint32_t> maxAppPayloadForData
   m_maxAppPayloadForDataRate = maxAppPayloadForDataRate;
 }
 
+uint8_t
+CunbMac::GetFOptsBudget (uint8_t dataRate, uint32_t payloadSize) const
+{
+  NS_LOG_FUNCTION (this << unsigned (dataRate) << payloadSize);
+
+  uint32_t budget = CunbFrameHeader::MAX_FOPTS_LENGTH;
+
+  // Without a payload limit for this DataRate, only FOptsLen bounds the options
+  if (dataRate < m_maxAppPayloadForDataRate.size ())
+    {
+      // Options also bring the FCtrl byte along
+      uint32_t maxPayload = m_maxAppPayloadForDataRate[dataRate];
+      budget = (payloadSize + 1 >= maxPayload) ? 0
+        : std::min (budget, maxPayload - payloadSize - 1);
+    }
+
+  return budget;
+}
+
 void
 CunbMac::SetTxDbmForTxPower (std::vector<double> txDbmForTxPower)
 {
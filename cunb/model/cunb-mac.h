@@ -150,6 +150,17 @@ public:
   void SetMaxAppPayloadForDataRate (std::vector<uint32_t>
                                     maxAppPayloadForDataRate);
 
+  /**
+   * Get the number of bytes a frame sent at a given DataRate can spend on
+   * piggy-backed MAC commands (FOpts), given the size of its payload.
+   *
+   * \param dataRate The DataRate the frame will be sent at.
+   * \param payloadSize The size of the frame's payload, in bytes.
+   * \return The room left by the payload and the FCtrl byte, at most
+   * CunbFrameHeader::MAX_FOPTS_LENGTH.
+   */
+  uint8_t GetFOptsBudget (uint8_t dataRate, uint32_t payloadSize) const;
+
   /**
    * Set the vector to use to check up which transmission power in Dbm
    * corresponds to a certain TxPower value in this MAC's region.
@@ -0,0 +1,321 @@
+#include "ns3/cunb-meter-population.h"
+#include "ns3/cunb-mac-header-ul.h"
+#include "ns3/cunb-mac-trailer.h"
+#include "ns3/cunb-frame-header-ul.h"
+#include "ns3/cunb-linklayer-header.h"
+#include "ns3/app-layer-header.h"
+#include "ns3/new-cosem-header.h"
+#include "ns3/cunb-tag.h"
+#include "ns3/simulator.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbMeterPopulation");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbMeterPopulation);
+
+TypeId
+CunbMeterPopulation::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbMeterPopulation")
+    .SetParent<Object> ()
+    .AddConstructor<CunbMeterPopulation> ()
+    .AddAttribute ("ReportingInterval",
+                   "Time between two reports of a meter",
+                   TimeValue (Seconds (60)),
+                   MakeTimeAccessor (&CunbMeterPopulation::m_reportingInterval),
+                   MakeTimeChecker (MilliSeconds (1)))
+    .AddAttribute ("TxPower",
+                   "TX power of the meters, in dBm",
+                   DoubleValue (14),
+                   MakeDoubleAccessor (&CunbMeterPopulation::m_txPower),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("Padding",
+                   "Bytes appended to each reading, as MobileAutonomousReporting "
+                   "does with a random packet size",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&CunbMeterPopulation::m_padding),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("NChannels",
+                   "Number of uplink micro channels the band is divided in",
+                   UintegerValue (150),
+                   MakeUintegerAccessor (&CunbMeterPopulation::m_nChannels),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("StartFrequency",
+                   "Lower edge of the uplink band, in MHz",
+                   DoubleValue (868.1),
+                   MakeDoubleAccessor (&CunbMeterPopulation::m_startFrequency),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("EndFrequency",
+                   "Upper edge of the uplink band, in MHz",
+                   DoubleValue (868.3),
+                   MakeDoubleAccessor (&CunbMeterPopulation::m_endFrequency),
+                   MakeDoubleChecker<double> ())
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbMeterPopulation::CunbMeterPopulation () :
+  m_reportingInterval (Seconds (60)),
+  m_txPower (14),
+  m_padding (0),
+  m_nChannels (150),
+  m_startFrequency (868.1),
+  m_endFrequency (868.3),
+  m_nSent (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_mobility = CreateObject<ConstantPositionMobilityModel> ();
+  m_phy = CreateObject<MSCunbPhy> ();
+  m_phy->SetMobility (m_mobility);
+  m_rng = CreateObject<UniformRandomVariable> ();
+}
+
+CunbMeterPopulation::~CunbMeterPopulation ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbMeterPopulation::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_event);
+  m_channel = 0;
+  m_phy = 0;
+  m_mobility = 0;
+
+  Object::DoDispose ();
+}
+
+void
+CunbMeterPopulation::SetChannel (Ptr<CunbChannel> channel)
+{
+  m_channel = channel;
+}
+
+uint32_t
+CunbMeterPopulation::AddMeter (const Vector &position,
+                               CunbDeviceAddress address)
+{
+  NS_ASSERT_MSG (!m_event.IsRunning (), "Meters are added before Start");
+
+  uint32_t i = m_address.size ();
+  m_x.push_back (position.x);
+  m_y.push_back (position.y);
+  m_z.push_back (position.z);
+  m_address.push_back (address.Get ());
+  // As the examples do, from 1 on; the addresses stay unique when this wraps
+  m_ident.push_back ((i + 1) & 0xFFFF);
+  m_seqCnt.push_back (0);
+  m_nextReport.push_back (0);
+
+  return i;
+}
+
+uint32_t
+CunbMeterPopulation::GetNMeters (void) const
+{
+  return m_address.size ();
+}
+
+Vector
+CunbMeterPopulation::GetPosition (uint32_t i) const
+{
+  NS_ASSERT (i < m_address.size ());
+
+  return Vector (m_x[i], m_y[i], m_z[i]);
+}
+
+CunbDeviceAddress
+CunbMeterPopulation::GetAddress (uint32_t i) const
+{
+  NS_ASSERT (i < m_address.size ());
+
+  return CunbDeviceAddress (m_address[i]);
+}
+
+uint16_t
+CunbMeterPopulation::GetIdent (uint32_t i) const
+{
+  NS_ASSERT (i < m_address.size ());
+
+  return m_ident[i];
+}
+
+uint64_t
+CunbMeterPopulation::GetNSent (void) const
+{
+  return m_nSent;
+}
+
+int64_t
+CunbMeterPopulation::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+
+  m_rng->SetStream (stream);
+  return 1;
+}
+
+void
+CunbMeterPopulation::Start (void)
+{
+  NS_LOG_FUNCTION (this << m_address.size ());
+
+  NS_ASSERT_MSG (m_channel != 0, "The population has no channel to send on");
+
+  Simulator::Cancel (m_event);
+  if (m_address.empty ())
+    {
+      return;
+    }
+
+  ComputeFrequencies ();
+
+  // Spread the first reports over the first interval
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  double interval = m_reportingInterval.GetTimeStep ();
+  m_heap.resize (m_address.size ());
+  for (uint32_t i = 0; i < m_address.size (); i++)
+    {
+      m_nextReport[i] = now + (int64_t) m_rng->GetValue (0, interval);
+      m_heap[i] = i;
+    }
+
+  LaterReport later = { &m_nextReport };
+  std::make_heap (m_heap.begin (), m_heap.end (), later);
+
+  ScheduleNext ();
+}
+
+void
+CunbMeterPopulation::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_event);
+}
+
+void
+CunbMeterPopulation::ComputeFrequencies (void)
+{
+  // Same steps as CunbMacHelper
+  m_frequencies.clear ();
+  double step = (m_endFrequency - m_startFrequency) / m_nChannels;
+  double start = m_startFrequency;
+  for (uint32_t i = 0; i < m_nChannels; i++)
+    {
+      double end = start + step;
+      m_frequencies.push_back ((start + end) / 2);
+      start = start + step;
+    }
+}
+
+void
+CunbMeterPopulation::ScheduleNext (void)
+{
+  Time delay = TimeStep (m_nextReport[m_heap.front ()]) - Simulator::Now ();
+  m_event = Simulator::Schedule (delay, &CunbMeterPopulation::SendDueReports,
+                                 this);
+}
+
+void
+CunbMeterPopulation::SendDueReports (void)
+{
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  int64_t interval = m_reportingInterval.GetTimeStep ();
+  LaterReport later = { &m_nextReport };
+
+  CunbTxParameters params;
+  params.bitrate = 250; // bit rate for uplink is 250bps
+  params.nPreamble = 8;
+  params.eccEnabled = 1;
+  params.authEnabled = 1;
+  params.fcsEnabled = 1;
+
+  while (m_nextReport[m_heap.front ()] <= now)
+    {
+      std::pop_heap (m_heap.begin (), m_heap.end (), later);
+      uint32_t i = m_heap.back ();
+
+      Ptr<Packet> packet = BuildReport (i);
+      Time duration = CunbPhy::GetOnAirTime (packet, params, MS);
+
+      CunbTag tag;
+      packet->AddPacketTag (tag);
+
+      uint32_t channel = m_rng->GetInteger (0, m_nChannels - 1);
+      double frequency = m_frequencies[channel];
+
+      // The channel reads the position of the sender while sending
+      m_mobility->SetPosition (GetPosition (i));
+      m_channel->Send (m_phy, packet, m_txPower, params, duration, frequency);
+      m_nSent++;
+
+      m_nextReport[i] += interval;
+      std::push_heap (m_heap.begin (), m_heap.end (), later);
+    }
+
+  ScheduleNext ();
+}
+
+Ptr<Packet>
+CunbMeterPopulation::BuildReport (uint32_t i)
+{
+  Ptr<Packet> packet = Create<Packet> (m_padding);
+
+  // The GET Response of MobileAutonomousReporting
+  NewCosemGetResponseNormalHeader cosemHdr;
+  cosemHdr.SetInvokeIdAndPriority (2);
+  cosemHdr.SetData (789);
+  cosemHdr.SetDataAccessResult (0); // Success {0}
+  packet->AddHeader (cosemHdr);
+
+  NewTypeAPDU typeHdr;
+  typeHdr.SetApduType ((ApduType)cosemHdr.GetIdApdu ());
+  packet->AddHeader (typeHdr);
+
+  AppLayerHeader appHdr;
+  appHdr.SetPtype (1);
+  packet->AddHeader (appHdr);
+
+  NewCosemWrapperHeader wrapperHdr;
+  wrapperHdr.SetSrcwPort (80);
+  wrapperHdr.SetDstwPort (90);
+  wrapperHdr.SetLength (packet->GetSize ());
+  packet->AddHeader (wrapperHdr);
+
+  // The headers of MSCunbMac::Send
+  CunbLinkLayerHeader llHdr;
+  packet->AddHeader (llHdr);
+
+  CunbFrameHeaderUl frameHdr;
+  frameHdr.SetFPort (1);
+  frameHdr.SetAddress (CunbDeviceAddress (m_address[i]));
+  packet->AddHeader (frameHdr);
+
+  CunbMacHeaderUl macHdr;
+  macHdr.SetMType (CunbMacHeaderUl::SINGLE_ACK);
+  macHdr.SetRepCnts (0);
+  macHdr.SetSeqCnt (m_seqCnt[i]++);
+  macHdr.SetIdent (m_ident[i]);
+  packet->AddHeader (macHdr);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  macTlr.SetFcs (packet);
+  macTlr.SetMacHeader (macHdr);
+  macTlr.SetAuth (packet);
+  packet->AddTrailer (macTlr);
+
+  return packet;
+}
+
+}
@@ -0,0 +1,168 @@
+#ifndef CUNB_METER_POPULATION_H
+#define CUNB_METER_POPULATION_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/vector.h"
+#include "ns3/packet.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/cunb-device-address.h"
+#include "ns3/cunb-channel.h"
+#include "ns3/ms-cunb-phy.h"
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * A large number of meters that periodically report a reading, without a
+ * Node, NetDevice, PHY, MAC or Application of their own.
+ *
+ * The state of the meters is held as a struct of arrays: position, ident,
+ * address, sequence counter and time of the next report, for about 30 bytes
+ * per meter. A single event is pending for the whole population at any
+ * time, the one of the earliest report, found through a binary heap of the
+ * meter indices.
+ *
+ * To the CunbChannel, the population is one transmitter that moves to the
+ * position of each meter before it sends. Reports are the same frames a
+ * MobileAutonomousReporting on top of a MSCunbMac sends, on one of the
+ * uplink micro channels picked at random, so that the eNBs and the server
+ * handle them like any other uplink.
+ *
+ * Meters of a population are uplink only: they don't listen to the ACKs
+ * and requests, and they don't repeat their frames. The server must learn
+ * about them through SimpleCunbServer::AddPopulation, and doesn't answer
+ * them. Since the MAC header holds 16 bits idents, idents are reused
+ * beyond 65535 meters: the server tells the uplinks apart by device
+ * address and sequence number, so this is harmless. The population doesn't support a channel using the
+ * buildings loss model, which ties the indoor state to each mobility model.
+ */
+class CunbMeterPopulation : public Object
+{
+public:
+
+  static TypeId GetTypeId (void);
+
+  CunbMeterPopulation ();
+  virtual ~CunbMeterPopulation ();
+
+  /**
+   * Set the channel the reports are sent on.
+   */
+  void SetChannel (Ptr<CunbChannel> channel);
+
+  /**
+   * Add a meter to the population. Meters are added before Start is
+   * called.
+   *
+   * \param position The position of the meter.
+   * \param address The address of the meter.
+   * \return The index of the meter in the population.
+   */
+  uint32_t AddMeter (const Vector &position, CunbDeviceAddress address);
+
+  uint32_t GetNMeters (void) const;
+  Vector GetPosition (uint32_t i) const;
+  CunbDeviceAddress GetAddress (uint32_t i) const;
+  uint16_t GetIdent (uint32_t i) const;
+
+  /**
+   * Start the reports, each meter sending its first one at a random time
+   * within the first ReportingInterval.
+   */
+  void Start (void);
+
+  /**
+   * Stop the reports.
+   */
+  void Stop (void);
+
+  /**
+   * Get the number of reports sent since the start.
+   */
+  uint64_t GetNSent (void) const;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this population.
+   *
+   * \param stream The first stream index to use.
+   * \return The number of stream indices assigned.
+   */
+  int64_t AssignStreams (int64_t stream);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+
+  /**
+   * Orders the heap of meter indices by time of the next report, the
+   * earliest on top.
+   */
+  struct LaterReport
+  {
+    const std::vector<int64_t> *nextReport;
+    bool operator() (uint32_t a, uint32_t b) const
+    {
+      return (*nextReport)[a] > (*nextReport)[b];
+    }
+  };
+
+  /**
+   * Compute the center frequencies of the micro channels. They must be the
+   * very same doubles as the ones of the reception paths of the eNBs, which
+   * are matched exactly.
+   */
+  void ComputeFrequencies (void);
+
+  /**
+   * Schedule the single pending event, at the earliest report.
+   */
+  void ScheduleNext (void);
+
+  /**
+   * Send all the reports that are due, and give their meters the time of
+   * their next report.
+   */
+  void SendDueReports (void);
+
+  /**
+   * Build the frame of the next report of a meter, from the application
+   * layer down to the MAC trailer.
+   */
+  Ptr<Packet> BuildReport (uint32_t i);
+
+  // The meters, one entry per meter in each vector
+  std::vector<float> m_x;                //!< Position, in m
+  std::vector<float> m_y;                //!< Position, in m
+  std::vector<float> m_z;                //!< Position, in m
+  std::vector<uint32_t> m_address;       //!< CunbDeviceAddress
+  std::vector<uint16_t> m_ident;         //!< Ident in the MAC header
+  std::vector<uint8_t> m_seqCnt;         //!< Sequence counter of the next frame
+  std::vector<int64_t> m_nextReport;     //!< Time of the next report, in time steps
+
+  std::vector<uint32_t> m_heap;          //!< Meter indices, earliest report on top
+
+  Time m_reportingInterval;   //!< Time between two reports of a meter
+  double m_txPower;           //!< TX power of the meters, in dBm
+  uint32_t m_padding;         //!< Bytes appended to each reading
+  uint32_t m_nChannels;       //!< Number of uplink micro channels
+  double m_startFrequency;    //!< Lower edge of the first micro channel, in MHz
+  double m_endFrequency;      //!< Upper edge of the last micro channel, in MHz
+  std::vector<double> m_frequencies; //!< Center of each micro channel, in MHz
+
+  Ptr<CunbChannel> m_channel;
+  Ptr<MSCunbPhy> m_phy;       //!< The transmitter all meters share
+  Ptr<ConstantPositionMobilityModel> m_mobility; //!< Position of m_phy
+  Ptr<UniformRandomVariable> m_rng;
+
+  EventId m_event;            //!< The earliest report
+  uint64_t m_nSent;
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_METER_POPULATION_H */
@@ -0,0 +1,88 @@
+#include "ns3/cunb-profiler.h"
+
+#ifdef CUNB_PROFILING
+
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+namespace ns3 {
+
+bool CunbProfiler::s_reportScheduled = false;
+
+// Sites are static locals of the profiled blocks, linked in a list
+static CunbProfiler::Site *g_sites = 0;
+
+CunbProfiler::Site *
+CunbProfiler::Register (const char *name)
+{
+  Site *site = new Site;
+  site->name = name;
+  site->calls = 0;
+  site->ns = 0;
+  site->next = g_sites;
+  g_sites = site;
+  return site;
+}
+
+static bool
+MoreExpensive (const CunbProfiler::Site *a, const CunbProfiler::Site *b)
+{
+  return a->ns > b->ns;
+}
+
+void
+CunbProfiler::Print (std::ostream &os)
+{
+  std::vector<Site *> sites;
+  for (Site *site = g_sites; site != 0; site = site->next)
+    {
+      sites.push_back (site);
+    }
+  std::sort (sites.begin (), sites.end (), MoreExpensive);
+
+  char line[160];
+  std::snprintf (line, sizeof (line), "%-48s %14s %14s %10s\n",
+                 "block", "calls", "total (ms)", "ns/call");
+  os << line;
+  for (uint32_t i = 0; i < sites.size (); i++)
+    {
+      const Site *site = sites[i];
+      std::snprintf (line, sizeof (line), "%-48s %14llu %14.3f %10.1f\n",
+                     site->name, (unsigned long long) site->calls, site->ns / 1e6,
+                     site->calls ? (double) site->ns / site->calls : 0.0);
+      os << line;
+    }
+}
+
+void
+CunbProfiler::Reset (void)
+{
+  for (Site *site = g_sites; site != 0; site = site->next)
+    {
+      site->calls = 0;
+      site->ns = 0;
+    }
+}
+
+void
+CunbProfiler::ScheduleReport (void)
+{
+  s_reportScheduled = true;
+  Simulator::ScheduleDestroy (&CunbProfiler::Report);
+}
+
+void
+CunbProfiler::Report (void)
+{
+  std::clog << "CUNB profile of the run:" << std::endl;
+  Print (std::clog);
+  Reset ();
+  s_reportScheduled = false;
+}
+
+} // namespace ns3
+
+#endif /* CUNB_PROFILING */
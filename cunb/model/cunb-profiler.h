@@ -0,0 +1,108 @@
+#ifndef CUNB_PROFILER_H
+#define CUNB_PROFILER_H
+
+/**
+ * Scoped timers and call counters for the hot paths of the module.
+ *
+ * CUNB_PROFILE_SCOPE ("Name") at the top of a block counts the calls to the
+ * block and their wall time, inclusive of the nested profiled blocks. The
+ * table of all blocks is printed to std::clog at Simulator::Destroy, and
+ * the counters start again from zero for the next run.
+ *
+ * Profiling is only compiled in when the module is configured with
+ * --enable-cunb-profiling, which defines CUNB_PROFILING; otherwise the
+ * macro expands to nothing.
+ */
+
+#ifdef CUNB_PROFILING
+
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+namespace ns3 {
+
+class CunbProfiler
+{
+public:
+
+  /**
+   * The counters of a profiled block.
+   */
+  struct Site
+  {
+    const char *name;
+    uint64_t calls;
+    int64_t ns;
+    Site *next;   //!< Next registered site
+  };
+
+  /**
+   * Times a block, from its construction to its destruction.
+   */
+  class Scope
+  {
+  public:
+    Scope (Site *site) :
+      m_site (site),
+      m_start (std::chrono::steady_clock::now ())
+    {
+      if (!s_reportScheduled)
+        {
+          ScheduleReport ();
+        }
+    }
+
+    ~Scope ()
+    {
+      m_site->calls++;
+      m_site->ns += std::chrono::duration_cast<std::chrono::nanoseconds>
+          (std::chrono::steady_clock::now () - m_start).count ();
+    }
+
+  private:
+    Site *m_site;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  /**
+   * Add a block to the report. Called once per block.
+   */
+  static Site * Register (const char *name);
+
+  /**
+   * Print the counters of all blocks, the most expensive first.
+   */
+  static void Print (std::ostream &os);
+
+  /**
+   * Bring the counters of all blocks back to zero.
+   */
+  static void Reset (void);
+
+private:
+
+  static void ScheduleReport (void);
+  static void Report (void);
+
+  static bool s_reportScheduled;
+};
+
+} // namespace ns3
+
+#define CUNB_PROFILE_CONCAT2(a, b) a ## b
+#define CUNB_PROFILE_CONCAT(a, b) CUNB_PROFILE_CONCAT2 (a, b)
+
+#define CUNB_PROFILE_SCOPE(name)                                             \
+  static ns3::CunbProfiler::Site *CUNB_PROFILE_CONCAT (cunbProfileSite, __LINE__) = \
+    ns3::CunbProfiler::Register (name);                                      \
+  ns3::CunbProfiler::Scope CUNB_PROFILE_CONCAT (cunbProfileScope, __LINE__)  \
+    (CUNB_PROFILE_CONCAT (cunbProfileSite, __LINE__))
+
+#else /* CUNB_PROFILING */
+
+#define CUNB_PROFILE_SCOPE(name)
+
+#endif /* CUNB_PROFILING */
+
+#endif /* CUNB_PROFILER_H */
@@ -0,0 +1,589 @@
+#include "ns3/cunb-read-campaign.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbReadCampaign");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbReadCampaign);
+
+TypeId
+CunbReadCampaign::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbReadCampaign")
+    .SetParent<Object> ()
+    .AddConstructor<CunbReadCampaign> ()
+    .AddAttribute ("MaxConcurrent",
+                   "Maximum number of meters being read at the same time",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&CunbReadCampaign::m_maxConcurrent),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxConcurrentPerEnb",
+                   "Maximum number of meters being read through the same eNB",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&CunbReadCampaign::m_maxConcurrentPerEnb),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxRetries",
+                   "Number of retransmissions of an unanswered request",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&CunbReadCampaign::m_maxRetries),
+                   MakeUintegerChecker<uint8_t> ())
+    .AddAttribute ("ResponseTimeout",
+                   "Time to wait for the answer to a request",
+                   TimeValue (Seconds (20)),
+                   MakeTimeAccessor (&CunbReadCampaign::m_responseTimeout),
+                   MakeTimeChecker ())
+    .AddAttribute ("RetryInterval",
+                   "Delay before the first retry, doubled at each attempt",
+                   TimeValue (Seconds (5)),
+                   MakeTimeAccessor (&CunbReadCampaign::m_retryInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("AssociationDelay",
+                   "Delay between the moment a meter gets a free slot and "
+                   "its AARQ, the same as the server's reply to a HELLO",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&CunbReadCampaign::m_associationDelay),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("StepDelay",
+                   "Delay between an answer and the following request",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&CunbReadCampaign::m_stepDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("Deadline",
+                   "Maximum duration of the campaign",
+                   TimeValue (Hours (24)),
+                   MakeTimeAccessor (&CunbReadCampaign::m_deadline),
+                   MakeTimeChecker ())
+    .AddTraceSource ("MeterCompleted",
+                     "All the OBIS codes of a meter were read",
+                     MakeTraceSourceAccessor
+                       (&CunbReadCampaign::m_meterCompleted),
+                     "ns3::CunbReadCampaign::MeterCallback")
+    .AddTraceSource ("MeterFailed",
+                     "A meter could not be read",
+                     MakeTraceSourceAccessor
+                       (&CunbReadCampaign::m_meterFailed),
+                     "ns3::CunbReadCampaign::MeterCallback")
+    .AddTraceSource ("CampaignFinished",
+                     "Every target meter was either read or failed",
+                     MakeTraceSourceAccessor
+                       (&CunbReadCampaign::m_campaignFinished),
+                     "ns3::CunbReadCampaign::FinishedCallback")
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbReadCampaign::CunbReadCampaign () :
+  m_active (0),
+  m_remaining (0),
+  m_nReads (0),
+  m_nRequests (0),
+  m_running (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbReadCampaign::~CunbReadCampaign ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbReadCampaign::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (auto it = m_meters.begin (); it != m_meters.end (); ++it)
+    {
+      Simulator::Cancel (it->event);
+    }
+  Simulator::Cancel (m_deadlineEvent);
+  m_sendRequest = SendRequestCallback ();
+
+  Object::DoDispose ();
+}
+
+void
+CunbReadCampaign::AddTarget (CunbDeviceAddress address)
+{
+  NS_LOG_FUNCTION (this << address);
+  NS_ASSERT_MSG (!m_running, "Targets must be added before the start");
+
+  if (m_index.find (address) != m_index.end ())
+    {
+      return;
+    }
+
+  MeterRead meter;
+  meter.address = address;
+  m_index[address] = m_meters.size ();
+  m_meters.push_back (meter);
+  m_remaining++;
+}
+
+void
+CunbReadCampaign::AddObisCode (uint64_t obisCode)
+{
+  NS_LOG_FUNCTION (this << obisCode);
+  NS_ASSERT_MSG (!m_running, "OBIS codes must be added before the start");
+
+  m_obisCodes.push_back (obisCode);
+}
+
+bool
+CunbReadCampaign::IsTarget (CunbDeviceAddress address) const
+{
+  return m_index.find (address) != m_index.end ();
+}
+
+void
+CunbReadCampaign::SetSendRequestCallback (SendRequestCallback callback)
+{
+  m_sendRequest = callback;
+}
+
+void
+CunbReadCampaign::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (!m_sendRequest.IsNull (), "No way to send requests");
+
+  if (m_obisCodes.empty ())
+    {
+      // Same register the server used to read before campaigns existed
+      m_obisCodes.push_back (0x010100070000);
+    }
+
+  m_running = true;
+  m_startTime = Simulator::Now ();
+  m_deadlineEvent = Simulator::Schedule (m_deadline,
+                                         &CunbReadCampaign::ExpireDeadline,
+                                         this);
+
+  NS_LOG_INFO ("Starting campaign over " << m_meters.size () << " meters and "
+               << m_obisCodes.size () << " OBIS codes");
+
+  // Meters heard before the start can be read right away
+  for (uint32_t i = 0; i < m_meters.size (); i++)
+    {
+      if (m_meters[i].heard)
+        {
+          Enqueue (i);
+        }
+    }
+  Dispatch ();
+
+  if (m_remaining == 0)
+    {
+      Finish ();
+    }
+}
+
+bool
+CunbReadCampaign::IsRunning (void) const
+{
+  return m_running;
+}
+
+void
+CunbReadCampaign::NotifyUplink (CunbDeviceAddress address, Address enbAddress,
+                                double frequency)
+{
+  auto it = m_index.find (address);
+  if (it == m_index.end ())
+    {
+      return;
+    }
+
+  MeterRead &meter = m_meters[it->second];
+  meter.frequency = frequency;
+
+  // The eNB of a meter being read is only changed when its slot is released
+  if (meter.state == PENDING && !meter.queued)
+    {
+      meter.enb = enbAddress;
+    }
+
+  if (!meter.heard)
+    {
+      meter.heard = true;
+      if (m_running)
+        {
+          Enqueue (it->second);
+          Dispatch ();
+        }
+    }
+}
+
+void
+CunbReadCampaign::NotifyAare (CunbDeviceAddress address)
+{
+  auto it = m_index.find (address);
+  if (!m_running || it == m_index.end ())
+    {
+      return;
+    }
+
+  uint32_t index = it->second;
+  MeterRead &meter = m_meters[index];
+  if (meter.state != ASSOCIATING)
+    {
+      return;
+    }
+
+  NS_LOG_DEBUG ("Meter " << address << " associated");
+
+  Simulator::Cancel (meter.event);
+  meter.state = READING;
+  meter.obisIndex = 0;
+  meter.attempts = 0;
+  meter.event = Simulator::Schedule (m_stepDelay, &CunbReadCampaign::SendStep,
+                                     this, index);
+}
+
+void
+CunbReadCampaign::NotifyGetResponse (CunbDeviceAddress address, uint32_t value)
+{
+  auto it = m_index.find (address);
+  if (!m_running || it == m_index.end ())
+    {
+      return;
+    }
+
+  uint32_t index = it->second;
+  MeterRead &meter = m_meters[index];
+  if (meter.state != READING)
+    {
+      return;
+    }
+
+  NS_LOG_DEBUG ("Meter " << address << " OBIS " << std::hex <<
+                m_obisCodes[meter.obisIndex] << std::dec << " = " << value);
+
+  Simulator::Cancel (meter.event);
+  m_nReads++;
+  meter.obisIndex++;
+  meter.attempts = 0;
+
+  if (meter.obisIndex == m_obisCodes.size ())
+    {
+      Complete (index);
+    }
+  else
+    {
+      meter.event = Simulator::Schedule (m_stepDelay,
+                                         &CunbReadCampaign::SendStep,
+                                         this, index);
+    }
+}
+
+CunbReadCampaign::State
+CunbReadCampaign::GetState (CunbDeviceAddress address) const
+{
+  auto it = m_index.find (address);
+  NS_ASSERT (it != m_index.end ());
+
+  return m_meters[it->second].state;
+}
+
+void
+CunbReadCampaign::Enqueue (uint32_t index)
+{
+  MeterRead &meter = m_meters[index];
+  if (meter.state != PENDING || meter.queued)
+    {
+      return;
+    }
+
+  meter.queued = true;
+  m_ready[meter.enb].push_back (index);
+}
+
+void
+CunbReadCampaign::Dispatch (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Go over the eNBs in a round robin fashion, so that a single crowded eNB
+  // doesn't starve the others
+  bool progress = true;
+  while (m_running && progress && m_active < m_maxConcurrent)
+    {
+      progress = false;
+      for (auto it = m_ready.begin ();
+           it != m_ready.end () && m_active < m_maxConcurrent; ++it)
+        {
+          if (it->second.empty ()
+              || m_activePerEnb[it->first] >= m_maxConcurrentPerEnb)
+            {
+              continue;
+            }
+
+          uint32_t index = it->second.front ();
+          it->second.pop_front ();
+
+          MeterRead &meter = m_meters[index];
+          meter.queued = false;
+          meter.state = ASSOCIATING;
+          meter.attempts = 0;
+          m_active++;
+          m_activePerEnb[it->first]++;
+          progress = true;
+
+          // Leave the MS the time to be done with the uplink it was heard on
+          if (m_associationDelay.IsZero ())
+            {
+              SendStep (index);
+            }
+          else
+            {
+              meter.event = Simulator::Schedule (m_associationDelay,
+                                                 &CunbReadCampaign::SendStep,
+                                                 this, index);
+            }
+        }
+    }
+}
+
+void
+CunbReadCampaign::SendStep (uint32_t index)
+{
+  MeterRead &meter = m_meters[index];
+  NS_ASSERT (meter.state == ASSOCIATING || meter.state == READING);
+
+  uint8_t requestType = (meter.state == ASSOCIATING) ? 1 : 0;
+  uint64_t obisCode = m_obisCodes[meter.obisIndex];
+
+  NS_LOG_FUNCTION (this << meter.address << (int)requestType);
+
+  meter.attempts++;
+  m_nRequests++;
+  Address enb = m_sendRequest (meter.address, meter.frequency, requestType,
+                               obisCode);
+
+  if (enb == Address ())
+    {
+      // Nobody could carry the request: try again later, if allowed
+      if (meter.attempts > m_maxRetries)
+        {
+          Fail (index, NO_ENB);
+          return;
+        }
+      meter.event = Simulator::Schedule (m_retryInterval,
+                                         &CunbReadCampaign::SendStep,
+                                         this, index);
+      return;
+    }
+
+  meter.event = Simulator::Schedule (m_responseTimeout,
+                                     &CunbReadCampaign::Timeout, this, index);
+}
+
+void
+CunbReadCampaign::Timeout (uint32_t index)
+{
+  MeterRead &meter = m_meters[index];
+
+  NS_LOG_FUNCTION (this << meter.address << (int)meter.attempts);
+
+  if (meter.attempts > m_maxRetries)
+    {
+      Fail (index, meter.state == ASSOCIATING ? AARE_TIMEOUT : GET_TIMEOUT);
+      return;
+    }
+
+  // Exponential backoff on the retry interval
+  Time backoff = Seconds (m_retryInterval.GetSeconds () *
+                          std::pow (2.0, meter.attempts - 1));
+  meter.event = Simulator::Schedule (backoff, &CunbReadCampaign::SendStep,
+                                     this, index);
+}
+
+void
+CunbReadCampaign::Complete (uint32_t index)
+{
+  MeterRead &meter = m_meters[index];
+
+  meter.state = DONE;
+  meter.completion = Simulator::Now () - m_startTime;
+  NS_LOG_INFO ("Meter " << meter.address << " read in " <<
+               meter.completion.GetSeconds () << " s");
+  m_meterCompleted (meter.address, meter.completion);
+
+  Release (index);
+}
+
+void
+CunbReadCampaign::Fail (uint32_t index, FailureReason reason)
+{
+  MeterRead &meter = m_meters[index];
+
+  meter.state = FAILED;
+  meter.reason = reason;
+  meter.completion = Simulator::Now () - m_startTime;
+  NS_LOG_INFO ("Meter " << meter.address << " failed: " <<
+               GetFailureReasonName (reason));
+  m_meterFailed (meter.address, meter.completion);
+
+  Release (index);
+}
+
+void
+CunbReadCampaign::Release (uint32_t index)
+{
+  Simulator::Cancel (m_meters[index].event);
+
+  m_active--;
+  m_activePerEnb[m_meters[index].enb]--;
+  m_remaining--;
+
+  if (m_remaining == 0)
+    {
+      Finish ();
+    }
+  else
+    {
+      Dispatch ();
+    }
+}
+
+void
+CunbReadCampaign::ExpireDeadline (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (uint32_t i = 0; i < m_meters.size (); i++)
+    {
+      MeterRead &meter = m_meters[i];
+      if (meter.state == DONE || meter.state == FAILED)
+        {
+          continue;
+        }
+
+      Simulator::Cancel (meter.event);
+      meter.reason = meter.heard ? DEADLINE : NOT_HEARD;
+      meter.state = FAILED;
+      meter.queued = false;
+      meter.completion = m_deadline;
+      m_meterFailed (meter.address, meter.completion);
+    }
+
+  m_ready.clear ();
+  m_activePerEnb.clear ();
+  m_active = 0;
+  m_remaining = 0;
+
+  Finish ();
+}
+
+void
+CunbReadCampaign::Finish (void)
+{
+  if (!m_running)
+    {
+      return;
+    }
+
+  m_running = false;
+  m_endTime = Simulator::Now ();
+  Simulator::Cancel (m_deadlineEvent);
+
+  NS_LOG_INFO ("Campaign finished after " <<
+               (m_endTime - m_startTime).GetSeconds () << " s");
+  m_campaignFinished ();
+}
+
+CunbReadCampaign::Report
+CunbReadCampaign::GetReport (void) const
+{
+  Report report;
+  report.nTargets = m_meters.size ();
+  report.nReads = m_nReads;
+  report.nRequests = m_nRequests;
+  report.duration = (m_running ? Simulator::Now () : m_endTime) - m_startTime;
+
+  std::vector<Time> completions;
+  for (auto it = m_meters.begin (); it != m_meters.end (); ++it)
+    {
+      if (it->state == DONE)
+        {
+          report.nSucceeded++;
+          completions.push_back (it->completion);
+        }
+      else if (it->state == FAILED)
+        {
+          report.nFailed++;
+          report.failures[it->reason]++;
+        }
+    }
+
+  if (report.duration.IsStrictlyPositive ())
+    {
+      report.readsPerHour = m_nReads / report.duration.GetHours ();
+    }
+
+  if (!completions.empty ())
+    {
+      std::sort (completions.begin (), completions.end ());
+      uint32_t last = completions.size () - 1;
+      report.p50Completion = completions[(uint32_t)std::ceil (0.50 * last)];
+      report.p95Completion = completions[(uint32_t)std::ceil (0.95 * last)];
+      report.p99Completion = completions[(uint32_t)std::ceil (0.99 * last)];
+      report.maxCompletion = completions[last];
+    }
+
+  return report;
+}
+
+void
+CunbReadCampaign::PrintReport (std::ostream &os) const
+{
+  Report report = GetReport ();
+
+  os << "Targets: " << report.nTargets
+     << " succeeded: " << report.nSucceeded
+     << " failed: " << report.nFailed << std::endl;
+  os << "Reads: " << report.nReads
+     << " requests: " << report.nRequests
+     << " reads/hour: " << report.readsPerHour << std::endl;
+  os << "Completion p50: " << report.p50Completion.GetSeconds ()
+     << " s p95: " << report.p95Completion.GetSeconds ()
+     << " s p99: " << report.p99Completion.GetSeconds ()
+     << " s max: " << report.maxCompletion.GetSeconds () << " s" << std::endl;
+  for (int i = NONE + 1; i < N_FAILURE_REASONS; i++)
+    {
+      if (report.failures[i] > 0)
+        {
+          os << GetFailureReasonName (FailureReason (i)) << ": "
+             << report.failures[i] << std::endl;
+        }
+    }
+}
+
+const char *
+CunbReadCampaign::GetFailureReasonName (FailureReason reason)
+{
+  switch (reason)
+    {
+    case NONE:
+      return "None";
+    case NOT_HEARD:
+      return "NotHeard";
+    case NO_ENB:
+      return "NoEnb";
+    case AARE_TIMEOUT:
+      return "AareTimeout";
+    case GET_TIMEOUT:
+      return "GetTimeout";
+    case DEADLINE:
+      return "Deadline";
+    default:
+      return "Unknown";
+    }
+}
+
+}
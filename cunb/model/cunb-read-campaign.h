@@ -0,0 +1,248 @@
+#ifndef CUNB_READ_CAMPAIGN_H
+#define CUNB_READ_CAMPAIGN_H
+
+#include "ns3/object.h"
+#include "ns3/address.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/traced-callback.h"
+#include "ns3/cunb-device-address.h"
+#include <vector>
+#include <deque>
+#include <map>
+#include <ostream>
+
+namespace ns3 {
+
+/**
+ * A meter reading campaign run by the CUNB server.
+ *
+ * The campaign is given a list of target meters and a list of OBIS codes to
+ * read from each one of them. For every meter it drives the
+ * AARQ -> AARE -> GET-Request -> GET-Response sequence, one GET for each
+ * OBIS code, while making sure that no more than MaxConcurrent meters are
+ * being read at the same time, and that no more than MaxConcurrentPerEnb of
+ * them are served by the same eNB. A meter only becomes eligible once the
+ * server has heard an uplink from it, since that's the only way to know the
+ * eNB and the frequency to reach it. The AARQ follows AssociationDelay
+ * after the meter got its slot.
+ *
+ * Unanswered requests are retransmitted after RetryInterval (doubled at each
+ * attempt) up to MaxRetries times, after which the meter is marked as
+ * failed. Meters that are still unfinished when the Deadline expires are
+ * failed too. At the end of the campaign, a Report is available with the
+ * throughput, the completion time distribution and the failure reasons.
+ */
+class CunbReadCampaign : public Object
+{
+public:
+
+  /**
+   * The stage a target meter is in.
+   */
+  enum State
+  {
+    PENDING,     //!< Waiting for a free slot (or to be heard)
+    ASSOCIATING, //!< AARQ sent, waiting for the AARE
+    READING,     //!< GET-Request sent, waiting for the GET-Response
+    DONE,        //!< All OBIS codes were read
+    FAILED       //!< The meter could not be read
+  };
+
+  /**
+   * Why a meter could not be read.
+   */
+  enum FailureReason
+  {
+    NONE = 0,
+    NOT_HEARD,    //!< The server never received an uplink from the meter
+    NO_ENB,       //!< No eNB was available to carry the requests
+    AARE_TIMEOUT, //!< The association was never confirmed
+    GET_TIMEOUT,  //!< A GET-Request was never answered
+    DEADLINE,     //!< The campaign deadline expired while reading the meter
+    N_FAILURE_REASONS
+  };
+
+  /**
+   * Summary of a campaign.
+   */
+  struct Report
+  {
+    uint32_t nTargets = 0;   //!< Number of target meters
+    uint32_t nSucceeded = 0; //!< Meters for which all OBIS codes were read
+    uint32_t nFailed = 0;    //!< Meters that could not be read
+    uint32_t nReads = 0;     //!< Number of GET-Responses collected
+    uint32_t nRequests = 0;  //!< Number of requests sent, retries included
+    Time duration;           //!< Time elapsed since the campaign start
+    double readsPerHour = 0; //!< Collected GET-Responses per hour
+    Time p50Completion;      //!< Median meter completion time
+    Time p95Completion;      //!< 95th percentile of the completion time
+    Time p99Completion;      //!< 99th percentile of the completion time
+    Time maxCompletion;      //!< Completion time of the last meter
+    uint32_t failures[N_FAILURE_REASONS] = {}; //!< Failures, by reason
+  };
+
+  /**
+   * Callback used to send a request to a meter.
+   *
+   * The arguments are the meter address, the frequency to use, the request
+   * type (1 for AARQ, 0 for GET-Request) and the OBIS code to read. It
+   * returns the address of the eNB that was used, or an empty Address if no
+   * eNB could take the request.
+   */
+  typedef Callback<Address, CunbDeviceAddress, double, uint8_t, uint64_t> SendRequestCallback;
+
+  /**
+   * TracedCallback signature for completed or failed meters.
+   *
+   * \param address The meter address.
+   * \param elapsed The time since the start of the campaign.
+   */
+  typedef void (* MeterCallback)(CunbDeviceAddress address, Time elapsed);
+
+  /**
+   * TracedCallback signature for the end of the campaign.
+   */
+  typedef void (* FinishedCallback)(void);
+
+  static TypeId GetTypeId (void);
+
+  CunbReadCampaign ();
+  virtual ~CunbReadCampaign ();
+
+  /**
+   * Add a meter to the list of targets of this campaign.
+   */
+  void AddTarget (CunbDeviceAddress address);
+
+  /**
+   * Add an OBIS code to read from every target meter.
+   */
+  void AddObisCode (uint64_t obisCode);
+
+  /**
+   * Check whether a meter is among the targets of this campaign.
+   */
+  bool IsTarget (CunbDeviceAddress address) const;
+
+  /**
+   * Set the callback used to send requests to the meters.
+   */
+  void SetSendRequestCallback (SendRequestCallback callback);
+
+  /**
+   * Start the campaign now. The deadline is counted from this instant.
+   */
+  void Start (void);
+
+  /**
+   * Check whether the campaign has been started and is not finished yet.
+   */
+  bool IsRunning (void) const;
+
+  /**
+   * Inform the campaign that an uplink from this meter was received through
+   * this eNB, on this frequency.
+   */
+  void NotifyUplink (CunbDeviceAddress address, Address enbAddress,
+                     double frequency);
+
+  /**
+   * Inform the campaign that this meter sent an AARE.
+   */
+  void NotifyAare (CunbDeviceAddress address);
+
+  /**
+   * Inform the campaign that this meter sent a GET-Response.
+   */
+  void NotifyGetResponse (CunbDeviceAddress address, uint32_t value);
+
+  /**
+   * Get the state a target meter is in.
+   */
+  State GetState (CunbDeviceAddress address) const;
+
+  /**
+   * Compute the summary of the campaign up to now.
+   */
+  Report GetReport (void) const;
+
+  /**
+   * Print a summary of the campaign on a stream.
+   */
+  void PrintReport (std::ostream &os) const;
+
+  /**
+   * Get a printable name for a failure reason.
+   */
+  static const char * GetFailureReasonName (FailureReason reason);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+
+  /**
+   * Per-meter bookkeeping.
+   */
+  struct MeterRead
+  {
+    CunbDeviceAddress address;
+    State state = PENDING;
+    FailureReason reason = NONE;
+    bool heard = false;     //!< Whether an uplink from the meter was received
+    bool queued = false;    //!< Whether the meter sits in a ready queue
+    Address enb;            //!< eNB the meter is accounted to
+    double frequency = 0;   //!< Frequency of the last uplink
+    uint32_t obisIndex = 0; //!< Index of the OBIS code being read
+    uint8_t attempts = 0;   //!< Attempts made for the current step
+    Time completion;        //!< Completion time, relative to the start
+    EventId event;          //!< Pending timeout or retry
+  };
+
+  void Enqueue (uint32_t index);
+  void Dispatch (void);
+  void SendStep (uint32_t index);
+  void Timeout (uint32_t index);
+  void Complete (uint32_t index);
+  void Fail (uint32_t index, FailureReason reason);
+  void Release (uint32_t index);
+  void ExpireDeadline (void);
+  void Finish (void);
+
+  std::vector<MeterRead> m_meters; //!< All target meters
+  std::map<CunbDeviceAddress, uint32_t> m_index; //!< Meter address -> index
+  std::vector<uint64_t> m_obisCodes; //!< OBIS codes to read
+
+  std::map<Address, std::deque<uint32_t> > m_ready; //!< Eligible meters, per eNB
+  std::map<Address, uint32_t> m_activePerEnb; //!< Meters being read, per eNB
+  uint32_t m_active;    //!< Meters being read
+  uint32_t m_remaining; //!< Meters neither done nor failed
+  uint32_t m_nReads;    //!< Collected GET-Responses
+  uint32_t m_nRequests; //!< Sent requests
+
+  uint32_t m_maxConcurrent;       //!< Global concurrency limit
+  uint32_t m_maxConcurrentPerEnb; //!< Per-eNB concurrency limit
+  uint8_t m_maxRetries;           //!< Retries for each step
+  Time m_responseTimeout;         //!< Time to wait for an answer
+  Time m_retryInterval;           //!< Base delay before a retry
+  Time m_associationDelay;        //!< Delay between a free slot and the AARQ
+  Time m_stepDelay;               //!< Delay between an answer and the next request
+  Time m_deadline;                //!< Duration of the campaign
+
+  bool m_running;
+  Time m_startTime;
+  Time m_endTime;
+  EventId m_deadlineEvent;
+
+  SendRequestCallback m_sendRequest;
+
+  TracedCallback<CunbDeviceAddress, Time> m_meterCompleted;
+  TracedCallback<CunbDeviceAddress, Time> m_meterFailed;
+  TracedCallback<> m_campaignFinished;
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_READ_CAMPAIGN_H */
@@ -0,0 +1,275 @@
+#include "ns3/cunb-reading-sink.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/enum.h"
+#include "ns3/log.h"
+#include <cstdio>
+#include <cstring>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbReadingSink");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbReadingSink);
+
+TypeId
+CunbReadingSink::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbReadingSink")
+    .SetParent<Object> ()
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbReadingSink::CunbReadingSink ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbReadingSink::~CunbReadingSink ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbReadingSink::Flush (void)
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (CunbBufferedReadingSink);
+
+TypeId
+CunbBufferedReadingSink::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbBufferedReadingSink")
+    .SetParent<CunbReadingSink> ()
+    .AddConstructor<CunbBufferedReadingSink> ()
+    .AddAttribute ("FileName",
+                   "File the readings are written to, empty to only keep "
+                   "the most recent ones in memory",
+                   StringValue (""),
+                   MakeStringAccessor (&CunbBufferedReadingSink::m_fileName),
+                   MakeStringChecker ())
+    .AddAttribute ("Format",
+                   "Format of the output file",
+                   EnumValue (CunbBufferedReadingSink::CSV),
+                   MakeEnumAccessor (&CunbBufferedReadingSink::m_format),
+                   MakeEnumChecker (CunbBufferedReadingSink::BINARY, "Binary",
+                                    CunbBufferedReadingSink::CSV, "Csv"))
+    .AddAttribute ("Capacity",
+                   "Number of readings held in memory between two flushes",
+                   UintegerValue (8192),
+                   MakeUintegerAccessor (&CunbBufferedReadingSink::m_capacity),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("FlushInterval",
+                   "Time between two flushes of the buffer, zero to only "
+                   "flush when the buffer is full",
+                   TimeValue (Minutes (10)),
+                   MakeTimeAccessor (&CunbBufferedReadingSink::m_flushInterval),
+                   MakeTimeChecker ())
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbBufferedReadingSink::CunbBufferedReadingSink () :
+  m_head (0),
+  m_count (0),
+  m_openFailed (false),
+  m_nRecorded (0),
+  m_nDropped (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbBufferedReadingSink::~CunbBufferedReadingSink ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbBufferedReadingSink::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Flush ();
+  Simulator::Cancel (m_flushEvent);
+  if (m_file.is_open ())
+    {
+      m_file.close ();
+    }
+
+  CunbReadingSink::DoDispose ();
+}
+
+void
+CunbBufferedReadingSink::Allocate (void)
+{
+  NS_LOG_FUNCTION (this << m_capacity);
+
+  m_buffer.resize (m_capacity);
+  m_head = 0;
+  m_count = 0;
+
+  // Large enough to hold a full buffer in either format
+  m_block.reserve (m_capacity * 128);
+}
+
+void
+CunbBufferedReadingSink::Record (const Reading &reading)
+{
+  if (m_buffer.empty ())
+    {
+      Allocate ();
+    }
+
+  m_nRecorded++;
+
+  if (m_count == m_buffer.size ())
+    {
+      Flush ();
+    }
+
+  if (m_count == m_buffer.size ())
+    {
+      // Nowhere to write to: overwrite the oldest reading
+      m_head = (m_head + 1) % m_buffer.size ();
+      m_count--;
+      m_nDropped++;
+    }
+
+  m_buffer[(m_head + m_count) % m_buffer.size ()] = reading;
+  m_count++;
+
+  // Only keep a flush pending while there's something to write, so that the
+  // sink never keeps an otherwise finished simulation alive
+  if (m_fileName.empty () || m_openFailed || m_flushInterval.IsZero ()
+      || m_flushEvent.IsRunning ())
+    {
+      return;
+    }
+  m_flushEvent = Simulator::Schedule (m_flushInterval,
+                                      &CunbBufferedReadingSink::PeriodicFlush,
+                                      this);
+}
+
+bool
+CunbBufferedReadingSink::Open (void)
+{
+  if (m_file.is_open ())
+    {
+      return true;
+    }
+  if (m_fileName.empty () || m_openFailed)
+    {
+      return false;
+    }
+
+  std::ios_base::openmode mode = std::ios::out | std::ios::trunc;
+  if (m_format == BINARY)
+    {
+      mode |= std::ios::binary;
+    }
+  m_file.open (m_fileName.c_str (), mode);
+
+  if (!m_file.is_open ())
+    {
+      NS_LOG_ERROR ("Can't open " << m_fileName << ", readings won't be saved");
+      m_openFailed = true;
+      return false;
+    }
+
+  if (m_format == CSV)
+    {
+      m_file << "time,address,ident,seq,index,enb,rssi,frequency,value" << std::endl;
+    }
+  return true;
+}
+
+void
+CunbBufferedReadingSink::Encode (const Reading &reading)
+{
+  if (m_format == BINARY)
+    {
+      char record[BINARY_RECORD_SIZE];
+      char *p = record;
+      std::memcpy (p, &reading.timeNs, 8); p += 8;
+      std::memcpy (p, &reading.address, 4); p += 4;
+      std::memcpy (p, &reading.ident, 2); p += 2;
+      std::memcpy (p, &reading.seq, 1); p += 1;
+      std::memcpy (p, &reading.index, 1); p += 1;
+      std::memcpy (p, &reading.enb, 4); p += 4;
+      std::memcpy (p, &reading.rssi, 8); p += 8;
+      std::memcpy (p, &reading.frequency, 8); p += 8;
+      std::memcpy (p, &reading.value, 4);
+      m_block.insert (m_block.end (), record, record + BINARY_RECORD_SIZE);
+    }
+  else
+    {
+      char line[128];
+      int n = std::snprintf (line, sizeof (line),
+                             "%.9f,%u,%u,%u,%u,%u,%.2f,%.6f,%u\n",
+                             reading.timeNs / 1e9, reading.address,
+                             (unsigned)reading.ident, (unsigned)reading.seq,
+                             (unsigned)reading.index, reading.enb, reading.rssi, reading.frequency,
+                             reading.value);
+      m_block.insert (m_block.end (), line, line + n);
+    }
+}
+
+void
+CunbBufferedReadingSink::Flush (void)
+{
+  NS_LOG_FUNCTION (this << m_count);
+
+  if (m_count == 0 || !Open ())
+    {
+      return;
+    }
+
+  // Encode the whole buffer and write it in a single block
+  m_block.clear ();
+  for (uint32_t i = 0; i < m_count; i++)
+    {
+      Encode (m_buffer[(m_head + i) % m_buffer.size ()]);
+    }
+  m_file.write (m_block.data (), m_block.size ());
+  m_file.flush ();
+
+  m_head = 0;
+  m_count = 0;
+}
+
+void
+CunbBufferedReadingSink::PeriodicFlush (void)
+{
+  Flush ();
+}
+
+uint32_t
+CunbBufferedReadingSink::GetNBuffered (void) const
+{
+  return m_count;
+}
+
+const CunbReadingSink::Reading &
+CunbBufferedReadingSink::GetBuffered (uint32_t i) const
+{
+  NS_ASSERT (i < m_count);
+
+  return m_buffer[(m_head + i) % m_buffer.size ()];
+}
+
+uint64_t
+CunbBufferedReadingSink::GetNRecorded (void) const
+{
+  return m_nRecorded;
+}
+
+uint64_t
+CunbBufferedReadingSink::GetNDropped (void) const
+{
+  return m_nDropped;
+}
+
+}
@@ -0,0 +1,143 @@
+#ifndef CUNB_READING_SINK_H
+#define CUNB_READING_SINK_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include <vector>
+#include <fstream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * Interface of the components the CUNB server hands the meter readings to.
+ *
+ * Each GET Response that the server decodes becomes a Reading, which is
+ * passed to the sink with Record. Sinks are free to store, aggregate or
+ * discard the readings.
+ */
+class CunbReadingSink : public Object
+{
+public:
+
+  /**
+   * A single value read from a meter.
+   */
+  struct Reading
+  {
+    int64_t timeNs;     //!< Reception time at the server, in nanoseconds
+    uint32_t address;   //!< CunbDeviceAddress of the meter
+    uint16_t ident;     //!< Identifier in the MAC header
+    uint8_t seq;        //!< Sequence number in the MAC header
+    uint8_t index;      //!< Position among the readings of a batched frame
+    uint32_t enb;       //!< Node id of the eNB that forwarded the reading
+    double rssi;        //!< Receive power at that eNB, in dBm
+    double frequency;   //!< Uplink frequency, in MHz
+    uint32_t value;     //!< Value in the GET Response
+  };
+
+  static TypeId GetTypeId (void);
+
+  CunbReadingSink ();
+  virtual ~CunbReadingSink ();
+
+  /**
+   * Store a reading.
+   */
+  virtual void Record (const Reading &reading) = 0;
+
+  /**
+   * Push the stored readings to their final destination, if any.
+   */
+  virtual void Flush (void);
+};
+
+/**
+ * A CunbReadingSink that keeps the readings in a preallocated ring buffer
+ * and writes them to a file in large blocks.
+ *
+ * The buffer is written out when it is full, every FlushInterval and when
+ * Flush is called (the server does so at StopApplication), so that the memory
+ * footprint stays bounded however long the simulation is. Readings are
+ * written either as CSV or as fixed-size binary records, laid out as in
+ * Reading, without padding and in host byte order (8+4+2+1+1+4+8+8+4 = 40
+ * bytes). If no FileName is given, the buffer only keeps the most recent
+ * Capacity readings.
+ */
+class CunbBufferedReadingSink : public CunbReadingSink
+{
+public:
+
+  enum Format
+  {
+    BINARY,
+    CSV
+  };
+
+  static TypeId GetTypeId (void);
+
+  CunbBufferedReadingSink ();
+  virtual ~CunbBufferedReadingSink ();
+
+  virtual void Record (const Reading &reading);
+
+  virtual void Flush (void);
+
+  /**
+   * Get the number of readings currently held in the buffer.
+   */
+  uint32_t GetNBuffered (void) const;
+
+  /**
+   * Get the i-th oldest reading held in the buffer.
+   */
+  const Reading & GetBuffered (uint32_t i) const;
+
+  /**
+   * Get the number of readings that were recorded since the start.
+   */
+  uint64_t GetNRecorded (void) const;
+
+  /**
+   * Get the number of readings that were overwritten before being written.
+   */
+  uint64_t GetNDropped (void) const;
+
+  /**
+   * Size of a record in the binary format.
+   */
+  static const uint32_t BINARY_RECORD_SIZE = 40;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+
+  void Allocate (void);
+  bool Open (void);
+  void Encode (const Reading &reading);
+  void PeriodicFlush (void);
+
+  std::string m_fileName;  //!< Output file, empty to keep the readings in memory
+  Format m_format;         //!< Output format
+  uint32_t m_capacity;     //!< Number of readings in the ring buffer
+  Time m_flushInterval;    //!< Time between two flushes, zero to disable
+
+  std::vector<Reading> m_buffer; //!< The ring buffer
+  uint32_t m_head;  //!< Index of the oldest reading
+  uint32_t m_count; //!< Readings in the buffer
+
+  std::vector<char> m_block; //!< Encoded readings waiting to be written
+  std::ofstream m_file;
+  bool m_openFailed;
+
+  uint64_t m_nRecorded;
+  uint64_t m_nDropped;
+
+  EventId m_flushEvent;
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_READING_SINK_H */
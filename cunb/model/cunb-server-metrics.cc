@@ -0,0 +1,434 @@
+#include "ns3/cunb-server-metrics.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/log.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("CunbServerMetrics");
+
+NS_OBJECT_ENSURE_REGISTERED (CunbServerMetrics);
+
+CunbServerMetrics::Histogram::Histogram (double binWidth, uint32_t nBins) :
+  m_binWidth (binWidth),
+  m_bins (nBins, 0),
+  m_count (0),
+  m_sum (0),
+  m_max (0)
+{
+  NS_ASSERT (binWidth > 0 && nBins > 0);
+}
+
+void
+CunbServerMetrics::Histogram::Add (double value)
+{
+  uint32_t bin = (value <= 0) ? 0 : (uint32_t)(value / m_binWidth);
+  bin = std::min<uint32_t> (bin, m_bins.size () - 1);
+
+  m_bins[bin]++;
+  m_count++;
+  m_sum += value;
+  m_max = std::max (m_max, value);
+}
+
+void
+CunbServerMetrics::Histogram::Reset (void)
+{
+  std::fill (m_bins.begin (), m_bins.end (), 0);
+  m_count = 0;
+  m_sum = 0;
+  m_max = 0;
+}
+
+uint64_t
+CunbServerMetrics::Histogram::GetCount (void) const
+{
+  return m_count;
+}
+
+double
+CunbServerMetrics::Histogram::GetMean (void) const
+{
+  return m_count ? m_sum / m_count : 0;
+}
+
+double
+CunbServerMetrics::Histogram::GetMax (void) const
+{
+  return m_max;
+}
+
+double
+CunbServerMetrics::Histogram::GetBinWidth (void) const
+{
+  return m_binWidth;
+}
+
+uint32_t
+CunbServerMetrics::Histogram::GetNBins (void) const
+{
+  return m_bins.size ();
+}
+
+uint64_t
+CunbServerMetrics::Histogram::GetBinCount (uint32_t bin) const
+{
+  NS_ASSERT (bin < m_bins.size ());
+
+  return m_bins[bin];
+}
+
+double
+CunbServerMetrics::Histogram::GetQuantile (double q) const
+{
+  if (m_count == 0)
+    {
+      return 0;
+    }
+
+  uint64_t target = (uint64_t)(q * m_count);
+  uint64_t cumulative = 0;
+  for (uint32_t i = 0; i < m_bins.size (); i++)
+    {
+      cumulative += m_bins[i];
+      if (cumulative > target)
+        {
+          return (i + 1) * m_binWidth;
+        }
+    }
+  return m_bins.size () * m_binWidth;
+}
+
+TypeId
+CunbServerMetrics::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CunbServerMetrics")
+    .SetParent<Object> ()
+    .AddConstructor<CunbServerMetrics> ()
+    .AddAttribute ("SnapshotFile",
+                   "CSV file the periodic snapshots are written to, empty "
+                   "to disable them",
+                   StringValue (""),
+                   MakeStringAccessor (&CunbServerMetrics::m_snapshotFileName),
+                   MakeStringChecker ())
+    .AddAttribute ("SnapshotInterval",
+                   "Time between two snapshots",
+                   TimeValue (Minutes (1)),
+                   MakeTimeAccessor (&CunbServerMetrics::m_snapshotInterval),
+                   MakeTimeChecker ())
+    .AddTraceSource ("HelloCount",
+                     "Number of HELLOs received, duplicates excluded",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_hello),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("AaRequestCount",
+                     "Number of AA Requests sent",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_aaRequest),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("GetRequestCount",
+                     "Number of GET Requests sent",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_getRequest),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("GroupRequestCount",
+                     "Number of group GET Requests sent, one per group",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_groupRequest),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("DuplicateCount",
+                     "Number of uplinks dropped as duplicates",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_duplicate),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("FirstWindowReplies",
+                     "Number of replies sent in the first receive window",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_reply1),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("SecondWindowReplies",
+                     "Number of replies sent in the second receive window",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_reply2),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("ThirdWindowReplies",
+                     "Number of replies sent in the third receive window",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_reply3),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("RepliesGivenUp",
+                     "Number of replies dropped for lack of an eNB",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_replyGivenUp),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("NoEnbAvailable",
+                     "Number of times no eNB was available for a downlink",
+                     MakeTraceSourceAccessor (&CunbServerMetrics::m_noEnb),
+                     "ns3::TracedValueCallback::Uint32")
+    .SetGroupName ("cunb");
+  return tid;
+}
+
+CunbServerMetrics::CunbServerMetrics () :
+  m_hello (0),
+  m_aaRequest (0),
+  m_getRequest (0),
+  m_groupRequest (0),
+  m_duplicate (0),
+  m_reply1 (0),
+  m_reply2 (0),
+  m_reply3 (0),
+  m_replyGivenUp (0),
+  m_noEnb (0),
+  m_replyLatency (0.5, 40),
+  m_enbRank (1, 8)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+CunbServerMetrics::~CunbServerMetrics ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+CunbServerMetrics::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_snapshotEvent);
+  if (m_snapshotFile.is_open ())
+    {
+      m_snapshotFile.close ();
+    }
+
+  Object::DoDispose ();
+}
+
+void
+CunbServerMetrics::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_hello = 0;
+  m_aaRequest = 0;
+  m_getRequest = 0;
+  m_groupRequest = 0;
+  m_duplicate = 0;
+  m_reply1 = 0;
+  m_reply2 = 0;
+  m_reply3 = 0;
+  m_replyGivenUp = 0;
+  m_noEnb = 0;
+  m_replyLatency.Reset ();
+  m_enbRank.Reset ();
+  m_enbChoices.clear ();
+}
+
+void
+CunbServerMetrics::NotifyHello (void)
+{
+  m_hello++;
+}
+
+void
+CunbServerMetrics::NotifyAaRequest (void)
+{
+  m_aaRequest++;
+}
+
+void
+CunbServerMetrics::NotifyGetRequest (void)
+{
+  m_getRequest++;
+}
+
+void
+CunbServerMetrics::NotifyGroupRequest (void)
+{
+  m_groupRequest++;
+}
+
+void
+CunbServerMetrics::NotifyDuplicate (void)
+{
+  m_duplicate++;
+}
+
+void
+CunbServerMetrics::NotifyReply (uint8_t window, Time latency)
+{
+  switch (window)
+    {
+    case 1:
+      m_reply1++;
+      break;
+    case 2:
+      m_reply2++;
+      break;
+    case 3:
+      m_reply3++;
+      break;
+    default:
+      NS_ASSERT_MSG (false, "There's no receive window " << (int)window);
+    }
+  m_replyLatency.Add (latency.GetSeconds ());
+}
+
+void
+CunbServerMetrics::NotifyReplyGivenUp (void)
+{
+  m_replyGivenUp++;
+}
+
+void
+CunbServerMetrics::NotifyEnbChoice (uint32_t rank, uint32_t enbId)
+{
+  m_enbRank.Add (rank);
+  m_enbChoices[enbId]++;
+}
+
+void
+CunbServerMetrics::NotifyNoEnbAvailable (void)
+{
+  m_noEnb++;
+}
+
+uint32_t
+CunbServerMetrics::GetHelloCount (void) const
+{
+  return m_hello;
+}
+
+uint32_t
+CunbServerMetrics::GetAaRequestCount (void) const
+{
+  return m_aaRequest;
+}
+
+uint32_t
+CunbServerMetrics::GetGetRequestCount (void) const
+{
+  return m_getRequest;
+}
+
+uint32_t
+CunbServerMetrics::GetGroupRequestCount (void) const
+{
+  return m_groupRequest;
+}
+
+uint32_t
+CunbServerMetrics::GetDuplicateCount (void) const
+{
+  return m_duplicate;
+}
+
+uint32_t
+CunbServerMetrics::GetReplyCount (uint8_t window) const
+{
+  switch (window)
+    {
+    case 1:
+      return m_reply1;
+    case 2:
+      return m_reply2;
+    case 3:
+      return m_reply3;
+    default:
+      return 0;
+    }
+}
+
+uint32_t
+CunbServerMetrics::GetReplyGivenUpCount (void) const
+{
+  return m_replyGivenUp;
+}
+
+uint32_t
+CunbServerMetrics::GetNoEnbCount (void) const
+{
+  return m_noEnb;
+}
+
+const CunbServerMetrics::Histogram &
+CunbServerMetrics::GetReplyLatency (void) const
+{
+  return m_replyLatency;
+}
+
+const CunbServerMetrics::Histogram &
+CunbServerMetrics::GetEnbRank (void) const
+{
+  return m_enbRank;
+}
+
+const std::map<uint32_t, uint64_t> &
+CunbServerMetrics::GetEnbChoices (void) const
+{
+  return m_enbChoices;
+}
+
+void
+CunbServerMetrics::StartSnapshots (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_snapshotFileName.empty () || m_snapshotInterval.IsZero ())
+    {
+      return;
+    }
+
+  Simulator::Cancel (m_snapshotEvent);
+  m_snapshotEvent = Simulator::Schedule (m_snapshotInterval,
+                                         &CunbServerMetrics::PeriodicSnapshot,
+                                         this);
+}
+
+void
+CunbServerMetrics::StopSnapshots (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_snapshotEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_snapshotEvent);
+      Snapshot ();
+    }
+}
+
+void
+CunbServerMetrics::PeriodicSnapshot (void)
+{
+  Snapshot ();
+  m_snapshotEvent = Simulator::Schedule (m_snapshotInterval,
+                                         &CunbServerMetrics::PeriodicSnapshot,
+                                         this);
+}
+
+void
+CunbServerMetrics::Snapshot (void)
+{
+  if (m_snapshotFileName.empty ())
+    {
+      return;
+    }
+
+  if (!m_snapshotFile.is_open ())
+    {
+      m_snapshotFile.open (m_snapshotFileName.c_str (),
+                           std::ios::out | std::ios::trunc);
+      if (!m_snapshotFile.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open " << m_snapshotFileName);
+          m_snapshotFileName.clear ();
+          return;
+        }
+      m_snapshotFile << "time,hello,aaRequest,getRequest,groupRequest,duplicate,"
+                     << "reply1,reply2,reply3,replyGivenUp,noEnb,"
+                     << "latencyMean,latencyP95,latencyMax" << std::endl;
+    }
+
+  m_snapshotFile << Simulator::Now ().GetSeconds () << ","
+                 << m_hello << "," << m_aaRequest << "," << m_getRequest << ","
+                 << m_groupRequest << "," << m_duplicate << "," << m_reply1 << "," << m_reply2 << ","
+                 << m_reply3 << "," << m_replyGivenUp << "," << m_noEnb << ","
+                 << m_replyLatency.GetMean () << ","
+                 << m_replyLatency.GetQuantile (0.95) << ","
+                 << m_replyLatency.GetMax () << std::endl;
+}
+
+}
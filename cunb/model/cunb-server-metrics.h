@@ -0,0 +1,161 @@
+#ifndef CUNB_SERVER_METRICS_H
+#define CUNB_SERVER_METRICS_H
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-value.h"
+#include <vector>
+#include <map>
+#include <fstream>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * The counters and histograms of a single SimpleCunbServer.
+ *
+ * Every server owns an instance of this class, so that two servers in the
+ * same simulation, or two simulations run back to back in the same process,
+ * never mix their numbers. Counters are TracedValues, and can therefore be
+ * hooked to through the Config system, for example at
+ * /NodeList/[i]/ApplicationList/[j]/$ns3::SimpleCunbServer/Metrics/HelloCount.
+ *
+ * If a SnapshotFile is set, one CSV row with the value of all counters is
+ * appended to it every SnapshotInterval while the server is running.
+ */
+class CunbServerMetrics : public Object
+{
+public:
+
+  /**
+   * A histogram with fixed-width bins. Samples beyond the last bin are
+   * counted in the last bin.
+   */
+  class Histogram
+  {
+  public:
+    Histogram (double binWidth = 1, uint32_t nBins = 1);
+
+    void Add (double value);
+    void Reset (void);
+
+    uint64_t GetCount (void) const;
+    double GetMean (void) const;
+    double GetMax (void) const;
+    double GetBinWidth (void) const;
+    uint32_t GetNBins (void) const;
+    uint64_t GetBinCount (uint32_t bin) const;
+
+    /**
+     * Get the upper edge of the bin where the given quantile falls.
+     */
+    double GetQuantile (double q) const;
+
+  private:
+    double m_binWidth;
+    std::vector<uint64_t> m_bins;
+    uint64_t m_count;
+    double m_sum;
+    double m_max;
+  };
+
+  static TypeId GetTypeId (void);
+
+  CunbServerMetrics ();
+  virtual ~CunbServerMetrics ();
+
+  /**
+   * Bring all counters and histograms back to zero.
+   */
+  void Reset (void);
+
+  void NotifyHello (void);
+  void NotifyAaRequest (void);
+  void NotifyGetRequest (void);
+  void NotifyGroupRequest (void);
+  void NotifyDuplicate (void);
+
+  /**
+   * A reply was sent in the given receive window (1, 2 or 3), latency after
+   * the reception of the uplink it answers.
+   */
+  void NotifyReply (uint8_t window, Time latency);
+
+  /**
+   * A reply was dropped since no eNB was available in any window.
+   */
+  void NotifyReplyGivenUp (void);
+
+  /**
+   * An eNB was picked for a downlink transmission.
+   *
+   * \param rank The position of the eNB in the MS's list of eNBs, sorted
+   * from the strongest to the weakest.
+   * \param enbId The node id of the eNB.
+   */
+  void NotifyEnbChoice (uint32_t rank, uint32_t enbId);
+
+  /**
+   * No eNB was available for a downlink transmission.
+   */
+  void NotifyNoEnbAvailable (void);
+
+  uint32_t GetHelloCount (void) const;
+  uint32_t GetAaRequestCount (void) const;
+  uint32_t GetGetRequestCount (void) const;
+  uint32_t GetGroupRequestCount (void) const;
+  uint32_t GetDuplicateCount (void) const;
+  uint32_t GetReplyCount (uint8_t window) const;
+  uint32_t GetReplyGivenUpCount (void) const;
+  uint32_t GetNoEnbCount (void) const;
+
+  const Histogram & GetReplyLatency (void) const;
+  const Histogram & GetEnbRank (void) const;
+  const std::map<uint32_t, uint64_t> & GetEnbChoices (void) const;
+
+  /**
+   * Start taking periodic snapshots, if a SnapshotFile is set.
+   */
+  void StartSnapshots (void);
+
+  /**
+   * Stop taking periodic snapshots, taking one last snapshot.
+   */
+  void StopSnapshots (void);
+
+  /**
+   * Append the current value of the counters to the snapshot file.
+   */
+  void Snapshot (void);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  void PeriodicSnapshot (void);
+
+  TracedValue<uint32_t> m_hello;       //!< Non duplicated HELLOs
+  TracedValue<uint32_t> m_aaRequest;   //!< Sent AA Requests
+  TracedValue<uint32_t> m_getRequest;  //!< Sent GET Requests
+  TracedValue<uint32_t> m_groupRequest; //!< Sent group GET Requests
+  TracedValue<uint32_t> m_duplicate;   //!< Uplinks already received through another eNB
+  TracedValue<uint32_t> m_reply1;      //!< Replies sent in the first window
+  TracedValue<uint32_t> m_reply2;      //!< Replies sent in the second window
+  TracedValue<uint32_t> m_reply3;      //!< Replies sent in the third window
+  TracedValue<uint32_t> m_replyGivenUp; //!< Replies without an available eNB
+  TracedValue<uint32_t> m_noEnb;       //!< Downlinks without an available eNB
+
+  Histogram m_replyLatency; //!< Uplink to reply latency, in seconds
+  Histogram m_enbRank;      //!< Rank of the eNB picked for downlinks
+  std::map<uint32_t, uint64_t> m_enbChoices; //!< Downlinks per eNB node id
+
+  std::string m_snapshotFileName;
+  Time m_snapshotInterval;
+  std::ofstream m_snapshotFile;
+  EventId m_snapshotEvent;
+};
+
+} /* namespace ns3 */
+
+#endif /* CUNB_SERVER_METRICS_H */
@@ -11,6 +11,9 @@
 #include "ns3/new-cosem-header.h"
 #include "ns3/cunb-linklayer-header.h"
 #include "ns3/app-layer-header.h"
+#include "ns3/uinteger.h"
+#include "ns3/double.h"
+#include "ns3/cunb-beacon-payload.h"
 
 namespace ns3 {
 
@@ -35,13 +38,41 @@ EnbCunbMac::GetTypeId (void)
                      MakeTraceSourceAccessor
                       (&EnbCunbMac::m_reqGet),
                          "ns3::Packet::TracedCallback")
+    .AddTraceSource ("SentGroupRequest",
+                     "Sent group downlink, "
+                     "to all the Smart Meters of a group",
+                     MakeTraceSourceAccessor
+                      (&EnbCunbMac::m_reqGroup),
+                         "ns3::Packet::TracedCallback")
+    .AddAttribute ("MsMaxTxPower",
+                   "Highest TX power of the MSs, announced by the beacons, "
+                   "in dBm",
+                   DoubleValue (19),
+                   MakeDoubleAccessor (&EnbCunbMac::m_msMaxTxPower),
+                   MakeDoubleChecker<double> (-128, 127))
+    .AddAttribute ("SuperframeSlots",
+                   "Number of uplink slots in the superframe announced by "
+                   "each beacon, 0 to let the MSs use pure ALOHA. The "
+                   "superframe should fit in the beacon interval",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&EnbCunbMac::m_superframeSlots),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("SlotDuration",
+                   "Duration of an uplink slot, a multiple of 10 ms that "
+                   "should fit the longest uplink frame",
+                   TimeValue (Seconds (2)),
+                   MakeTimeAccessor (&EnbCunbMac::m_slotDuration),
+                   MakeTimeChecker (MilliSeconds (10), MilliSeconds (655350)))
     .AddConstructor<EnbCunbMac> ()
     .SetGroupName ("cunb");
   return tid;
 }
 
 EnbCunbMac::EnbCunbMac ():
-		  m_beaconInterval(Seconds(50))
+		  m_beaconInterval(Seconds(50)),
+		  m_msMaxTxPower(19),
+		  m_superframeSlots(0),
+		  m_slotDuration(Seconds(2))
 {
   NS_LOG_FUNCTION (this);
 }
@@ -425,7 +456,7 @@ EnbCunbMac::CheckIfHello(Ptr<Packet> packet)
 void
 EnbCunbMac::SendBeacon(Ptr<Packet> beaconPacketDummy)
 {
-	 Ptr<Packet> beaconPacket = Create<Packet>(reinterpret_cast<const uint8_t*> ("19"),10);
+	 Ptr<Packet> beaconPacket = Create<Packet>();
 	 CunbDeviceAddress netAddr;
 	 CunbBeaconHeader hdr;
 	 //hdr.SetAddress(Mac48Address("ff:ff:ff:ff:ff:ff"));
@@ -436,8 +467,16 @@ EnbCunbMac::SendBeacon(Ptr<Packet> beaconPacketDummy)
 
 	 //Ptr<Packet> beaconPacket = Create<Packet> (2);  // 2 bytes of data
 	 hdr.SetData(data);
-	 hdr.SetGroupType(1);
+	 hdr.SetGroupType(CunbBeaconHeader::SYSTEM_INFO);
 	 hdr.SetGrpSeqNo(1);
+
+	 // The system information
+	 CunbBeaconPayload payload;
+	 payload.SetTxPower(m_msMaxTxPower);
+	 payload.SetSlotConfig(m_superframeSlots, m_slotDuration);
+	 payload.SetNetworkTime(Simulator::Now ());
+	 beaconPacket->AddHeader(payload);
+
 	 beaconPacket->AddHeader(hdr);
 	 beaconPacket->AddTrailer(tlr);
 
@@ -473,14 +512,49 @@ EnbCunbMac::SendBeacon(Ptr<Packet> beaconPacketDummy)
 	 m_channelHelper.AddEvent (duration, CreateObject<LogicalCunbChannel>
 	                               (frequency));
 
-	 beaconPacket->Print (std::cout);
-
 	 // Send the packet to the PHY layer to send it on the channel
 	 m_phy->Send (beaconPacket, params, frequency, sendingPower);
 
 	 m_beaconSendEvent = Simulator::Schedule (GetBeaconInterval (), &EnbCunbMac::SendBeacon, this, beaconPacket);
 }
 
+bool
+EnbCunbMac::SendGroupDownlink (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+
+  double frequency = GROUP_DOWNLINK_FREQUENCY;
+
+  // The broadcast channel is subject to the duty cycle like any other
+  if (GetWaitingTime (frequency) > Seconds (0))
+    {
+      NS_LOG_INFO ("Group downlink held back by the duty cycle");
+      m_cannotSendBecauseDutyCycle (packet);
+      return false;
+    }
+
+  // Group downlinks are sent like beacons, so that every MS hears them
+  CunbTxParameters params;
+  params.bitrate = 600;
+  params.nPreamble = 4;
+  params.eccEnabled = 1;
+  params.authEnabled = 1;
+  params.fcsEnabled = 1;
+
+  Time duration = m_phy->GetOnAirTime (packet, params, ENB);
+
+  double sendingPower = m_channelHelper.GetTxPowerForChannel
+      (CreateObject<LogicalCunbChannel> (frequency));
+
+  m_channelHelper.AddEvent (duration, CreateObject<LogicalCunbChannel>
+                              (frequency));
+
+  m_reqGroup (packet);
+
+  m_phy->Send (packet, params, frequency, sendingPower);
+  return true;
+}
+
 Time
 EnbCunbMac::GetBeaconInterval () const
 {
@@ -45,6 +45,21 @@ public:
   virtual void SendBeacon(Ptr<Packet> packet);
   virtual void ReceiveBeacon(Ptr<Packet const> packet);
 
+  /**
+   * Broadcast a group downlink built by the server on the beacon channel,
+   * unless the duty cycle of the channel forbids it.
+   *
+   * \param packet The full frame, from the broadcast CunbFrameHeader to the
+   * CunbBeaconTrailer.
+   * \return False if the duty cycle held the downlink back.
+   */
+  bool SendGroupDownlink (Ptr<Packet> packet);
+
+  /**
+   * The frequency group downlinks are broadcast on, in MHz.
+   */
+  static constexpr double GROUP_DOWNLINK_FREQUENCY = 868.5;
+
   // check the APDU type
   uint8_t CheckAPDUType(Ptr<Packet> packet);
 
@@ -131,6 +146,13 @@ private:
   Time m_tbtt;
   // \}
 
+  /// Highest TX power of the MSs announced by the beacons, in dBm
+  double m_msMaxTxPower;
+  /// Uplink slots in the superframe each beacon starts, 0 for ALOHA
+  uint16_t m_superframeSlots;
+  /// Duration of an uplink slot
+  Time m_slotDuration;
+
   /// Mesh point address
   Mac48Address m_mpAddress;
 
@@ -152,6 +174,7 @@ private:
 
   TracedCallback<Ptr<const Packet>> m_reqAssociation;
   TracedCallback<Ptr<const Packet>> m_reqGet;
+  TracedCallback<Ptr<const Packet>> m_reqGroup;
 
 protected:
 
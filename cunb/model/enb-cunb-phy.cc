@@ -1,4 +1,5 @@
 #include "ns3/enb-cunb-phy.h"
+#include "ns3/cunb-profiler.h"
 #include "ns3/cunb-tag.h"
 #include "ns3/simulator.h"
 #include "ns3/log.h"
@@ -98,7 +99,8 @@ EnbCunbPhy::GetTypeId (void)
 }
 
 EnbCunbPhy::EnbCunbPhy () :
-  m_isTransmitting (false)
+  m_isTransmitting (false),
+  m_occupancyRow (0)
 {
   //NS_LOG_FUNCTION_NOARGS ();
 }
@@ -131,6 +133,13 @@ EnbCunbPhy::ResetReceptionPaths (void)
   m_receptionPaths.clear ();
 }
 
+void
+EnbCunbPhy::SetChannelOccupancy (Ptr<CunbChannelOccupancy> occupancy, uint32_t row)
+{
+  m_channelOccupancy = occupancy;
+  m_occupancyRow = row;
+}
+
 void
 EnbCunbPhy::Send (Ptr<Packet> packet, CunbTxParameters txParams,
                       double frequencyMHz, double txPowerDbm)
@@ -194,6 +203,8 @@ void
 EnbCunbPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
                                Time duration, double frequencyMHz)
 {
+  CUNB_PROFILE_SCOPE ("EnbCunbPhy::StartReceive");
+
   NS_LOG_FUNCTION (this << packet << rxPowerDbm << duration << frequencyMHz);
 
   // Fire the trace source
@@ -203,6 +214,11 @@ EnbCunbPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
   Ptr<CunbInterferenceHelper::Event> event;
   event = m_interference.Add (duration, rxPowerDbm, packet, frequencyMHz);
 
+  if (m_channelOccupancy)
+    {
+      m_channelOccupancy->NotifyArrival (m_occupancyRow, frequencyMHz, duration);
+    }
+
   // Cycle over the receive paths to check availability to receive the packet
   std::list<Ptr<EnbCunbPhy::ReceptionPath> >::iterator it;
 
@@ -257,6 +273,11 @@ EnbCunbPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
   // If we get to this point, there are no demodulators we can use
   //NS_LOG_INFO ("Dropping packet reception of packet because no suitable demodulator was found for "<< frequencyMHz);
 
+  if (m_channelOccupancy)
+    {
+      m_channelOccupancy->NotifyNoMoreReceivers (m_occupancyRow, frequencyMHz);
+    }
+
   // Fire the trace source
   if (m_device)
     {
@@ -272,6 +293,8 @@ void
 EnbCunbPhy::EndReceive (Ptr<Packet> packet,
                             Ptr<CunbInterferenceHelper::Event> event)
 {
+  CUNB_PROFILE_SCOPE ("EnbCunbPhy::EndReceive");
+
   //NS_LOG_FUNCTION (this << packet << *event);
 
   // Call the trace source
@@ -294,6 +317,11 @@ EnbCunbPhy::EndReceive (Ptr<Packet> packet,
       tag.SetDestroyedBy (packetDestroyed);
       packet->AddPacketTag (tag);
 
+      if (m_channelOccupancy)
+        {
+          m_channelOccupancy->NotifyDestroyed (m_occupancyRow, event->GetFrequency ());
+        }
+
       // Fire the trace source
       if (m_device)
         {
@@ -7,6 +7,7 @@
 #include "ns3/mobility-model.h"
 #include "ns3/node.h"
 #include "ns3/cunb-phy.h"
+#include "ns3/cunb-channel-occupancy.h"
 #include "ns3/traced-value.h"
 #include <list>
 
@@ -59,6 +60,14 @@ public:
    */
   void ResetReceptionPaths (void);
 
+  /**
+   * Notify a CunbChannelOccupancy of the receptions of this eNB.
+   *
+   * \param occupancy The object to notify, or 0 to stop.
+   * \param row The row of this eNB in the occupancy matrices.
+   */
+  void SetChannelOccupancy (Ptr<CunbChannelOccupancy> occupancy, uint32_t row);
+
   /**
    * Receiver Sensitivity.
    */
@@ -179,6 +188,9 @@ private:
   bool m_isTransmitting; //!< Flag indicating whether a transmission is going on
 
   bool m_isReceiving; //!< Flag indicating whether a reception is going on
+
+  Ptr<CunbChannelOccupancy> m_channelOccupancy; //!< Notified of the receptions, if any
+  uint32_t m_occupancyRow; //!< Row of this eNB in m_channelOccupancy
 };
 
 } /* namespace ns3 */
@@ -5,7 +5,11 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("EnbStatus");
 
-EnbStatus::EnbStatus ()
+EnbStatus::EnbStatus () :
+  m_totalAirtime (Seconds (0)),
+  m_nDownlinks (0),
+  m_weight (1),
+  m_currentWeight (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -20,7 +24,11 @@ EnbStatus::EnbStatus (Address address, Ptr<NetDevice> netDevice,
   m_address (address),
   m_netDevice (netDevice),
   m_enbMac (enbMac),
-  m_nextTransmissionTime (Seconds (0))
+  m_nextTransmissionTime (Seconds (0)),
+  m_totalAirtime (Seconds (0)),
+  m_nDownlinks (0),
+  m_weight (1),
+  m_currentWeight (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -97,4 +105,75 @@ EnbStatus::SetNextTransmissionTime (Time nextTransmissionTime)
 {
   m_nextTransmissionTime = nextTransmissionTime;
 }
+
+Time
+EnbStatus::GetNextTransmissionTime (void)
+{
+  return m_nextTransmissionTime;
+}
+
+void
+EnbStatus::AddDownlink (Time airtime)
+{
+  NS_LOG_FUNCTION (this << airtime);
+
+  Time start = Simulator::Now ();
+  if (!m_downlinkEnds.empty () && m_downlinkEnds.back () > start)
+    {
+      start = m_downlinkEnds.back ();
+    }
+  m_downlinkEnds.push_back (start + airtime);
+
+  m_totalAirtime += airtime;
+  m_nDownlinks++;
+}
+
+uint32_t
+EnbStatus::GetQueueDepth (void)
+{
+  // Forget about the downlinks that are over
+  while (!m_downlinkEnds.empty () && m_downlinkEnds.front () <= Simulator::Now ())
+    {
+      m_downlinkEnds.pop_front ();
+    }
+  return m_downlinkEnds.size ();
+}
+
+Time
+EnbStatus::GetTotalAirtime (void) const
+{
+  return m_totalAirtime;
+}
+
+uint32_t
+EnbStatus::GetNDownlinks (void) const
+{
+  return m_nDownlinks;
+}
+
+void
+EnbStatus::SetWeight (uint32_t weight)
+{
+  NS_ASSERT (weight > 0);
+
+  m_weight = weight;
+}
+
+uint32_t
+EnbStatus::GetWeight (void) const
+{
+  return m_weight;
+}
+
+void
+EnbStatus::SetCurrentWeight (int64_t currentWeight)
+{
+  m_currentWeight = currentWeight;
+}
+
+int64_t
+EnbStatus::GetCurrentWeight (void) const
+{
+  return m_currentWeight;
+}
 }
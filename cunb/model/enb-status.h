@@ -5,6 +5,7 @@
 #include "ns3/address.h"
 #include "ns3/net-device.h"
 #include "ns3/enb-cunb-mac.h"
+#include <deque>
 
 namespace ns3 {
 
@@ -59,6 +60,43 @@ public:
   void SetNextTransmissionTime (Time nextTransmissionTime);
   Time GetNextTransmissionTime (void);
 
+  /**
+   * Account for a downlink packet handed to this eNB.
+   *
+   * The packet is considered queued at the eNB until the transmissions
+   * already queued there and its own airtime are over.
+   *
+   * \param airtime The time on air of the packet.
+   */
+  void AddDownlink (Time airtime);
+
+  /**
+   * Get the number of downlink packets queued or being sent by this eNB.
+   */
+  uint32_t GetQueueDepth (void);
+
+  /**
+   * Get the total time on air of the downlink packets sent through this eNB.
+   */
+  Time GetTotalAirtime (void) const;
+
+  /**
+   * Get the number of downlink packets sent through this eNB.
+   */
+  uint32_t GetNDownlinks (void) const;
+
+  /**
+   * Set the weight of this eNB for weighted round robin selection.
+   */
+  void SetWeight (uint32_t weight);
+  uint32_t GetWeight (void) const;
+
+  /**
+   * The running weight used by the smooth weighted round robin selection.
+   */
+  void SetCurrentWeight (int64_t currentWeight);
+  int64_t GetCurrentWeight (void) const;
+
 private:
 
   Address m_address; //!< The Address of the P2PNetDevice of this eNB
@@ -71,6 +109,16 @@ private:
                          //!transmission or not
 
   Time m_nextTransmissionTime; //!< This eNB's next transmission time
+
+  std::deque<Time> m_downlinkEnds; //!< End times of the queued downlinks
+
+  Time m_totalAirtime; //!< Time on air of all the downlinks
+
+  uint32_t m_nDownlinks; //!< Number of downlinks
+
+  uint32_t m_weight; //!< Weight for round robin selection
+
+  int64_t m_currentWeight; //!< Running weight for round robin selection
 };
 }
 
@@ -126,8 +126,7 @@ MobileAutonomousReporting::SendPacket (double frequency)
   m_mac->GetObject<MSCunbMac> ()->SetMType
       (CunbMacHeaderUl::SINGLE_ACK);
   m_mac->GetObject<MSCunbMac> ()->SetFrequencyToSend(frequency);
-  m_mac->Send (packet);
-
+  m_mac->GetObject<MSCunbMac> ()->SendBatched (packet);
 
   // Schedule the next SendPacket event
   m_sendEvent = Simulator::Schedule (m_interval, &MobileAutonomousReporting::SendPacket,
@@ -165,6 +164,12 @@ MobileAutonomousReporting::StopApplication (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
   Simulator::Cancel (m_sendEvent);
+
+  // Don't leave the last reports behind in the aggregation queue
+  if (m_mac != 0)
+    {
+      m_mac->GetObject<MSCunbMac> ()->FlushBatch ();
+    }
 }
 
 }
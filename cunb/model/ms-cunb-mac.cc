@@ -7,6 +7,9 @@
 #include "ns3/app-layer-header.h"
 #include "ns3/new-cosem-header.h"
 #include "ns3/cunb-tag.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
 
@@ -14,12 +17,46 @@ NS_LOG_COMPONENT_DEFINE ("MSCunbMac");
 
 NS_OBJECT_ENSURE_REGISTERED (MSCunbMac);
 
+const uint8_t MSCunbMac::MAX_REPETITIONS;
+
 TypeId
 MSCunbMac::GetTypeId (void)
 {
   static TypeId tid = TypeId ("ns3::MSCunbMac")
     .SetParent<CunbMac> ()
     .SetGroupName ("cunb")
+    .AddAttribute ("AdaptiveRepetitions",
+                   "Whether the number of repetitions of data packets follows "
+                   "the link margin and eNB count reported in the ACKs",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&MSCunbMac::m_adaptiveRepetitions),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HighLinkMargin",
+                   "Link margin, in dB, above which a MS heard by more than "
+                   "one eNB sends one repetition less",
+                   DoubleValue (20),
+                   MakeDoubleAccessor (&MSCunbMac::m_highLinkMargin),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("LowLinkMargin",
+                   "Link margin, in dB, below which a MS sends one "
+                   "repetition more",
+                   DoubleValue (6),
+                   MakeDoubleAccessor (&MSCunbMac::m_lowLinkMargin),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MaxBatchDelay",
+                   "Longest time a periodic report waits for others to share "
+                   "its frame. Zero to send each report in its own frame",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MSCunbMac::m_maxBatchDelay),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("PingSlotPeriod",
+                   "Time between two ping slots, in which the MS listens for "
+                   "downlinks once a beacon gave it the network time. A "
+                   "synchronised MS then only accepts the requests sent in "
+                   "its receive windows and ping slots. Zero to disable them",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&MSCunbMac::m_pingSlotPeriod),
+                   MakeTimeChecker (Seconds (0)))
     .AddTraceSource ("DataRate",
                      "Data Rate currently employed by this end device",
                      MakeTraceSourceAccessor
@@ -80,14 +117,19 @@ MSCunbMac::GetTypeId (void)
 MSCunbMac::MSCunbMac () :
   m_dataRate (0),
   m_txPower (0),
+  m_maxTxPower (0),
+  m_hasMaxTxPower (false),
+  m_txPowerIndex (0),
   m_receiveDelay1 (Seconds (0)),            // CUNB default
   m_receiveDelay2 (Seconds (4.5)),          // CUNB default
   m_receiveDelay3 (Seconds (9)),            // CUNB default
   m_receiveWindowDuration (Seconds (0.2)),  // Usually it should be 2*RTT
 
-  m_closeWindow (EventId ()),               // Initialize as the default eventId
-  // m_secondReceiveWindow (EventId ()),       // Initialize as the default eventId
-  // m_secondReceiveWindowDataRate (0),        // CUNB default
+  m_adaptiveRepetitions (false),
+  m_highLinkMargin (20),
+  m_lowLinkMargin (6),
+  m_windowEnd (Seconds (0)),
+  m_pingSlotEnd (Seconds (0)),
   m_lastKnownLinkMargin (0),
   m_lastKnownEnbCount (0),
   m_aggregatedDutyCycle (1),
@@ -95,33 +137,22 @@ MSCunbMac::MSCunbMac () :
   m_ifMARStarted(false),
   m_seq_cnt(0),
   m_ident(0),
-  m_freq_to_send(0.0)
+  m_freq_to_send(0.0),
+  m_superframeSlots (0),
+  m_slotDuration (Seconds (0)),
+  m_superframeStart (Seconds (0)),
+  m_networkTimeOffset (Seconds (0)),
+  m_networkTimeKnown (false),
+  m_pingSlotPeriod (Seconds (0)),
+  m_pingSlotFrequency (0),
+  m_maxBatchDelay (Seconds (0)),
+  m_batchSize (0)
 {
   //NS_LOG_FUNCTION (this);
 
   // Initialize the random variable we'll use to decide which channel to
   // transmit on.
   m_uniformRV = CreateObject<UniformRandomVariable> ();
-
-  // Void the two receiveWindow events
-  m_closeWindow = EventId ();
-  m_closeWindow.Cancel ();
-  m_secondReceiveWindow = EventId ();
-  m_secondReceiveWindow.Cancel ();
-  m_thirdReceiveWindow = EventId ();
-  m_thirdReceiveWindow.Cancel ();
-  m_firstRetransmit = EventId ();
-  m_firstRetransmit.Cancel ();
-  m_secondRetransmit = EventId ();
-  m_secondRetransmit.Cancel ();
-  m_secondReceiveRequestWindow = EventId ();
-  m_secondReceiveRequestWindow.Cancel ();
-  m_thirdReceiveRequestWindow = EventId ();
-  m_thirdReceiveRequestWindow.Cancel ();
-  m_firstHelloRetransmit = EventId ();
-  m_firstHelloRetransmit.Cancel ();
-  m_secondHelloRetransmit = EventId ();
-  m_secondHelloRetransmit.Cancel ();
 }
 
 MSCunbMac::~MSCunbMac ()
@@ -129,6 +160,25 @@ MSCunbMac::~MSCunbMac ()
   NS_LOG_FUNCTION_NOARGS ();
 }
 
+void
+MSCunbMac::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (std::list<EventId>::iterator it = m_heldSends.begin ();
+       it != m_heldSends.end (); ++it)
+    {
+      Simulator::Cancel (*it);
+    }
+  m_heldSends.clear ();
+  StopTimelines ();
+  Simulator::Cancel (m_pingSlotEvent);
+  Simulator::Cancel (m_batchEvent);
+  m_batch.clear ();
+
+  CunbMac::DoDispose ();
+}
+
 void
 MSCunbMac::SetOneTimeReporting(Ptr<OneTimeReporting> otr)
 {
@@ -169,6 +219,30 @@ void
 MSCunbMac::Send (Ptr<Packet> packet)
 {
   //NS_LOG_FUNCTION (this << packet);
+
+  // When slotted, hold the packet until the slot of this device comes
+  Time timeToSlot = GetTimeToSlot ();
+  if (timeToSlot.IsStrictlyPositive ())
+    {
+      NS_LOG_DEBUG ("Holding the packet " << timeToSlot.GetSeconds () <<
+                    " s for slot " << GetSlot ());
+      std::list<EventId>::iterator it = m_heldSends.begin ();
+      while (it != m_heldSends.end ())
+        {
+          if (it->IsExpired ())
+            {
+              it = m_heldSends.erase (it);
+            }
+          else
+            {
+              ++it;
+            }
+        }
+      m_heldSends.push_back (Simulator::Schedule (timeToSlot, &MSCunbMac::Send,
+                                                  this, packet));
+      return;
+    }
+
   Ptr<Packet> packetCopy = packet->Copy();
 
   NewCosemWrapperHeader wrapperHdr;
@@ -193,9 +267,8 @@ MSCunbMac::Send (Ptr<Packet> packet)
   // Check that there are no scheduled receive windows.
    // We cannot send a packet if we are in the process of transmitting or waiting
    // for reception.
-  //NS_LOG_INFO("m_closeWindow.IsExpired () "<<m_closeWindow.IsExpired ());
 
-   if ((!m_closeWindow.IsExpired () || !m_secondReceiveWindow.IsExpired () || !m_thirdReceiveWindow.IsExpired ()) && apdu!=GETRES_N )
+   if ((IsReceiveWindowOpen () || IsWaitingForReply ()) && apdu!=GETRES_N )
      {
        NS_LOG_WARN ("Attempting to send when there are receive windows" <<" Transmission canceled");
        return;
@@ -220,29 +293,32 @@ MSCunbMac::Send (Ptr<Packet> packet)
       // Add the Cunb Frame Header to the packet
       CunbFrameHeaderUl frameHdr;
       ApplyNecessaryOptions (frameHdr);
+
+      // Piggy-back the pending MAC commands that fit next to the payload.
+      // Those that don't are left for the next frames.
+      uint8_t budget = GetFOptsBudget (m_dataRate, packet->GetSize ());
+      std::list<Ptr<CunbMacCommand> >::iterator cmd = m_macCommandList.begin ();
+      while (cmd != m_macCommandList.end ())
+        {
+          if (frameHdr.AddCommand (*cmd, budget))
+            {
+              cmd = m_macCommandList.erase (cmd);
+            }
+          else
+            {
+              ++cmd;
+            }
+        }
       packet->AddHeader (frameHdr);
 
-      // Add the Cunb Mac header to the packet
+      // Keep what the repetitions have in common with this frame
+      Ptr<const Packet> payload = packet->Copy ();
+
+      // Add the Cunb Mac header and trailer to the packet
       CunbMacHeaderUl macHdr;
       ApplyNecessaryOptions (macHdr);
       macHdr.SetRepCnts(0);
-
-      macHdr.SetSeqCnt(m_seq_cnt);
-      macHdr.SetIdent(m_ident);
-      packet->AddHeader (macHdr);
-
-      m_seq_cnt+=1;
-      // cycle it back to 0
-      NS_LOG_INFO("seq_no:"<< (int)m_seq_cnt);
-      //if(m_seq_cnt == 16) m_seq_cnt = 0;
-      if(m_seq_cnt == 256) m_seq_cnt = 0;
-
-      CunbMacTrailer macTlr;
-      macTlr.EnableFcs(true);
-      macTlr.SetFcs(packet);
-      macTlr.SetMacHeader(macHdr);
-      macTlr.SetAuth(packet);
-      packet->AddTrailer(macTlr);
+      uint8_t seqNo = AddMacHeaderAndTrailer (packet, macHdr);
 
       // Craft CunbTxParameters object
       CunbTxParameters params;
@@ -268,11 +344,12 @@ MSCunbMac::Send (Ptr<Packet> packet)
          }
       //m_phy->Send (packet, params, txChannel->GetFrequency (), m_txPower);
 
-      if(this->GetFrequencyToSend()==0.0)
+      if(this->GetFrequencyToSend()==0.0 || IsSlotted ())
       {
     	  m_phy->Send (packet, params, txChannel->GetFrequency (), m_txPower);
 
     	  m_phy->GetObject<MSCunbPhy> ()->SetFrequency (txChannel->GetFrequency ());
+    	  m_pingSlotFrequency = txChannel->GetFrequency ();
       }
       else
       {
@@ -280,6 +357,7 @@ MSCunbMac::Send (Ptr<Packet> packet)
 
           // Switch the PHY to the channel so that it will listen here for downlink
           m_phy->GetObject<MSCunbPhy> ()->SetFrequency (this->GetFrequencyToSend());
+          m_pingSlotFrequency = this->GetFrequencyToSend();
       }
 
       //////////////////////////////////////////////
@@ -298,49 +376,14 @@ MSCunbMac::Send (Ptr<Packet> packet)
       // Prepare for the downlink //
       //////////////////////////////
 
-      // Schedule the opening of the first receive window.
-      Simulator::Schedule (m_receiveDelay1,&MSCunbMac::OpenFirstReceiveWindow, this ,pType);
-
-      // Now just return if its an Hello packet
-      //if( pType == 10){m_sendHello(packet); return;}
-
       if( pType == 10)
-
       {
-    	  //NS_LOG_INFO("Scheduling the first retransmit hello for "<< Simulator::Now()+ m_receiveDelay2);
     	  m_sendHello(packet);
-    	  //m_secondReceiveRequestWindow = Simulator::Schedule(m_receiveDelay2,&MSCunbMac::OpenSecondReceiveWindow,this);
-    	  m_firstHelloRetransmit = Simulator::Schedule(m_receiveDelay2,&MSCunbMac::RetransmitHello, this,packet,1);
-
-    	  //m_thirdReceiveRequestWindow = Simulator::Schedule(m_receiveDelay3,&MSCunbMac::OpenThirdReceiveWindow,this);
-    	  m_secondHelloRetransmit = Simulator::Schedule(m_receiveDelay3,&MSCunbMac::RetransmitHello, this,packet,2);
       }
 
-
-      // Normal and Alarm Packets for both commercial and household
-     //if((pType == 1 || pType == 2 || pType == 4 || pType == 5) && !(apduType==1||apduType==0))
-     //if((pType == 1 || pType == 2 || pType == 4 || pType == 5) && !(apduType==1))
-     if(pType == 1 || pType == 2 || pType == 4 || pType == 5)
-      {
-      	  // Schedule the opening of the second receive window
-    	  //NS_LOG_INFO("retransmitting ");
-          m_secondReceiveWindow = Simulator::Schedule (m_receiveDelay2,
-                                                     &MSCunbMac::OpenSecondReceiveWindow,this);
-          // Retransmit the packet
-          m_firstRetransmit = Simulator::Schedule(m_receiveDelay2,&MSCunbMac::SendRetransmitted, this,packet,1);
-      }
-
-      // Alarm packets for both Household and commercial
-      //if((pType == 2 || pType == 5) && !(apduType==1||apduType==0))
-    //if((pType == 2 || pType == 5) && !(apduType==1))
-    if(pType == 2 || pType == 5)
-      {
-          // Schedule the opening of the third receive window
-          m_thirdReceiveWindow = Simulator::Schedule (m_receiveDelay3,
-                                                       &MSCunbMac::OpenThirdReceiveWindow,this);
-          // Retransmit the packet
-          m_secondRetransmit = Simulator::Schedule(m_receiveDelay3,&MSCunbMac::SendRetransmitted, this, packet,2);
-       }
+      // Open the receive windows and send the repetitions this type of
+      // packet calls for
+      StartTimeline (payload, pType, seqNo);
 
     }
   else // Transmission cannot be performed
@@ -348,31 +391,132 @@ MSCunbMac::Send (Ptr<Packet> packet)
       m_cannotSendBecauseDutyCycle (packet);
     }
 }
+
 void
-MSCunbMac::RetransmitHello(Ptr<Packet> packet, uint8_t repCount)
+MSCunbMac::SendBatched (Ptr<Packet> packet)
 {
-	// Set the RepCount field of the MAC Header to 1 from 0
-	//NS_LOG_FUNCTION (this << packet);
+  NS_LOG_FUNCTION (this << packet);
+
+  if (m_maxBatchDelay.IsZero ())
+    {
+      Send (packet);
+      return;
+    }
+
+  // Without a payload limit for this DataRate, only the latency bounds the batch
+  uint32_t maxPayload = 0;
+  if (m_dataRate < m_maxAppPayloadForDataRate.size ())
+    {
+      maxPayload = m_maxAppPayloadForDataRate[m_dataRate];
+    }
+
+  // Send the reports already queued if this one doesn't fit with them
+  if (maxPayload > 0 && !m_batch.empty ()
+      && m_batchSize + packet->GetSize () > maxPayload)
+    {
+      FlushBatch ();
+    }
+
+  m_batch.push_back (packet);
+  m_batchSize += packet->GetSize ();
+
+  if (maxPayload > 0 && m_batchSize >= maxPayload)
+    {
+      FlushBatch ();
+    }
+  else if (!m_batchEvent.IsRunning ())
+    {
+      m_batchEvent = Simulator::Schedule (m_maxBatchDelay,
+                                          &MSCunbMac::FlushBatch, this);
+    }
+}
+
+void
+MSCunbMac::FlushBatch (void)
+{
+  NS_LOG_FUNCTION (this << m_batch.size ());
 
-	CunbMacTrailer macTlrRemove;
-	packet->RemoveTrailer(macTlrRemove);
+  Simulator::Cancel (m_batchEvent);
+  if (m_batch.empty ())
+    {
+      return;
+    }
 
-	CunbMacHeaderUl macHdrRemove;
-	packet->RemoveHeader (macHdrRemove);
+  // The reports follow each other, the first one leading the frame
+  Ptr<Packet> frame = m_batch.front ();
+  for (uint32_t i = 1; i < m_batch.size (); i++)
+    {
+      frame->AddAtEnd (m_batch[i]);
+    }
+  NS_LOG_DEBUG ("Sending " << m_batch.size () << " reports in a " <<
+                frame->GetSize () << " bytes frame");
+
+  m_batch.clear ();
+  m_batchSize = 0;
+
+  Send (frame);
+}
+
+uint8_t
+MSCunbMac::AddMacHeaderAndTrailer (Ptr<Packet> packet, CunbMacHeaderUl macHdr)
+{
+  uint8_t seqNo = m_seq_cnt;
+  macHdr.SetSeqCnt(m_seq_cnt);
+  macHdr.SetIdent(m_ident);
+  packet->AddHeader (macHdr);
+
+  m_seq_cnt+=1;
+  // cycle it back to 0
+  NS_LOG_INFO("seq_no:"<< (int)m_seq_cnt);
+  //if(m_seq_cnt == 16) m_seq_cnt = 0;
+  if(m_seq_cnt == 256) m_seq_cnt = 0;
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs(true);
+  macTlr.SetFcs(packet);
+  macTlr.SetMacHeader(macHdr);
+  macTlr.SetAuth(packet);
+  packet->AddTrailer(macTlr);
+
+  return seqNo;
+}
+
+Ptr<Packet>
+MSCunbMac::BuildRepetition (Ptr<const Packet> payload, uint16_t pType,
+                            uint8_t repCount, uint8_t &seqNo)
+{
+  // The payload is shared with the other frames, only the copy is written
+  Ptr<Packet> frame = payload->Copy ();
+
+  // Add the Cunb Mac header with new repCount
+  CunbMacHeaderUl macHdr;
+  if (pType == 10)
+    {
+      macHdr.SetMType(CunbMacHeaderUl::HELLO);
+    }
+  else
+    {
+      ApplyNecessaryOptions (macHdr);
+    }
+  macHdr.SetRepCnts(repCount);
+  seqNo = AddMacHeaderAndTrailer (frame, macHdr);
+
+  return frame;
+}
+
+void
+MSCunbMac::RetransmitHello(TimelineIterator timeline, uint8_t repCount)
+{
+	//NS_LOG_FUNCTION (this << packet << (int)repCount);
 
     // Check that there are no scheduled receive windows.
 	// We cannot send a packet if we are in the process of transmitting or waiting for reception.
 
-	if ((!m_closeWindow.IsExpired () || !m_thirdReceiveWindow.IsExpired ()) && repCount == 1)
+	if (IsReceiveWindowOpen ())
 	{
 		  //NS_LOG_WARN ("Attempting to send when there are receive windows" <<" Transmission canceled");
 		  return;
 	}
-	if (!m_closeWindow.IsExpired () && repCount == 2)
-	{
-		  //NS_LOG_WARN ("Attempting to send when there are receive windows" <<" Transmission canceled");
-		  	  return;
-	}
 
 
     // Pick a channel on which to transmit the packet
@@ -380,31 +524,12 @@ MSCunbMac::RetransmitHello(Ptr<Packet> packet, uint8_t repCount)
 
 	if (txChannel) // Proceed with transmission
 	{
-
-		  // Add the Cunb Mac header with new repCount
-		  CunbMacHeaderUl macHdr;
-		  macHdr.SetMType(CunbMacHeaderUl::HELLO);
-		  macHdr.SetRepCnts(repCount);
-
-
-	      macHdr.SetSeqCnt(m_seq_cnt);
-	      macHdr.SetIdent(m_ident);
-		  packet->AddHeader (macHdr);
-
-		  m_seq_cnt+=1;
-
-		  // cycle it back to 0
-		  //if(m_seq_cnt == 16) m_seq_cnt = 0;
-		  if(m_seq_cnt == 256) m_seq_cnt = 0;
-
-		  CunbMacTrailer macTlr;
-		  macTlr.EnableFcs(true);
-		  macTlr.SetFcs(packet);
-		  macTlr.SetMacHeader(macHdr);
-
-		  macTlr.SetAuth(packet);
-		  packet->AddTrailer(macTlr);
-
+		  // Only now that it is sent does the repetition take a sequence
+		  // number
+		  uint8_t seqNo;
+		  Ptr<Packet> packet = BuildRepetition (timeline->payload, 10, repCount,
+		                                        seqNo);
+		  timeline->seqNos.push_back (seqNo);
 
 		  // Craft CunbTxParameters object
 		  CunbTxParameters params;
@@ -440,72 +565,26 @@ MSCunbMac::RetransmitHello(Ptr<Packet> packet, uint8_t repCount)
 		    }
 		  else // Transmission cannot be performed
 		      {
-		        m_cannotSendBecauseDutyCycle (packet);
+		        m_cannotSendBecauseDutyCycle (timeline->payload);
 		      }
 }
 
 void
-MSCunbMac::SendRetransmitted(Ptr<Packet> packet,uint8_t repCount)
+MSCunbMac::SendRetransmitted(TimelineIterator timeline, uint8_t repCount)
 {
-	//NS_LOG_FUNCTION (this << packet);
-
-    CunbMacTrailer macTlrRemove;
-    packet->RemoveTrailer(macTlrRemove);
-
-    CunbMacHeaderUl macHdrRemove;
-    packet->RemoveHeader (macHdrRemove);
-
-	// Check that there are no scheduled receive windows.
-	// We cannot send a packet if we are in the process of transmitting or waiting
-	// for reception.
-/*
-    NS_LOG_INFO(" m_closeWindow.IsExpired () : "<<m_closeWindow.IsExpired ());
-	if ((!m_closeWindow.IsExpired () || !m_thirdReceiveWindow.IsExpired ()) && repCount == 1)
-	{
-	      NS_LOG_WARN ("Attempting to send in second window when there are receive windows Transmission canceled");
-	      return;
-	}
-	if (!m_closeWindow.IsExpired () && repCount == 2)
-	{
-	  	  NS_LOG_WARN ("Attempting to send in third window when there are receive windows Transmission canceled");
-	  	  return;
-	}
-*/
-	// Check that payload length is below the allowed maximum
-	// Here we need to use the technique of Fragmentation and Reassembly
-	// Currently it drops the packet if the packet size is higher than maxPayload allowed
-	// yet to be implemented
+	//NS_LOG_FUNCTION (this << packet << (int)repCount);
 
 	// Pick a channel on which to transmit the packet
 	Ptr<LogicalCunbChannel> txChannel = GetChannelForTx ();
 
 	if (txChannel) // Proceed with transmission
 	    {
-
-	      // Add the Cunb Mac header with new repCount
-	      CunbMacHeaderUl macHdr;
-	      ApplyNecessaryOptions (macHdr);
-	      macHdr.SetRepCnts(repCount);
-
-	      NS_LOG_INFO("seq_no:"<< (int)m_seq_cnt);
-		  //NS_LOG_INFO(" The sequence Number "<< (int)m_seq_cnt << " ident "<< (int)m_ident);
-	      macHdr.SetSeqCnt(m_seq_cnt);
-	      macHdr.SetIdent(m_ident);
-	      packet->AddHeader (macHdr);
-
-	      m_seq_cnt+=1;
-
-		  // cycle it back to 0
-		  //if(m_seq_cnt == 16) m_seq_cnt = 0;
-	      if(m_seq_cnt == 256) m_seq_cnt = 0;
-
-	      CunbMacTrailer macTlr;
-	      macTlr.EnableFcs(true);
-	      macTlr.SetFcs(packet);
-	      macTlr.SetMacHeader(macHdr);
-	      macTlr.SetAuth(packet);
-	      packet->AddTrailer(macTlr);
-
+	      // Only now that it is sent does the repetition take a sequence
+	      // number
+	      uint8_t seqNo;
+	      Ptr<Packet> packet = BuildRepetition (timeline->payload,
+	                                            timeline->pType, repCount, seqNo);
+	      timeline->seqNos.push_back (seqNo);
 
 	      // Craft CunbTxParameters object
 	      CunbTxParameters params;
@@ -521,7 +600,7 @@ MSCunbMac::SendRetransmitted(Ptr<Packet> packet,uint8_t repCount)
 	      NS_ASSERT (m_txPower <= m_channelHelper.GetTxPowerForChannel (txChannel));
 	      m_phy->GetObject<MSCunbPhy> ()->SwitchToStandby ();
 
-	      if(this->GetFrequencyToSend()==0.0)
+	      if(this->GetFrequencyToSend()==0.0 || IsSlotted ())
 	      {
 
 	      m_phy->Send (packet, params, txChannel->GetFrequency (), m_txPower);
@@ -546,21 +625,10 @@ MSCunbMac::SendRetransmitted(Ptr<Packet> packet,uint8_t repCount)
 
 	      // Register the sent packet into the LogicalCunbChannelHelper
 	      m_channelHelper.AddEvent (duration, txChannel);
-
-	     // NS_LOG_INFO("Sending Frequency at MS CUNB MAC" << txChannel->GetFrequency ());
-
-	      //////////////////////////////
-	      // Prepare for the downlink //
-	      //////////////////////////////
-
-
-	      // Instruct the PHY on the right data rate to listen for during the window
-	      //uint8_t replyDataRate = GetFirstReceiveWindowDataRate ();
-	      //NS_LOG_DEBUG ("m_dataRate: " << unsigned (m_dataRate) <<", replyDataRate: " << unsigned (replyDataRate));
 	    }
 	  else // Transmission cannot be performed
 	      {
-	        m_cannotSendBecauseDutyCycle (packet);
+	        m_cannotSendBecauseDutyCycle (timeline->payload);
 	      }
 
 }
@@ -681,13 +749,35 @@ MSCunbMac::Receive (Ptr<Packet const> packet)
           // After the First ACK received use that frequency for further transmission
           this->SetFrequencyToSend(tag.GetFrequency());
 
-          // If it exists, cancel the second and third receive window event
-          Simulator::Cancel (m_secondReceiveWindow);
-          Simulator::Cancel (m_thirdReceiveWindow);
-
-          // If it exists, cancel the first and second retransmission
-          Simulator::Cancel(m_firstRetransmit);
-          Simulator::Cancel(m_secondRetransmit);
+          // Apply the MAC commands the ACK carries in its options
+          std::list<Ptr<CunbMacCommand> >::const_iterator it;
+          for (it = frameHdr.GetCommands ().begin ();
+               it != frameHdr.GetCommands ().end (); ++it)
+            {
+              ApplyMacCommand (*it);
+            }
+
+          // Keep the link information the server put in the ACK, if any
+          if (hdr.GetEnbCount () > 0)
+            {
+              m_lastKnownLinkMargin = hdr.GetLinkMargin ();
+              m_lastKnownEnbCount = hdr.GetEnbCount ();
+            }
+
+          // The frame got through: drop the receive windows and
+          // repetitions still ahead of it. Those of a HELLO stay, since a
+          // HELLO is only answered by a request
+          for (TimelineIterator it = m_timelines.begin ();
+               it != m_timelines.end (); ++it)
+            {
+              if (it->pType != 10 &&
+                  std::find (it->seqNos.begin (), it->seqNos.end (), ackbit)
+                  != it->seqNos.end ())
+                {
+                  StopTimeline (it);
+                  break;
+                }
+            }
 
           // Call the trace source
           m_receivedPacket (packet);
@@ -744,6 +834,25 @@ MSCunbMac::ReceiveRequest(Ptr<Packet const> packet)
 	    // Determine whether this packet is for that mobile device
 	    bool messageForUs = (m_address == frameHdr.GetAddress ());
 
+	    // Once synchronised, the MS only listens in its receive windows and
+	    // ping slots, which the preamble of the request must fall in
+	    if (messageForUs && IsPingSlotSynchronised ())
+	    {
+	        CunbTxParameters params;
+	        params.bitrate = 600;
+	        params.nPreamble = 4;
+	        params.eccEnabled = 1;
+	        params.authEnabled = 1;
+	        params.fcsEnabled = 1;
+	        Time start = Simulator::Now () -
+	          CunbPhy::GetOnAirTime (packet->Copy (), params, ENB);
+	        if (!IsListening (start))
+	        {
+	            NS_LOG_DEBUG ("Dropping a request sent while the MS wasn't listening");
+	            return;
+	        }
+	    }
+
 	    // Call the One time reporting for sending response
 	    if(messageForUs)
 	    {
@@ -751,21 +860,7 @@ MSCunbMac::ReceiveRequest(Ptr<Packet const> packet)
 	    	// and also the second and third receive window
 
 	    	//NS_LOG_INFO("Request is for Us!!");
-            Simulator::Cancel (m_secondReceiveRequestWindow);
-	        Simulator::Cancel (m_thirdReceiveRequestWindow);
-
-	        Simulator::Cancel(m_firstHelloRetransmit);
-	        Simulator::Cancel(m_secondHelloRetransmit);
-
-
-	        // Cancel the events created due to AA Response retransmit too
-	          // If it exists, cancel the second and third receive window event
-	          Simulator::Cancel (m_secondReceiveWindow);
-	          Simulator::Cancel (m_thirdReceiveWindow);
-
-	          // If it exists, cancel the first and second retransmission
-	          Simulator::Cancel(m_firstRetransmit);
-	          Simulator::Cancel(m_secondRetransmit);
+	        StopTimelines ();
 
             m_oneTimeReporting->ReceiveRequest(packetCopy);
 	    }
@@ -820,22 +915,174 @@ MSCunbMac::ExtractBeaconInformation(Ptr<Packet const> beaconPacket)
 		  CunbBeaconHeader beaconHdr;
 		  packetCopy->RemoveHeader (beaconHdr);
 
-		  packetCopy->Print(std::cout);
+		  // Remove the elements that follow it
+		  CunbBeaconPayload payload;
+		  packetCopy->RemoveHeader (payload);
+
+		  // A request to a group rather than system information
+		  if (beaconHdr.GetGroupType () == CunbBeaconHeader::GROUP_REQUEST)
+		  {
+			  if (payload.Has (CunbBeaconPayload::GROUP_INFO))
+			  {
+				  ReceiveGroupRequest (beaconHdr.GetGrpSeqNo (), payload, packetCopy);
+			  }
+			  return;
+		  }
 
-		  //NS_LOG_INFO("Data "<< beaconHdr.GetData());
-		  //NS_LOG_INFO("GroupType "<< beaconHdr.GetGroupType());
+		  if (beaconHdr.GetGroupType () != CunbBeaconHeader::SYSTEM_INFO)
+		  {
+			  return;
+		  }
 
 		  //set the Tx parameters based on the data collected from the beacon packet
-		  if(beaconHdr.GetGroupType() == 1)
+		  if (payload.Has (CunbBeaconPayload::TX_POWER))
 		  {
-			  uint8_t *buffer = new uint8_t[packetCopy->GetSize ()];
-			  packetCopy->CopyData(buffer, packetCopy->GetSize ());
-			  char temp[packetCopy->GetSize()];
-			  memcpy(temp,buffer,packetCopy->GetSize());
-			  //NS_LOG_INFO("Data if matched "<< temp);
-			  //m_txPower = (double)beaconHdr.GetData();
-			  m_txPower = atof(temp);
+			  m_maxTxPower = payload.GetTxPower ();
+			  m_hasMaxTxPower = true;
+			  m_txPower = m_maxTxPower - LinkAdrReq::TX_POWER_STEP * m_txPowerIndex;
 		  }
+
+		  // The superframe, if any, starts with this beacon
+		  m_superframeSlots = 0;
+		  if (payload.Has (CunbBeaconPayload::SLOT_CONFIG))
+		  {
+			  m_superframeSlots = payload.GetSlotCount ();
+			  m_slotDuration = payload.GetSlotDuration ();
+		  }
+		  m_superframeStart = Simulator::Now ();
+
+		  if (payload.Has (CunbBeaconPayload::NETWORK_TIME))
+		  {
+			  // The eNB stamps the beacon when it starts sending it, the MS
+			  // only gets it once it has been received in full
+			  CunbTxParameters params;
+			  params.bitrate = 600;
+			  params.nPreamble = 4;
+			  params.eccEnabled = 1;
+			  params.authEnabled = 1;
+			  params.fcsEnabled = 1;
+			  Time start = Simulator::Now () -
+			    CunbPhy::GetOnAirTime (beaconPacket->Copy (), params, ENB);
+			  m_networkTimeOffset = payload.GetNetworkTime () - start;
+			  m_networkTimeKnown = true;
+
+			  // Realign the ping slots on the new network time
+			  if (IsPingSlotSynchronised ())
+			  {
+				  SchedulePingSlot ();
+			  }
+		  }
+}
+
+Time
+MSCunbMac::GetNetworkTime (void) const
+{
+  return Simulator::Now () + m_networkTimeOffset;
+}
+
+void
+MSCunbMac::JoinGroup (uint16_t groupId, uint16_t slot)
+{
+  NS_LOG_FUNCTION (this << groupId << slot);
+
+  GroupMembership membership;
+  membership.slot = slot;
+  membership.lastSeqNo = 0xFF; // Not a valid 5 bits GrpSeqNo
+  m_groups[groupId] = membership;
+}
+
+void
+MSCunbMac::LeaveGroup (uint16_t groupId)
+{
+  NS_LOG_FUNCTION (this << groupId);
+
+  m_groups.erase (groupId);
+}
+
+void
+MSCunbMac::ReceiveGroupRequest (uint8_t grpSeqNo,
+                                const CunbBeaconPayload &payload,
+                                Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << unsigned (grpSeqNo) << packet);
+
+  uint16_t groupId = payload.GetGroupId ();
+  std::map<uint16_t, GroupMembership>::iterator it = m_groups.find (groupId);
+  if (it == m_groups.end ())
+    {
+      return;
+    }
+
+  // Several eNBs may broadcast the same request
+  if (it->second.lastSeqNo == grpSeqNo)
+    {
+      NS_LOG_DEBUG ("Already answering request " << unsigned (grpSeqNo) <<
+                    " of group " << groupId);
+      return;
+    }
+  it->second.lastSeqNo = grpSeqNo;
+
+  if (m_oneTimeReporting == 0)
+    {
+      NS_LOG_WARN ("No application to answer the group request");
+      return;
+    }
+
+  // Answer in the slot of this device, the packet being left with the request
+  Time delay = TimeStep (payload.GetGroupSlotDuration ().GetTimeStep () *
+                         it->second.slot);
+  NS_LOG_DEBUG ("Answering group " << groupId << " in " <<
+                delay.GetSeconds () << " s");
+  Simulator::Schedule (delay, &OneTimeReporting::ReceiveRequest,
+                       m_oneTimeReporting, packet);
+}
+
+void
+MSCunbMac::ApplyMacCommand (Ptr<CunbMacCommand> command)
+{
+  NS_LOG_FUNCTION (this << command->GetCommandType ());
+
+  switch (command->GetCommandType ())
+    {
+    case LINK_ADR_REQ:
+      {
+        Ptr<LinkAdrReq> linkAdrReq = DynamicCast<LinkAdrReq> (command);
+
+        // The step is relative to the maximum the beacons announce: until
+        // one is heard, it is only kept for the first of them to apply
+        m_txPowerIndex = linkAdrReq->GetTxPower ();
+        if (m_hasMaxTxPower)
+          {
+            m_txPower = m_maxTxPower - LinkAdrReq::TX_POWER_STEP * m_txPowerIndex;
+            NS_LOG_INFO ("TX power set to " << m_txPower << " dBm");
+          }
+
+        uint8_t dataRate = linkAdrReq->GetDataRate ();
+        if (dataRate != LinkAdrReq::KEEP_DATA_RATE)
+          {
+            SetDataRate (dataRate);
+          }
+
+        // Only the answer to the last request matters
+        std::list<Ptr<CunbMacCommand> >::iterator it = m_macCommandList.begin ();
+        while (it != m_macCommandList.end ())
+          {
+            if ((*it)->GetCommandType () == LINK_ADR_ANS)
+              {
+                it = m_macCommandList.erase (it);
+              }
+            else
+              {
+                ++it;
+              }
+          }
+        m_macCommandList.push_back (Create<LinkAdrAns> (true, true, true));
+        break;
+      }
+    default:
+      NS_LOG_WARN ("Ignoring MAC command " << command->GetCommandType ());
+      break;
+    }
 }
 
 void
@@ -877,35 +1124,9 @@ MSCunbMac::OpenFirstReceiveWindow (uint8_t ptype)
   // Set Phy in Standby mode
   m_phy->GetObject<MSCunbPhy> ()->SwitchToStandby ();
 
-  // Schedule return to sleep after "at least the time required by the end
-  // device's radio transceiver to effectively detect a downlink preamble"
-  m_closeWindow = Simulator::Schedule (m_receiveWindowDuration,
-                                       &MSCunbMac::CloseFirstReceiveWindow, this);
-}
-
-void
-MSCunbMac::CloseFirstReceiveWindow (void)
-{
-  //NS_LOG_FUNCTION_NOARGS ();
-
-  Ptr<MSCunbPhy> phy = m_phy->GetObject<MSCunbPhy> ();
-
-  // Check the Phy layer's state:
-  // - RX -> We have received a preamble.
-  // - STANDBY -> Nothing was detected.
-  // We should never be in TX or SLEEP mode at this point
-  switch (phy->GetState ())
-    {
-    case MSCunbPhy::TX:
-    	break;
-    case MSCunbPhy::RX:
-      // PHY is receiving: let it finish. The Receive method will switch it back to SLEEP.
-      break;
-    case MSCunbPhy::STANDBY:
-      // Turn PHY layer to SLEEP
-      //phy->SwitchToSleep ();
-      break;
-    }
+  // Stay open for "at least the time required by the end device's radio
+  // transceiver to effectively detect a downlink preamble"
+  m_windowEnd = Simulator::Now () + m_receiveWindowDuration;
 }
 
 void
@@ -931,37 +1152,9 @@ MSCunbMac::OpenSecondReceiveWindow (void)
   m_phy->GetObject<MSCunbPhy> ()->SetFrequency
     (m_secondReceiveWindowFrequency);
 
-  // Schedule return to sleep after "at least the time required by the end
-  // device's radio transceiver to effectively detect a downlink preamble"
-  m_closeWindow = Simulator::Schedule (m_receiveWindowDuration,
-                                       &MSCunbMac::CloseSecondReceiveWindow, this);
-}
-
-void
-MSCunbMac::CloseSecondReceiveWindow (void)
-{
-  //NS_LOG_FUNCTION_NOARGS ();
-
-  Ptr<MSCunbPhy> phy = m_phy->GetObject<MSCunbPhy> ();
-
-  // NS_ASSERT (phy->m_state != EndDeviceLoraPhy::TX &&
-  // phy->m_state != EndDeviceLoraPhy::SLEEP);
-
-  // Check the Phy layer's state:
-  // - RX -> We have received a preamble.
-  // - STANDBY -> Nothing was detected.
-  switch (phy->GetState ())
-    {
-    case MSCunbPhy::TX:
-      break;
-    case MSCunbPhy::RX:
-      // PHY is receiving: let it finish
-      break;
-    case MSCunbPhy::STANDBY:
-      // Turn PHY layer to sleep
-      //phy->SwitchToSleep ();
-      break;
-    }
+  // Stay open for "at least the time required by the end device's radio
+  // transceiver to effectively detect a downlink preamble"
+  m_windowEnd = Simulator::Now () + m_receiveWindowDuration;
 }
 
 void
@@ -988,34 +1181,191 @@ MSCunbMac::OpenThirdReceiveWindow (void)
   m_phy->GetObject<MSCunbPhy> ()->SetFrequency
     (m_thirdReceiveWindowFrequency);
 
-  // Schedule return to sleep after "at least the time required by the end
-  // device's radio transceiver to effectively detect a downlink preamble"
-  m_closeWindow = Simulator::Schedule (m_receiveWindowDuration,
-                                       &MSCunbMac::CloseThirdReceiveWindow, this);
+  // Stay open for "at least the time required by the end device's radio
+  // transceiver to effectively detect a downlink preamble"
+  m_windowEnd = Simulator::Now () + m_receiveWindowDuration;
+}
+
+bool
+MSCunbMac::IsReceiveWindowOpen (void) const
+{
+  return Simulator::Now () < m_windowEnd;
+}
+
+bool
+MSCunbMac::IsPingSlotOpen (void) const
+{
+  return Simulator::Now () < m_pingSlotEnd;
+}
+
+bool
+MSCunbMac::IsListening (Time time) const
+{
+  // Only the last window and ping slot matter: the MS listens in one at a
+  // time
+  return (time < m_windowEnd && time >= m_windowEnd - m_receiveWindowDuration)
+         || (time < m_pingSlotEnd
+             && time >= m_pingSlotEnd - m_receiveWindowDuration);
+}
+
+/////////////////////
+// Uplink timeline //
+/////////////////////
+
+uint8_t
+MSCunbMac::GetNRepetitions (uint16_t pType) const
+{
+  uint8_t nRepetitions;
+  switch (pType)
+    {
+    case 10: // HELLO, never adapted since no ACK has been received yet
+      return 2;
+    case 2:  // Alarm packets, household and commercial
+    case 5:
+      nRepetitions = 2;
+      break;
+    case 1:  // Normal packets, household and commercial
+    case 4:
+      nRepetitions = 1;
+      break;
+    default:
+      return 0;
+    }
+
+  // Nothing to adapt to until an ACK carried link information
+  if (!m_adaptiveRepetitions || m_lastKnownEnbCount == 0)
+    {
+      return nRepetitions;
+    }
+
+  // A device heard well by several eNBs hardly needs repetitions, while
+  // one barely heard needs all the repetitions it can get
+  if (m_lastKnownLinkMargin >= m_highLinkMargin && m_lastKnownEnbCount > 1)
+    {
+      nRepetitions--;
+    }
+  else if (m_lastKnownLinkMargin < m_lowLinkMargin || m_lastKnownEnbCount == 1)
+    {
+      nRepetitions = std::min<uint8_t> (nRepetitions + 1, MAX_REPETITIONS);
+    }
+  return nRepetitions;
 }
 
 void
-MSCunbMac::CloseThirdReceiveWindow (void)
+MSCunbMac::StartTimeline (Ptr<const Packet> payload, uint16_t pType,
+                          uint8_t seqNo)
 {
-  //NS_LOG_FUNCTION_NOARGS ();
+  NS_LOG_FUNCTION (this << pType << unsigned (seqNo));
+
+  Timeline timeline;
+  timeline.state = TIMELINE_IDLE;
+  timeline.start = Simulator::Now ();
+  timeline.pType = pType;
+  timeline.payload = payload;
+  timeline.nRepetitions = GetNRepetitions (pType);
+  timeline.seqNos.push_back (seqNo);
+
+  // The timelines of earlier frames go on: only their ACK stops them
+  m_timelines.push_back (timeline);
+  ScheduleTimeline (--m_timelines.end (), TIMELINE_FIRST_WINDOW,
+                    m_receiveDelay1);
+}
 
-  Ptr<MSCunbPhy> phy = m_phy->GetObject<MSCunbPhy> ();
+void
+MSCunbMac::ScheduleTimeline (TimelineIterator timeline,
+                             enum TimelineState state, Time offset)
+{
+  timeline->state = state;
+  timeline->timer = Simulator::Schedule (timeline->start + offset - Simulator::Now (),
+                                         &MSCunbMac::AdvanceTimeline, this,
+                                         timeline);
+}
 
-  // Check the Phy layer's state:
-  // - RX -> We have received a preamble.
-  // - STANDBY -> Nothing was detected.
-  switch (phy->GetState ())
+void
+MSCunbMac::StopTimeline (TimelineIterator timeline)
+{
+  Simulator::Cancel (timeline->timer);
+  m_timelines.erase (timeline);
+}
+
+void
+MSCunbMac::StopTimelines (void)
+{
+  while (!m_timelines.empty ())
     {
-    case MSCunbPhy::TX:
+      StopTimeline (m_timelines.begin ());
+    }
+}
+
+bool
+MSCunbMac::IsWaitingForReply (void) const
+{
+  // HELLOs are only repeated, they don't open further windows
+  for (std::list<Timeline>::const_iterator it = m_timelines.begin ();
+       it != m_timelines.end (); ++it)
+    {
+      if ((it->state == TIMELINE_FIRST_REPEAT
+           || it->state == TIMELINE_SECOND_REPEAT)
+          && it->pType != 10)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+MSCunbMac::AdvanceTimeline (TimelineIterator timeline)
+{
+  NS_LOG_FUNCTION (this << timeline->state);
+
+  uint8_t nRepetitions = timeline->nRepetitions;
+  bool isHello = (timeline->pType == 10);
+
+  switch (timeline->state)
+    {
+    case TIMELINE_FIRST_WINDOW:
+      OpenFirstReceiveWindow (timeline->pType);
+      if (nRepetitions >= 1)
+        {
+          ScheduleTimeline (timeline, TIMELINE_FIRST_REPEAT, m_receiveDelay2);
+          return;
+        }
+      break;
+    case TIMELINE_FIRST_REPEAT:
+      if (isHello)
+        {
+          RetransmitHello (timeline, 1);
+        }
+      else
+        {
+          OpenSecondReceiveWindow ();
+          SendRetransmitted (timeline, 1);
+        }
+      if (nRepetitions >= 2)
+        {
+          ScheduleTimeline (timeline, TIMELINE_SECOND_REPEAT, m_receiveDelay3);
+          return;
+        }
       break;
-    case MSCunbPhy::RX:
-      // PHY is receiving: let it finish
+    case TIMELINE_SECOND_REPEAT:
+      if (isHello)
+        {
+          RetransmitHello (timeline, 2);
+        }
+      else
+        {
+          OpenThirdReceiveWindow ();
+          SendRetransmitted (timeline, 2);
+        }
       break;
-    case MSCunbPhy::STANDBY:
-      // Turn PHY layer to sleep
-      //phy->SwitchToSleep ();
+    case TIMELINE_IDLE:
+      NS_ASSERT_MSG (false, "The timer expired with nothing pending");
       break;
     }
+
+  // Nothing left to do for this frame
+  m_timelines.erase (timeline);
 }
 
 Ptr<LogicalCunbChannel>
@@ -1023,9 +1373,21 @@ MSCunbMac::GetChannelForTx (void)
 {
   //NS_LOG_FUNCTION_NOARGS ();
 
-  // Pick a random channel to transmit on
   std::vector<Ptr<LogicalCunbChannel> > logicalChannels;
   logicalChannels = m_channelHelper.GetChannelList (); // Use a separate list to do the shuffle
+
+  // When slotted, use the channel of this device if it's free
+  if (IsSlotted () && !logicalChannels.empty ())
+    {
+      Ptr<LogicalCunbChannel> logicalChannel = logicalChannels.at
+        ((GetSlotHash () / m_superframeSlots) % logicalChannels.size ());
+      if (m_channelHelper.GetWaitingTime (logicalChannel) == Seconds (0))
+        {
+          return logicalChannel;
+        }
+    }
+
+  // Pick a random channel to transmit on
   logicalChannels = Shuffle (logicalChannels);
 
   // Try every channel
@@ -1056,6 +1418,129 @@ MSCunbMac::GetChannelForTx (void)
   return 0; // In this case, no suitable channel was found
 }
 
+bool
+MSCunbMac::IsSlotted (void) const
+{
+  return m_superframeSlots > 0 && m_slotDuration.IsStrictlyPositive ();
+}
+
+uint32_t
+MSCunbMac::GetSlotHash (void) const
+{
+  // Knuth's multiplicative hash, with the high bits folded back in
+  uint32_t hash = m_ident * 2654435761u;
+  return hash ^ (hash >> 16);
+}
+
+uint16_t
+MSCunbMac::GetSlot (void) const
+{
+  if (!IsSlotted ())
+    {
+      return 0;
+    }
+  return GetSlotHash () % m_superframeSlots;
+}
+
+Time
+MSCunbMac::GetTimeToSlot (void) const
+{
+  if (!IsSlotted ())
+    {
+      return Seconds (0);
+    }
+
+  // Superframes follow each other from the last beacon on
+  int64_t slotDuration = m_slotDuration.GetTimeStep ();
+  int64_t superframe = slotDuration * m_superframeSlots;
+  int64_t elapsed = (Simulator::Now () - m_superframeStart).GetTimeStep ();
+
+  int64_t wait = slotDuration * GetSlot () - elapsed % superframe;
+  if (wait < 0)
+    {
+      wait += superframe;
+    }
+  return TimeStep (wait);
+}
+
+Time
+MSCunbMac::GetPingSlotPeriod (void) const
+{
+  return m_pingSlotPeriod;
+}
+
+Time
+MSCunbMac::GetPingSlotOffset (void) const
+{
+  return ComputePingSlotOffset (m_address, m_pingSlotPeriod,
+                                m_receiveWindowDuration);
+}
+
+Time
+MSCunbMac::ComputePingSlotOffset (CunbDeviceAddress address, Time period,
+                                  Time slotDuration)
+{
+  if (period.IsZero ())
+    {
+      return Seconds (0);
+    }
+
+  // The period holds as many ping slots as fit in it
+  int64_t slot = slotDuration.GetTimeStep ();
+  int64_t nSlots = std::max<int64_t> (period.GetTimeStep () / slot, 1);
+
+  uint32_t hash = address.Get () * 2654435761u;
+  hash ^= hash >> 16;
+  return TimeStep (slot * (hash % nSlots));
+}
+
+bool
+MSCunbMac::IsPingSlotSynchronised (void) const
+{
+  return !m_pingSlotPeriod.IsZero () && m_networkTimeKnown;
+}
+
+void
+MSCunbMac::SchedulePingSlot (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Ping periods follow each other from network time zero on
+  int64_t period = m_pingSlotPeriod.GetTimeStep ();
+  int64_t elapsed = (GetNetworkTime () - GetPingSlotOffset ()).GetTimeStep ();
+  int64_t wait = period - ((elapsed % period) + period) % period;
+
+  Simulator::Cancel (m_pingSlotEvent);
+  m_pingSlotEvent = Simulator::Schedule (TimeStep (wait),
+                                         &MSCunbMac::OpenPingSlot, this);
+}
+
+void
+MSCunbMac::OpenPingSlot (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  SchedulePingSlot ();
+
+  // An uplink in progress already listens for its own downlinks
+  Ptr<MSCunbPhy> phy = m_phy->GetObject<MSCunbPhy> ();
+  if (phy->GetState () != MSCunbPhy::STANDBY || IsReceiveWindowOpen ()
+      || IsWaitingForReply ())
+    {
+      NS_LOG_DEBUG ("Skipping the ping slot, the MS is busy");
+      return;
+    }
+
+  // Listen where the server sends its requests to: the last uplink's channel
+  if (m_pingSlotFrequency != 0)
+    {
+      phy->SetFrequency (m_pingSlotFrequency);
+    }
+
+  // A ping slot, unlike a receive window, doesn't hold the uplinks back
+  m_pingSlotEnd = Simulator::Now () + m_receiveWindowDuration;
+}
+
 std::vector<Ptr<LogicalCunbChannel> >
 MSCunbMac::Shuffle (std::vector<Ptr<LogicalCunbChannel> > vector)
 {
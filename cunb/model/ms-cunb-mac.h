@@ -15,10 +15,14 @@
 #include "ns3/mac48-address.h"
 #include "ns3/cunb-beacon-header.h"
 #include "ns3/cunb-beacon-trailer.h"
+#include "ns3/cunb-beacon-payload.h"
 #include "ns3/node-container.h"
 #include "ns3/one-time-reporting.h"
 #include "ns3/mobile-autonomous-reporting.h"
 #include "ns3/hello-sender.h"
+#include <list>
+#include <map>
+
 namespace ns3 {
 
 /**
@@ -46,9 +50,24 @@ public:
    */
   virtual void Send (Ptr<Packet> packet);
 
-  void SendRetransmitted(Ptr<Packet> packet, uint8_t repCount);
+  /**
+   * Queue a periodic report, so that it shares its frame with the reports
+   * that follow it.
+   *
+   * The queued reports are sent as soon as they fill the maximum application
+   * payload of the current DataRate, or MaxBatchDelay after the oldest of
+   * them was queued. Each report keeps its wrapper header, whose length lets
+   * the server split the frame again. With a zero MaxBatchDelay, the report
+   * is sent right away.
+   *
+   * \param packet The report, starting with its wrapper header.
+   */
+  void SendBatched (Ptr<Packet> packet);
 
-  void RetransmitHello(Ptr<Packet> packet, uint8_t repCount);
+  /**
+   * Send the queued reports, if any, in a single frame.
+   */
+  void FlushBatch (void);
 
   /**
    * Receive a packet.
@@ -86,19 +105,70 @@ public:
   void OpenThirdReceiveWindow (void);
 
   /**
-   * Perform operations needed to close the first receive window.
+   * Check whether one of the receive windows is currently open.
    */
-  void CloseFirstReceiveWindow (void);
+  bool IsReceiveWindowOpen (void) const;
 
   /**
-   * Perform operations needed to close the second receive window.
+   * Check whether a ping slot is currently open. Unlike the receive
+   * windows, ping slots don't hold the uplinks back.
    */
-  void CloseSecondReceiveWindow (void);
+  bool IsPingSlotOpen (void) const;
 
   /**
-    * Perform operations needed to close the third receive window.
-    */
-  void CloseThirdReceiveWindow (void);
+   * Check whether the last beacon announced a superframe, in which case this
+   * device only starts its uplinks in its own slot, on its own channel.
+   */
+  bool IsSlotted (void) const;
+
+  /**
+   * Get the slot of this device in the superframe, derived from its ident.
+   */
+  uint16_t GetSlot (void) const;
+
+  /**
+   * Get the time until the next start of this device's slot, 0 if the
+   * device isn't slotted.
+   */
+  Time GetTimeToSlot (void) const;
+
+  /**
+   * Get the current network time, as synchronised by the last beacon that
+   * carried it.
+   */
+  Time GetNetworkTime (void) const;
+
+  /**
+   * Get the time between two ping slots of this device, 0 if it only
+   * receives after its own uplinks.
+   */
+  Time GetPingSlotPeriod (void) const;
+
+  /**
+   * Get the offset of this device's ping slots from the start of each ping
+   * period, in network time, derived from its address.
+   */
+  Time GetPingSlotOffset (void) const;
+
+  /**
+   * Get the offset of the ping slots of a device from the start of each
+   * ping period. The server uses it to aim at the ping slots of the MSs
+   * without asking them.
+   *
+   * \param address The address of the device.
+   * \param period The ping slot period, 0 if the device opens no ping slot.
+   * \param slotDuration How long a ping slot lasts.
+   */
+  static Time ComputePingSlotOffset (CunbDeviceAddress address, Time period,
+                                     Time slotDuration);
+
+  /**
+   * Check whether this device currently opens ping slots, that is, whether
+   * it has a ping slot period and a beacon gave it the network time. Such
+   * a device only accepts the requests that start in one of its receive
+   * windows or ping slots.
+   */
+  bool IsPingSlotSynchronised (void) const;
 
   // check the APDU type
   uint8_t CheckAPDUType(Ptr<Packet> packet);
@@ -230,6 +300,12 @@ public:
    */
   void ApplyNecessaryOptions (CunbMacHeaderUl &macHeader);
 
+  /**
+   * Act on a MAC command received from the server, queueing the answer to
+   * it, if any, in the list of commands for the next uplinks.
+   */
+  void ApplyMacCommand (Ptr<CunbMacCommand> command);
+
   /**
    * Set the message type to send when the Send method is called.
    */
@@ -297,6 +373,20 @@ public:
 
   void ExtractBeaconInformation(Ptr<Packet const> beaconPacket);
 
+  /**
+   * Make this device a member of a group, so that it answers the group
+   * downlinks meant for it.
+   *
+   * \param groupId The group to join.
+   * \param slot The response slot of this device in the group.
+   */
+  void JoinGroup (uint16_t groupId, uint16_t slot);
+
+  void LeaveGroup (uint16_t groupId);
+
+protected:
+  virtual void DoDispose (void);
+
 private:
 
   /**
@@ -330,6 +420,23 @@ private:
    */
   TracedValue<double> m_txPower;
 
+  /**
+   * The highest transmission power this device may use, as announced by
+   * the beacons, in dBm.
+   */
+  double m_maxTxPower;
+
+  /**
+   * Whether a beacon announced m_maxTxPower yet.
+   */
+  bool m_hasMaxTxPower;
+
+  /**
+   * The TX power step the server asked this device to use, each step
+   * lowering m_txPower by LinkAdrReq::TX_POWER_STEP from m_maxTxPower.
+   */
+  uint8_t m_txPowerIndex;
+
   /**
    * The interval between when a packet is done sending and when the first
    * receive window is opened.
@@ -354,32 +461,159 @@ private:
   Time m_receiveWindowDuration;
 
   /**
-   * The event of the closing of a receive window.
+   * The steps of the timeline that follows an uplink transmission.
    *
-   * This Event will be canceled if there's a successful reception of a packet.
+   * Each state names what happens when the timer of the timeline next
+   * expires.
    */
-  EventId m_closeWindow;
+  enum TimelineState
+  {
+    TIMELINE_IDLE,          //!< Nothing is pending
+    TIMELINE_FIRST_WINDOW,  //!< Open the first receive window
+    TIMELINE_FIRST_REPEAT,  //!< Send the first repetition, at m_receiveDelay2
+    TIMELINE_SECOND_REPEAT  //!< Send the second repetition, at m_receiveDelay3
+  };
 
   /**
-   * The event of the second receive window opening.
+   * Add a MAC header and trailer to a packet, stamping the header with the
+   * next sequence number.
    *
-   * This Event is used to cancel the second window in case the first one is
-   * successful.
+   * \return The sequence number the header was stamped with.
    */
-  EventId m_secondReceiveWindow;
+  uint8_t AddMacHeaderAndTrailer (Ptr<Packet> packet, CunbMacHeaderUl macHdr);
 
   /**
-     * The event of the third receive window opening.
-     *
-     * This Event is used to cancel the third window in case the second one is
-     * successful.
-     */
-  EventId m_thirdReceiveWindow;
+   * Build a complete repetition frame.
+   *
+   * \param payload The packet with everything below the MAC header, shared
+   * by the original frame and all of its repetitions.
+   * \param pType The type of the application packet.
+   * \param repCount The repetition counter to put in the MAC header.
+   * \param seqNo Set to the sequence number of the repetition.
+   * \return A new packet, with its own MAC header and trailer.
+   */
+  Ptr<Packet> BuildRepetition (Ptr<const Packet> payload, uint16_t pType,
+                               uint8_t repCount, uint8_t &seqNo);
+
+  /**
+   * The receive windows and repetitions that follow an uplink frame.
+   */
+  struct Timeline
+  {
+    EventId timer;                 //!< The single pending event of the timeline
+    enum TimelineState state;      //!< What happens when timer expires
+    Time start;                    //!< Time the frame was sent
+    uint16_t pType;                //!< Application type of the frame
+    Ptr<const Packet> payload;     //!< Packet below the MAC header
+    uint8_t nRepetitions;          //!< Repetitions planned after the frame
+    std::vector<uint8_t> seqNos;   //!< Numbers of the frames sent so far
+  };
 
-  EventId m_firstRetransmit;
+  typedef std::list<Timeline>::iterator TimelineIterator;
 
-  EventId m_secondRetransmit;
+  /**
+   * Send a repetition of the data frame of a timeline.
+   *
+   * The repetition is built from the payload of the timeline, and takes a
+   * sequence number, only if a channel is available to send it.
+   *
+   * \param timeline The timeline of the frame.
+   * \param repCount The position of the repetition, starting from 1.
+   */
+  void SendRetransmitted(TimelineIterator timeline, uint8_t repCount);
 
+  /**
+   * Send a repetition of the HELLO of a timeline, unless a receive window is
+   * open.
+   *
+   * \param timeline The timeline of the HELLO.
+   * \param repCount The position of the repetition, starting from 1.
+   */
+  void RetransmitHello(TimelineIterator timeline, uint8_t repCount);
+
+  /**
+   * Start the timeline of a frame that was just sent, next to those of the
+   * frames still waiting for their ACK.
+   *
+   * \param payload The packet below the MAC header, from which the
+   * repetitions are built when they are sent.
+   * \param pType The type of the application packet, which decides how many
+   * repetitions and receive windows follow.
+   * \param seqNo The sequence number of the frame.
+   */
+  void StartTimeline (Ptr<const Packet> payload, uint16_t pType, uint8_t seqNo);
+
+  /**
+   * Take the action a timeline is waiting for, and arm its timer for the
+   * next one.
+   */
+  void AdvanceTimeline (TimelineIterator timeline);
+
+  /**
+   * Arm the timer of a timeline for the given state, offset after its start.
+   */
+  void ScheduleTimeline (TimelineIterator timeline, enum TimelineState state,
+                         Time offset);
+
+  /**
+   * Drop whatever is left of a timeline.
+   */
+  void StopTimeline (TimelineIterator timeline);
+
+  /**
+   * Drop whatever is left of all the timelines.
+   */
+  void StopTimelines (void);
+
+  /**
+   * Check whether a timeline still has receive windows ahead, in which case
+   * a new transmission would overlap with them.
+   */
+  bool IsWaitingForReply (void) const;
+
+  /**
+   * Get the number of repetitions sent after a packet of the given type.
+   *
+   * The number depends on the type alone, unless AdaptiveRepetitions is
+   * set, in which case it is lowered or raised by one depending on the last
+   * link margin and eNB count received from the server.
+   */
+  uint8_t GetNRepetitions (uint16_t pType) const;
+
+  /**
+   * The largest number of repetitions, one per receive window after the
+   * first.
+   */
+  static const uint8_t MAX_REPETITIONS = 2;
+
+  bool m_adaptiveRepetitions; //!< Whether the repetitions follow the link
+  double m_highLinkMargin;    //!< Margin above which repetitions are lowered, in dB
+  double m_lowLinkMargin;     //!< Margin below which repetitions are raised, in dB
+
+  /**
+   * The timelines of the frames sent, each with a single pending event.
+   *
+   * The timeline of a frame is dropped when its ACK is received, along with
+   * the receive windows and repetitions that were still ahead.
+   */
+  std::list<Timeline> m_timelines;
+
+  /**
+   * The time the currently open receive window closes. A window is open as
+   * long as this time is in the future.
+   */
+  Time m_windowEnd;
+
+  /**
+   * The time the last ping slot closes.
+   */
+  Time m_pingSlotEnd;
+
+  /**
+   * Check whether the last receive window or ping slot was open at the
+   * given time.
+   */
+  bool IsListening (Time time) const;
 
   /**
    * The address of this device.
@@ -406,19 +640,6 @@ private:
    */
   uint8_t m_thirdReceiveWindowDataRate;
 
-  /*
-   * Implementation of Events for Re-sending Hello
-   * if no AA-Request is received for the Smart Meter
-   *
-   * */
-
-  EventId m_secondReceiveRequestWindow;
-  EventId m_thirdReceiveRequestWindow;
-  Time m_firstReceiveRequestWindowDuration;
-  Time m_secondReceiveRequestWindowDuration;
-  EventId m_firstHelloRetransmit;
-  EventId m_secondHelloRetransmit;
-
   /**
    * The last known link margin.
    *
@@ -470,6 +691,63 @@ private:
 
   double m_freq_to_send; // This is used to reuse the same frequency with which the ACK has been received for the data packet for further transmission
 
+  /**
+   * Spread the ident of this device over the slots and channels, so that
+   * consecutive idents don't end up in neighbouring slots.
+   */
+  uint32_t GetSlotHash (void) const;
+
+  /**
+   * Answer the request of a group downlink, if this device is a member of
+   * the group and didn't already.
+   *
+   * \param grpSeqNo The GrpSeqNo of the beacon header, which tells the
+   * requests of a group apart.
+   * \param payload The elements of the beacon, GROUP_INFO among them.
+   * \param packet The rest of the frame, i.e., the request.
+   */
+  void ReceiveGroupRequest (uint8_t grpSeqNo, const CunbBeaconPayload &payload,
+                            Ptr<Packet> packet);
+
+  /**
+   * The membership of this device in a group.
+   */
+  struct GroupMembership
+  {
+    uint16_t slot;     //!< Response slot of this device
+    uint8_t lastSeqNo; //!< GrpSeqNo of the last request answered
+  };
+
+  std::map<uint16_t, GroupMembership> m_groups; //!< Groups, by id
+
+  uint16_t m_superframeSlots; //!< Slots announced by the last beacon, 0 for ALOHA
+  Time m_slotDuration;        //!< Slot duration announced by the last beacon
+  Time m_superframeStart;     //!< Time the last beacon was received
+  Time m_networkTimeOffset;   //!< Network time minus local time, from the beacons
+  bool m_networkTimeKnown;    //!< Whether a beacon carried the network time
+
+  /**
+   * Schedule the opening of the next ping slot, replacing the one pending.
+   */
+  void SchedulePingSlot (void);
+
+  /**
+   * Open a receive window for downlinks the server sends unprompted, then
+   * schedule the next one.
+   */
+  void OpenPingSlot (void);
+
+  Time m_pingSlotPeriod;       //!< Time between two ping slots, 0 to disable them
+  EventId m_pingSlotEvent;     //!< Opening of the next ping slot
+  double m_pingSlotFrequency;  //!< Frequency of the last uplink, in MHz
+
+  Time m_maxBatchDelay;                //!< Longest wait of a queued report, 0 to disable
+  std::vector<Ptr<Packet> > m_batch;   //!< Reports waiting to be sent together
+  uint32_t m_batchSize;                //!< Total size of the queued reports
+  EventId m_batchEvent;                //!< Flush of the queue at the latency bound
+
+  std::list<EventId> m_heldSends; //!< Sends of the packets held for their slot
+
 };
 
 } /* namespace ns3 */
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include "ns3/ms-cunb-phy.h"
+#include "ns3/cunb-profiler.h"
 #include "ns3/simulator.h"
 #include "ns3/cunb-tag.h"
 #include "ns3/cunb-frame-header.h"
@@ -82,6 +83,7 @@ MSCunbPhy::Send (Ptr<Packet> packet, CunbTxParameters txParams,
   // Tag the packet with information
   CunbTag tag;
   packet->RemovePacketTag (tag);
+  tag.SetFrequency (frequencyMHz);
   packet->AddPacketTag (tag);
 
   // Send the packet over the channel
@@ -120,6 +122,7 @@ void
 MSCunbPhy::StartReceive (Ptr<Packet> packet, double rxPowerDbm,
                                 Time duration, double frequencyMHz)
 {
+  CUNB_PROFILE_SCOPE ("MSCunbPhy::StartReceive");
 
   //NS_LOG_FUNCTION (this << packet << rxPowerDbm  << duration <<frequencyMHz);
 
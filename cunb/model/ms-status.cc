@@ -6,7 +6,18 @@ namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("MSStatus");
 
-MSStatus::MSStatus ()
+const uint8_t MSStatus::MAX_RANKED_ENBS;
+constexpr double MSStatus::RSSI_SMOOTHING;
+const uint8_t MSStatus::MARGIN_HISTORY;
+const uint16_t MSStatus::SEQ_WINDOW;
+
+MSStatus::MSStatus () :
+  m_nEnbs (0),
+  m_nMargins (0),
+  m_marginHead (0),
+  m_lastSeqNo (0),
+  m_hasUplinks (false),
+  m_txPowerIndex (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -17,7 +28,13 @@ MSStatus::~MSStatus ()
 }
 
 MSStatus::MSStatus (Ptr<MSCunbMac> msMac) :
-  m_mac (msMac)
+  m_mac (msMac),
+  m_nEnbs (0),
+  m_nMargins (0),
+  m_marginHead (0),
+  m_lastSeqNo (0),
+  m_hasUplinks (false),
+  m_txPowerIndex (0)
 {
   NS_LOG_FUNCTION (this);
 
@@ -53,56 +70,292 @@ MSStatus::UpdateEnbData (Address enbAddress, double rcvPower)
 {
   NS_LOG_FUNCTION (this << enbAddress << rcvPower);
 
-  std::map<Address, double>::iterator it = m_enbs.find (enbAddress);
-  if (it != m_enbs.end ())
+  // Look for the eNB among the ranked ones
+  uint8_t i = 0;
+  while (i < m_nEnbs && m_enbs[i].address != enbAddress)
     {
-      // Erase the existing entry
-      m_enbs.erase (it);
+      i++;
     }
-  // Create a new entry
-  m_enbs.insert (std::pair<Address, double> (enbAddress, rcvPower));
 
+  if (i < m_nEnbs)
+    {
+      // Smooth the new sample into the existing entry
+      m_enbs[i].rcvPower += RSSI_SMOOTHING * (rcvPower - m_enbs[i].rcvPower);
+    }
+  else if (m_nEnbs < MAX_RANKED_ENBS)
+    {
+      // Add a new entry at the bottom
+      i = m_nEnbs++;
+      m_enbs[i].address = enbAddress;
+      m_enbs[i].rcvPower = rcvPower;
+    }
+  else if (rcvPower > m_enbs[m_nEnbs - 1].rcvPower)
+    {
+      // Replace the weakest entry
+      i = m_nEnbs - 1;
+      m_enbs[i].address = enbAddress;
+      m_enbs[i].rcvPower = rcvPower;
+    }
+  else
+    {
+      // Weaker than all the ranked eNBs
+      return;
+    }
+
+  // Move the updated entry to its place, the rest of the array being sorted
+  RankedEnb updated = m_enbs[i];
+  while (i > 0 && m_enbs[i - 1].rcvPower < updated.rcvPower)
+    {
+      m_enbs[i] = m_enbs[i - 1];
+      i--;
+    }
+  while (i + 1 < m_nEnbs && m_enbs[i + 1].rcvPower > updated.rcvPower)
+    {
+      m_enbs[i] = m_enbs[i + 1];
+      i++;
+    }
+  m_enbs[i] = updated;
 }
 
-Address
-MSStatus::GetBestEnbAddress (void)
+void
+MSStatus::AddMarginSample (double margin, bool sameUplink)
+{
+  NS_LOG_FUNCTION (this << margin << sameUplink);
+
+  if (sameUplink && m_nMargins > 0)
+    {
+      uint8_t last = (m_marginHead + MARGIN_HISTORY - 1) % MARGIN_HISTORY;
+      m_margins[last] = std::max (m_margins[last], margin);
+      return;
+    }
+
+  m_margins[m_marginHead] = margin;
+  m_marginHead = (m_marginHead + 1) % MARGIN_HISTORY;
+  if (m_nMargins < MARGIN_HISTORY)
+    {
+      m_nMargins++;
+    }
+}
+
+uint8_t
+MSStatus::GetNMarginSamples (void) const
+{
+  return m_nMargins;
+}
+
+double
+MSStatus::GetMaxMargin (uint8_t nUplinks) const
+{
+  NS_ASSERT (m_nMargins > 0 && nUplinks > 0);
+
+  // The valid entries are the m_nMargins ones before m_marginHead, the
+  // most recent first
+  uint8_t n = std::min (nUplinks, m_nMargins);
+  double maxMargin = m_margins[(m_marginHead + MARGIN_HISTORY - 1) % MARGIN_HISTORY];
+  for (uint8_t i = 1; i < n; i++)
+    {
+      uint8_t j = (m_marginHead + MARGIN_HISTORY - 1 - i) % MARGIN_HISTORY;
+      maxMargin = std::max (maxMargin, m_margins[j]);
+    }
+  return maxMargin;
+}
+
+void
+MSStatus::ClearMarginHistory (void)
 {
   NS_LOG_FUNCTION (this);
 
-  return (*(std::max_element (m_enbs.begin (), m_enbs.end (),
-                              [] (const std::pair<Address, double>&p1,
-                                  const std::pair<Address, double>&p2)
-                              { return p1.second > p2.second; }
-                              ))).first;
+  m_nMargins = 0;
+  m_marginHead = 0;
 }
 
-std::list<Address>
-MSStatus::GetSortedEnbAddresses (void)
+bool
+MSStatus::HasUplink (uint8_t seqNo) const
+{
+  if (!m_hasUplinks)
+    {
+      return false;
+    }
+
+  // The sequence numbers just after the last one are new, whatever the bits
+  // left from the previous lap of the counter
+  uint8_t ahead = seqNo - m_lastSeqNo;
+  if (ahead != 0 && ahead < SEQ_WINDOW)
+    {
+      return false;
+    }
+  return m_uplinks.test (seqNo);
+}
+
+void
+MSStatus::AddUplink (uint8_t seqNo)
+{
+  NS_LOG_FUNCTION (this << unsigned (seqNo));
+
+  uint8_t ahead = seqNo - m_lastSeqNo;
+  if (!m_hasUplinks)
+    {
+      m_uplinks.reset ();
+      m_lastSeqNo = seqNo;
+      m_hasUplinks = true;
+    }
+  else if (ahead != 0 && ahead < SEQ_WINDOW)
+    {
+      // Forget the skipped sequence numbers, received a lap ago if ever
+      for (uint8_t skipped = m_lastSeqNo + 1; skipped != seqNo; skipped++)
+        {
+          m_uplinks.reset (skipped);
+        }
+      m_lastSeqNo = seqNo;
+    }
+  m_uplinks.set (seqNo);
+}
+
+uint8_t
+MSStatus::GetTxPowerIndex (void) const
+{
+  return m_txPowerIndex;
+}
+
+void
+MSStatus::SetTxPowerIndex (uint8_t txPowerIndex)
+{
+  NS_LOG_FUNCTION (this << unsigned (txPowerIndex));
+
+  m_txPowerIndex = txPowerIndex;
+}
+
+Ptr<MSCunbMac>
+MSStatus::GetMac (void) const
+{
+  return m_mac;
+}
+
+void
+MSStatus::QueueCommand (Ptr<CunbMacCommand> command)
+{
+  NS_LOG_FUNCTION (this << command);
+
+  std::list<Ptr<CunbMacCommand> >::iterator it = m_pendingCommands.begin ();
+  while (it != m_pendingCommands.end ())
+    {
+      if ((*it)->GetCommandType () == command->GetCommandType ())
+        {
+          it = m_pendingCommands.erase (it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+  m_pendingCommands.push_back (command);
+}
+
+uint32_t
+MSStatus::GetNPendingCommands (void) const
+{
+  return m_pendingCommands.size ();
+}
+
+bool
+MSStatus::HasPendingCommand (enum MacCommandType commandType) const
+{
+  std::list<Ptr<CunbMacCommand> >::const_iterator it;
+  for (it = m_pendingCommands.begin (); it != m_pendingCommands.end (); ++it)
+    {
+      if ((*it)->GetCommandType () == commandType)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+MSStatus::AddPendingCommands (CunbFrameHeader &frameHeader,
+                              uint32_t payloadSize)
+{
+  NS_LOG_FUNCTION (this << payloadSize);
+
+  uint8_t budget = CunbFrameHeader::MAX_FOPTS_LENGTH;
+  if (m_mac != 0)
+    {
+      budget = m_mac->GetFOptsBudget (GetFirstReceiveWindowDataRate (),
+                                      payloadSize);
+    }
+
+  std::list<Ptr<CunbMacCommand> >::iterator it;
+  for (it = m_pendingCommands.begin (); it != m_pendingCommands.end (); ++it)
+    {
+      frameHeader.AddCommand (*it, budget);
+    }
+}
+
+bool
+MSStatus::AcknowledgeLinkAdr (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  std::list<Ptr<CunbMacCommand> >::iterator it;
+  for (it = m_pendingCommands.begin (); it != m_pendingCommands.end (); ++it)
+    {
+      Ptr<LinkAdrReq> linkAdrReq = DynamicCast<LinkAdrReq> (*it);
+      if (linkAdrReq != 0)
+        {
+          // Start over with samples taken at the new power
+          SetTxPowerIndex (linkAdrReq->GetTxPower ());
+          ClearMarginHistory ();
+          m_pendingCommands.erase (it);
+          return true;
+        }
+    }
+  return false;
+}
+
+Address
+MSStatus::GetBestEnbAddress (void)
 {
   NS_LOG_FUNCTION (this);
 
-  // Copy the map pairs into a vector
-  std::vector<std::pair<Address, double> > pairs;
-  for (auto it = m_enbs.begin (); it != m_enbs.end (); ++it)
+  if (m_nEnbs == 0)
     {
-      pairs.push_back (*it);
+      return Address ();
     }
+  return m_enbs[0].address;
+}
 
-  // Sort the vector
-  std::sort (pairs.begin (), pairs.end (),
-             [] (const std::pair<Address, double>&p1,
-                 const std::pair<Address, double>&p2)
-             { return p1.second > p2.second; }
-             );
+uint8_t
+MSStatus::GetNEnbs (void) const
+{
+  return m_nEnbs;
+}
+
+const Address &
+MSStatus::GetEnbAddress (uint8_t rank) const
+{
+  NS_ASSERT (rank < m_nEnbs);
+
+  return m_enbs[rank].address;
+}
+
+double
+MSStatus::GetEnbRcvPower (uint8_t rank) const
+{
+  NS_ASSERT (rank < m_nEnbs);
+
+  return m_enbs[rank].rcvPower;
+}
+
+std::list<Address>
+MSStatus::GetSortedEnbAddresses (void)
+{
+  NS_LOG_FUNCTION (this);
 
-  // Create a new array with only the addresses
   std::list<Address> addresses;
-  for (auto it = pairs.begin (); it != pairs.end (); ++it)
+  for (uint8_t i = 0; i < m_nEnbs; i++)
     {
-      addresses.push_back ((*it).first);
+      addresses.push_back (m_enbs[i].address);
     }
-
-  // Return the list
   return addresses;
 }
 
@@ -139,11 +392,31 @@ MSStatus::GetReplyPacket (uint8_t seqNo, uint16_t ident)
   m_reply.macTrailer.SetAuthDL(replyPacket, seqNo,ident);
   replyPacket->AddTrailer(m_reply.macTrailer);
 
+  // The commands of the reply are on their way, except a LinkAdrReq, which
+  // waits for its answer
+  std::list<Ptr<CunbMacCommand> >::const_iterator sent;
+  for (sent = m_reply.frameHeader.GetCommands ().begin ();
+       sent != m_reply.frameHeader.GetCommands ().end (); ++sent)
+    {
+      if ((*sent)->GetCommandType () != LINK_ADR_REQ)
+        {
+          m_pendingCommands.remove (*sent);
+        }
+    }
+
 
   NS_LOG_INFO("Reply Packet dest address" << m_reply.frameHeader.GetAddress() );
   return replyPacket;
 }
 
+Time
+MSStatus::GetReplyReceptionTime (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  return m_reply.receptionTime;
+}
+
 void
 MSStatus::SetFirstReceiveWindowFrequency (double frequency)
 {
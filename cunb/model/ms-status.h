@@ -9,6 +9,7 @@
 #include "ns3/cunb-frame-header.h"
 #include "ns3/cunb-linklayer-header.h"
 #include "ns3/ms-cunb-mac.h"
+#include <bitset>
 
 namespace ns3 {
 
@@ -22,10 +23,11 @@ namespace ns3 {
  * window. Furthermore, this class is used to keep track of all eNBs that
  * are able to receive the MS's packets. On new packet arrivals at the
  * CUNB Server, the UpdateEnbData method is called to update the
- * m_enbs map, that associates a Gateway's PointToPointNetDevice address
- * to the power it received this ED's last packet. This information is then
- * used in the GetSortedGatewayAddresses method to return a list of the
- * preferred gateways through which to reply to this device.
+ * m_enbs array, that holds the PointToPointNetDevice addresses of the
+ * MAX_RANKED_ENBS eNBs that receive this MS best, sorted by smoothed receive
+ * power. The array is kept sorted as packets arrive, so that GetNEnbs and
+ * GetEnbAddress can be used to go over the preferred eNBs through which to
+ * reply to this device without any allocation.
  */
 class MSStatus
 {
@@ -43,6 +45,7 @@ public:
     CunbMacTrailer macTrailer; // The MacTrailer to attach to the reply packet.
     CunbFrameHeader frameHeader; // The FrameHeader to attach to the reply packet.
     CunbLinkLayerHeader llHeader; // The LinkLayerHeader to attach to the reply packet.
+    Time receptionTime; // When the uplink this reply answers was received.
   };
 
   MSStatus();
@@ -50,6 +53,32 @@ public:
 
   MSStatus(Ptr<MSCunbMac> MSMac);
 
+  /**
+   * Get the MAC layer of the device.
+   */
+  Ptr<MSCunbMac> GetMac (void) const;
+
+  /**
+   * The number of eNBs whose receive power is tracked for each MS.
+   */
+  static const uint8_t MAX_RANKED_ENBS = 4;
+
+  /**
+   * Weight of a new sample in the smoothed receive power of an eNB.
+   */
+  static constexpr double RSSI_SMOOTHING = 0.25;
+
+  /**
+   * The number of uplinks whose link margin is remembered for ADR.
+   */
+  static const uint8_t MARGIN_HISTORY = 20;
+
+  /**
+   * The number of sequence numbers, up to the last one, whose uplinks are
+   * remembered to tell duplicates apart. The ones after them are new.
+   */
+  static const uint16_t SEQ_WINDOW = 128;
+
   /**
    * Get the data rate this device is using
    *
@@ -84,13 +113,30 @@ public:
   void UpdateEnbData (Address enbAddress, double rcvPower);
 
   /**
-   * Return the address of the enb that received this device's last packet
-   * with the highest power.
+   * Return the address of the enb that receives this device with the highest
+   * smoothed power.
    *
    * \return The best gateway's P2P link address.
    */
   Address GetBestEnbAddress (void);
 
+  /**
+   * Get the number of eNBs currently ranked for this device.
+   */
+  uint8_t GetNEnbs (void) const;
+
+  /**
+   * Get the address of the eNB at this rank, 0 being the best one.
+   *
+   * \param rank The rank, lower than GetNEnbs ().
+   */
+  const Address & GetEnbAddress (uint8_t rank) const;
+
+  /**
+   * Get the smoothed receive power, in dBm, of the eNB at this rank.
+   */
+  double GetEnbRcvPower (uint8_t rank) const;
+
   /**
    * Return an iterator to the enb addresses that received a packet by this
    * device, in order from best to worst (i.e., from highest receive power to
@@ -100,6 +146,98 @@ public:
    */
   std::list<Address> GetSortedEnbAddresses (void);
 
+  /**
+   * Record the link margin an uplink was received with, that is its
+   * receive power above the eNB sensitivity. The PHY has no noise model, so
+   * this margin plays the role of the SNR margin of other technologies.
+   *
+   * \param margin The margin, in dB.
+   * \param sameUplink Whether this is another copy of the last uplink,
+   * received through another eNB, in which case only the best margin is
+   * kept.
+   */
+  void AddMarginSample (double margin, bool sameUplink);
+
+  /**
+   * Get the number of uplinks in the margin history.
+   */
+  uint8_t GetNMarginSamples (void) const;
+
+  /**
+   * Get the best margin of the last uplinks of the history, in dB.
+   *
+   * \param nUplinks The number of uplinks to look at, the most recent
+   * ones. At most the whole history is used.
+   */
+  double GetMaxMargin (uint8_t nUplinks) const;
+
+  /**
+   * Forget the margin history, for example after the TX power changed.
+   */
+  void ClearMarginHistory (void);
+
+  /**
+   * Check whether an uplink with this sequence number was already received,
+   * through any eNB.
+   */
+  bool HasUplink (uint8_t seqNo) const;
+
+  /**
+   * Remember that an uplink with this sequence number was received. The
+   * sequence numbers more than SEQ_WINDOW behind it are forgotten, so that
+   * they are new again once the counter wraps around.
+   */
+  void AddUplink (uint8_t seqNo);
+
+  /**
+   * Get the TX power step the device was last told to use, 0 being its
+   * maximum power.
+   */
+  uint8_t GetTxPowerIndex (void) const;
+
+  void SetTxPowerIndex (uint8_t txPowerIndex);
+
+  /**
+   * Queue a MAC command for this device. Queued commands are piggy-backed
+   * on the next downlinks, in the order they were queued. A command replaces
+   * any queued command of the same type, which would be out of date.
+   */
+  void QueueCommand (Ptr<CunbMacCommand> command);
+
+  /**
+   * Get the number of MAC commands waiting to be sent to this device.
+   */
+  uint32_t GetNPendingCommands (void) const;
+
+  /**
+   * Check whether a MAC command of the given type is waiting to be sent to
+   * this device, or to be answered by it.
+   */
+  bool HasPendingCommand (enum MacCommandType commandType) const;
+
+  /**
+   * Add the queued MAC commands that fit to the options of a downlink frame
+   * header.
+   *
+   * The commands stay queued: they are only dropped when GetReplyPacket
+   * builds the downlink, so that a reply which is given up loses none of
+   * them. A LinkAdrReq even stays until the device answers it, see
+   * AcknowledgeLinkAdr.
+   *
+   * \param frameHeader The header of the downlink.
+   * \param payloadSize The size of the downlink's payload, in bytes.
+   */
+  void AddPendingCommands (CunbFrameHeader &frameHeader, uint32_t payloadSize);
+
+  /**
+   * Take into account the LinkAdrAns of the device: the TX power of the
+   * pending LinkAdrReq becomes the one the device uses, the margin history
+   * taken at the previous power is forgotten, and the request is dropped.
+   *
+   * \return False if no LinkAdrReq was pending.
+   */
+  bool AcknowledgeLinkAdr (void);
+
   /**
    * Set the reply to send to this device.
    *
@@ -124,6 +262,12 @@ public:
    */
   Ptr<Packet> GetReplyPacket (uint8_t seqNo, uint16_t ident);
 
+  /**
+   * Get the time at which the uplink answered by the current reply was
+   * received.
+   */
+  Time GetReplyReceptionTime (void);
+
   /**
    * Set the first window frequency of this device.
    */
@@ -180,9 +324,33 @@ private:
 
   CunbDeviceAddress m_address;   //!< The address of this device
 
-  std::map<Address, double> m_enbs;   //!< The enbs that received a
-                                          //!packet from the device represented
-                                          //!by this MSStatus
+  /**
+   * An eNB that received packets from this device, with the smoothed power
+   * it received them with.
+   */
+  struct RankedEnb
+  {
+    Address address;
+    double rcvPower;
+  };
+
+  RankedEnb m_enbs[MAX_RANKED_ENBS]; //!< The best enbs that received a
+                                     //!packet from the device represented
+                                     //!by this MSStatus, best first
+  uint8_t m_nEnbs;                   //!< Number of valid entries in m_enbs
+
+  double m_margins[MARGIN_HISTORY]; //!< Margins of the last uplinks, in dB
+  uint8_t m_nMargins;               //!< Number of valid entries in m_margins
+  uint8_t m_marginHead;             //!< Where the next margin is written
+
+  std::bitset<256> m_uplinks; //!< Sequence numbers received, in the window
+  uint8_t m_lastSeqNo;        //!< Most recent sequence number received
+  bool m_hasUplinks;          //!< Whether any uplink was received
+
+  uint8_t m_txPowerIndex; //!< TX power step the device is believed to use
+
+  std::list<Ptr<CunbMacCommand> > m_pendingCommands; //!< MAC commands waiting
+                                                     //!for a downlink
 
 
   struct Reply m_reply; //!< Structure containing the next reply meant for this
@@ -16,9 +16,6 @@ NS_LOG_COMPONENT_DEFINE ("OneTimeRequesting");
 
 NS_OBJECT_ENSURE_REGISTERED (OneTimeRequesting);
 
-int
-OneTimeRequesting::AAreCount = 0;
-
 TypeId
 OneTimeRequesting::GetTypeId (void)
 {
@@ -53,6 +50,12 @@ OneTimeRequesting::SetSendTime (Time sendTime)
   m_sendTime = sendTime;
 }
 
+void
+OneTimeRequesting::SetMetrics(Ptr<CunbServerMetrics> metrics)
+{
+	m_metrics = metrics;
+}
+
 void
 OneTimeRequesting::SetMS(Ptr<Node> ms)
 {
@@ -118,6 +121,10 @@ OneTimeRequesting::SendPacket (uint8_t pType)
       NewTypeAPDU typeHdr;
       typeHdr.SetApduType ((ApduType)hdr.GetIdApdu()); // Define the type of APDU
       packet->AddHeader (typeHdr); // Copy the header into the packet
+      if (m_metrics != 0)
+      {
+        m_metrics->NotifyGetRequest ();
+      }
   }
 
   else if(pType == 1) // for AA Request
@@ -136,7 +143,10 @@ OneTimeRequesting::SendPacket (uint8_t pType)
       NewTypeAPDU typeaaHdr;
 	  typeaaHdr.SetApduType ((ApduType)aahdr.GetIdApdu()); // Define the type of APDU
 	  packet->AddHeader (typeaaHdr); // Copy the header into the packet
-	  NS_LOG_INFO("AA req count "<< AAreCount++);
+	  if (m_metrics != 0)
+	  {
+	    m_metrics->NotifyAaRequest ();
+	  }
 
   }
 
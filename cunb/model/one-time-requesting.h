@@ -19,8 +19,6 @@ public:
 
   static TypeId GetTypeId (void);
 
-  static int AAreCount;
-
   /**
    * Send a packet using the CunbNetDevice's Send method.
    */
@@ -56,6 +54,11 @@ public:
 
   void ReceivePacket(Ptr<Packet const> packet,Ptr<Node> ms);
 
+  /**
+   * Set the metrics of the server this application sends requests for.
+   */
+  void SetMetrics(Ptr<CunbServerMetrics> metrics);
+
 private:
 
   /**
@@ -76,6 +79,8 @@ private:
 
   Ptr<Node> m_ms;
 
+  Ptr<CunbServerMetrics> m_metrics;
+
   //uint8_t m_ptype;
 };
 
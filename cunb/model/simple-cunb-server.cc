@@ -1,4 +1,5 @@
 #include "ns3/simple-cunb-server.h"
+#include "ns3/cunb-profiler.h"
 #include "ns3/simulator.h"
 #include "ns3/ms-cunb-mac.h"
 #include "ns3/cunb-mac-header.h"
@@ -10,6 +11,16 @@
 #include "ns3/new-cosem-header.h"
 #include "ns3/OTRe_Helper.h"
 #include "ns3/one-time-requesting.h"
+#include "ns3/pointer.h"
+#include "ns3/enum.h"
+#include "ns3/double.h"
+#include "ns3/enb-cunb-phy.h"
+#include "ns3/enb-cunb-mac.h"
+#include "ns3/cunb-beacon-header.h"
+#include "ns3/cunb-beacon-trailer.h"
+#include "ns3/cunb-beacon-payload.h"
+#include <algorithm>
+#include <set>
 
 namespace ns3 {
 
@@ -25,15 +36,61 @@ SimpleCunbServer::GetTypeId (void)
   static TypeId tid = TypeId ("ns3::SimpleCunbServer")
     .SetParent<Application> ()
     .AddConstructor<SimpleCunbServer> ()
+    .AddAttribute ("Metrics",
+                   "The counters and histograms of this server, a new "
+                   "CunbServerMetrics if null",
+                   PointerValue (),
+                   MakePointerAccessor (&SimpleCunbServer::SetMetrics,
+                                        &SimpleCunbServer::GetMetrics),
+                   MakePointerChecker<CunbServerMetrics> ())
+    .AddAttribute ("EnbSelectionPolicy",
+                   "How the eNB used for a downlink is picked",
+                   EnumValue (SimpleCunbServer::STRONGEST_FIRST),
+                   MakeEnumAccessor (&SimpleCunbServer::m_enbSelectionPolicy),
+                   MakeEnumChecker (SimpleCunbServer::STRONGEST_FIRST, "StrongestFirst",
+                                    SimpleCunbServer::LEAST_LOADED, "LeastLoaded",
+                                    SimpleCunbServer::WEIGHTED_ROUND_ROBIN, "WeightedRoundRobin"))
+    .AddAttribute ("GroupSlotDuration",
+                   "Duration of the response slot of each MS in a group "
+                   "downlink, a multiple of 10 ms",
+                   TimeValue (Seconds (2)),
+                   MakeTimeAccessor (&SimpleCunbServer::m_groupSlotDuration),
+                   MakeTimeChecker (MilliSeconds (10), MilliSeconds (655350)))
+    .AddAttribute ("PingSlotPeriod",
+                   "Ping slot period of the MSs: requests are held back "
+                   "until the next ping slot of their MS. Zero to send them "
+                   "right away",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SimpleCunbServer::m_pingSlotPeriod),
+                   MakeTimeChecker (Seconds (0)))
+    .AddAttribute ("PingSlotDuration",
+                   "How long the ping slots of the MSs last, that is the "
+                   "duration of their receive windows",
+                   TimeValue (Seconds (0.2)),
+                   MakeTimeAccessor (&SimpleCunbServer::m_pingSlotDuration),
+                   MakeTimeChecker (MilliSeconds (1)))
+    .AddAttribute ("LinkMarginThreshold",
+                   "Margin above the eNB sensitivity, in dB, an eNB needs "
+                   "to be considered by the LeastLoaded policy",
+                   DoubleValue (10),
+                   MakeDoubleAccessor (&SimpleCunbServer::m_linkMarginThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddTraceSource ("EnbDownlink",
+                     "A downlink packet was handed to an eNB",
+                     MakeTraceSourceAccessor (&SimpleCunbServer::m_enbDownlink),
+                     "ns3::SimpleCunbServer::EnbLoadCallback")
     .SetGroupName ("cunb");
   return tid;
 }
 
-int SimpleCunbServer::helloCount = 0;
-int SimpleCunbServer::AAreqCount = 0;
-int SimpleCunbServer::GETreqCount = 0;
-
-SimpleCunbServer::SimpleCunbServer()
+SimpleCunbServer::SimpleCunbServer() :
+  m_metrics (CreateObject<CunbServerMetrics> ()),
+  m_enbSelectionPolicy (STRONGEST_FIRST),
+  m_linkMarginThreshold (10),
+  m_groupSlotDuration (Seconds (2)),
+  m_groupSeqNo (0),
+  m_pingSlotPeriod (Seconds (0)),
+  m_pingSlotDuration (Seconds (0.2))
 {
   NS_LOG_FUNCTION_NOARGS ();
 }
@@ -47,12 +104,125 @@ void
 SimpleCunbServer::StartApplication (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
+
+  m_metrics->StartSnapshots ();
 }
 
 void
 SimpleCunbServer::StopApplication (void)
 {
   NS_LOG_FUNCTION_NOARGS ();
+
+  m_metrics->StopSnapshots ();
+
+  if (m_readingSink != 0)
+    {
+      m_readingSink->Flush ();
+    }
+}
+
+void
+SimpleCunbServer::SetReadCampaign (Ptr<CunbReadCampaign> campaign)
+{
+  NS_LOG_FUNCTION (this << campaign);
+
+  m_readCampaign = campaign;
+  if (campaign != 0)
+    {
+      campaign->SetSendRequestCallback
+        (MakeCallback (&SimpleCunbServer::SendObisRequest, this));
+    }
+}
+
+Ptr<CunbReadCampaign>
+SimpleCunbServer::GetReadCampaign (void) const
+{
+  return m_readCampaign;
+}
+
+void
+SimpleCunbServer::SetReadingSink (Ptr<CunbReadingSink> sink)
+{
+  NS_LOG_FUNCTION (this << sink);
+
+  m_readingSink = sink;
+}
+
+Ptr<CunbReadingSink>
+SimpleCunbServer::GetReadingSink (void) const
+{
+  return m_readingSink;
+}
+
+void
+SimpleCunbServer::SetAdrEngine (Ptr<CunbAdrEngine> adrEngine)
+{
+  NS_LOG_FUNCTION (this << adrEngine);
+
+  m_adrEngine = adrEngine;
+}
+
+Ptr<CunbAdrEngine>
+SimpleCunbServer::GetAdrEngine (void) const
+{
+  return m_adrEngine;
+}
+
+void
+SimpleCunbServer::SetMetrics (Ptr<CunbServerMetrics> metrics)
+{
+  NS_LOG_FUNCTION (this << metrics);
+
+  // A null value, such as the default one of the Metrics attribute, gives
+  // the server metrics of its own, so that there always are some
+  m_metrics = (metrics != 0) ? metrics : CreateObject<CunbServerMetrics> ();
+}
+
+Ptr<CunbServerMetrics>
+SimpleCunbServer::GetMetrics (void) const
+{
+  return m_metrics;
+}
+
+void
+SimpleCunbServer::ParseCommands (const CunbFrameHeaderUl &frameHeader)
+{
+  NS_LOG_FUNCTION (this);
+
+  MSStatus &msStatus = m_msStatuses.at (frameHeader.GetAddress ());
+
+  std::list<Ptr<CunbMacCommand> >::const_iterator it;
+  for (it = frameHeader.GetCommands ().begin ();
+       it != frameHeader.GetCommands ().end (); ++it)
+    {
+      switch ((*it)->GetCommandType ())
+        {
+        case LINK_CHECK_REQ:
+          {
+            double margin = 0;
+            if (msStatus.GetNEnbs () > 0)
+              {
+                margin = msStatus.GetEnbRcvPower (0) - EnbCunbPhy::sensitivity;
+                margin = std::max (0.0, std::min (255.0, margin));
+              }
+            msStatus.QueueCommand (Create<LinkCheckAns> ((uint8_t)margin,
+                                                         msStatus.GetNEnbs ()));
+            break;
+          }
+        case LINK_ADR_ANS:
+          // Only now does the MS use the new TX power
+          if (msStatus.AcknowledgeLinkAdr ())
+            {
+              NS_LOG_DEBUG (frameHeader.GetAddress ().Print () <<
+                            " acknowledged the TX power change");
+            }
+          break;
+        default:
+          NS_LOG_DEBUG ("Ignoring MAC command of type " <<
+                        (*it)->GetCommandType ());
+          break;
+        }
+    }
 }
 
 void
@@ -102,12 +272,25 @@ SimpleCunbServer::AddEnb (Ptr<Node> enb, Ptr<NetDevice> netDevice)
       // Add it to the map
       m_enbStatuses.insert (std::pair<Address, EnbStatus>
                                   (enbAddress, enbStatus));
-      m_enbNode_address_pairs.push_back(std::make_pair(enb,enbAddress));
+      m_enbNodes[enbAddress] = enb;
 
       NS_LOG_DEBUG ("Added an enb to the list");
     }
 }
 
+void
+SimpleCunbServer::AddPopulation (Ptr<CunbMeterPopulation> population)
+{
+  NS_LOG_FUNCTION (this << population->GetNMeters ());
+
+  // Without a MAC to look into, the statuses only hold what the uplinks say
+  for (uint32_t i = 0; i < population->GetNMeters (); i++)
+    {
+      m_msStatuses.insert (std::pair<CunbDeviceAddress, MSStatus>
+                             (population->GetAddress (i), MSStatus ()));
+    }
+}
+
 void
 SimpleCunbServer::AddNodes (NodeContainer nodes)
 {
@@ -162,6 +345,8 @@ bool
 SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
                               uint16_t protocol, const Address& address)
 {
+  CUNB_PROFILE_SCOPE ("SimpleCunbServer::Receive");
+
   //NS_LOG_FUNCTION (this << packet << protocol << address);
   NS_LOG_FUNCTION(" Packet Size "<< packet->GetSize());
 
@@ -200,14 +385,17 @@ SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
 
   //NS_LOG_INFO("ident " << ident << "seqNo" << seqNo);
 
-  // store the identifier and sequence Number
-  std::pair<uint16_t,uint8_t> seq_id_pair = std::make_pair(ident,seqNo);
   //std::pair<std::pair<uint16_t,uint8_t>,uint8_t> seq_id_rep_pair = std::make_pair(std::make_pair(ident,seqNo),repCnt);
 
   // Extract the frame header
   CunbFrameHeaderUl frameHdr;
   myPacket->RemoveHeader (frameHdr);
 
+  // Uplinks are told apart by the address and sequence number of the MS:
+  // the 16-bit idents of large populations wrap around, the addresses don't
+  MSStatus &msStatus = m_msStatuses.at (frameHdr.GetAddress ());
+  bool duplicate = msStatus.HasUplink (seqNo);
+
   // Extract the Link Layer header
   CunbLinkLayerHeader llHdr;
   myPacket->RemoveHeader(llHdr);
@@ -222,31 +410,66 @@ SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
   CunbTag tag;
   myPacket->RemovePacketTag (tag);
 
+  // Reports the MS batched into this frame follow the first one, each
+  // behind its own wrapper header
+  Ptr<Packet> batch;
+  if (wrapperHdr.GetLength () < myPacket->GetSize ())
+    {
+      batch = myPacket->CreateFragment (wrapperHdr.GetLength (),
+                                        myPacket->GetSize () - wrapperHdr.GetLength ());
+      myPacket->RemoveAtEnd (batch->GetSize ());
+    }
+
   // Register which eNB this packet came from
   double rcvPower = tag.GetReceivePower ();
   //NS_LOG_INFO("Received Power " << rcvPower);
-  m_msStatuses.at (frameHdr.GetAddress ()).UpdateEnbData (address,rcvPower);
+  msStatus.UpdateEnbData (address,rcvPower);
+  msStatus.AddMarginSample (rcvPower - EnbCunbPhy::sensitivity, duplicate);
+
+  // Handle the MAC commands piggy-backed on the uplink, once per uplink
+  if (!duplicate)
+    {
+      ParseCommands (frameHdr);
+    }
+
+  // Requests to the targets of a running campaign are paced by the campaign
+  bool campaignTarget = m_readCampaign != 0 &&
+    m_readCampaign->IsTarget (frameHdr.GetAddress ());
+  if (campaignTarget)
+    {
+      m_readCampaign->NotifyUplink (frameHdr.GetAddress (), address,
+                                    tag.GetFrequency ());
+    }
 
   // Extract the App Layer header
   AppLayerHeader appHdr;
   myPacket->RemoveHeader(appHdr);
 
+  // The same uplink may reach the server through several eNBs
+  if (duplicate)
+    {
+      m_metrics->NotifyDuplicate ();
+    }
+
   if(macHdr.GetMType() == CunbMacHeaderUl::HELLO) // If the packet is a Hello Packet
   {
-     if(!PairExist(seq_id_pair))
+     if(!duplicate)
 	 //if(!PairSeqIdentRepExist(seq_id_rep_pair))
 	 {
-		 helloCount++;
-		 NS_LOG_INFO("hello count " << helloCount << " Address "<<frameHdr.GetAddress());
+		 m_metrics->NotifyHello ();
+		 NS_LOG_INFO("hello count " << m_metrics->GetHelloCount () << " Address "<<frameHdr.GetAddress());
 
-		 m_id_seq_pair.push_back(seq_id_pair);
+		 msStatus.AddUplink (seqNo);
 
          /*
 		 Simulator::Schedule (Seconds (1), &SimpleCunbServer::TriggerOneTimeRequesting,
 		 	                             this, GetNodeFromIdent(ident),frameHdr.GetAddress(),tag.GetFrequency());
 		 */
-		 Simulator::Schedule (Seconds (1), &SimpleCunbServer::SendRequest,
+		 if (!campaignTarget)
+		 {
+		   Simulator::Schedule (Seconds (1), &SimpleCunbServer::SendRequest,
 		 		 	                             this, frameHdr.GetAddress(),tag.GetFrequency(),1);
+		 }
 	 }
 
      return true;
@@ -259,12 +482,19 @@ SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
   // If the APDU type is a AA Response call the function Receive Response to trigger GET Request
   if (typeHdr2.GetApduType() == AARE)
   {
-	if(!PairExist(seq_id_pair))
+	if(!duplicate)
 	{
-		m_id_seq_pair.push_back(seq_id_pair);
+		msStatus.AddUplink (seqNo);
 		//m_id_seq_rep_pair.push_back(seq_id_rep_pair);
-		Simulator::Schedule (Seconds (1), &SimpleCunbServer::SendRequest,
+		if (campaignTarget)
+		{
+		  m_readCampaign->NotifyAare (frameHdr.GetAddress ());
+		}
+		else
+		{
+		  Simulator::Schedule (Seconds (1), &SimpleCunbServer::SendRequest,
 				 		 	                             this, frameHdr.GetAddress(),tag.GetFrequency(),0);
+		}
 	}
   }
 
@@ -275,19 +505,58 @@ SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
   m_sizeReqData = hdr.GetSerializedSize () - 4 ; // without CosemApp header (4B)
  // NS_LOG_INFO("Data received " << m_reqData);
 
+  if (typeHdr2.GetApduType () == GETRES_N && !duplicate)
+    {
+      ReceiveGetResponse (frameHdr.GetAddress (), ident, seqNo, 0, address,
+                          tag, m_reqData);
+
+      // Split the batched reports, which all are GET Responses. They share
+      // the sequence number of the frame, their index tells them apart
+      uint8_t index = 0;
+      while (batch != 0 && batch->GetSize () >= wrapperHdr.GetSerializedSize ())
+        {
+          index++;
+          batch->RemoveHeader (wrapperHdr);
+          uint32_t length = std::min<uint32_t> (wrapperHdr.GetLength (),
+                                                batch->GetSize ());
+          Ptr<Packet> report = batch->CreateFragment (0, length);
+          batch->RemoveAtStart (length);
+
+          AppLayerHeader reportAppHdr;
+          report->RemoveHeader (reportAppHdr);
+          NewTypeAPDU reportTypeHdr;
+          report->RemoveHeader (reportTypeHdr);
+          if (reportTypeHdr.GetApduType () != GETRES_N)
+            {
+              NS_LOG_WARN ("Dropping a batched APDU of type " <<
+                           reportTypeHdr.GetApduType ());
+              continue;
+            }
+
+          NewCosemGetResponseNormalHeader reportHdr;
+          report->RemoveHeader (reportHdr);
+          ReceiveGetResponse (frameHdr.GetAddress (), ident, seqNo, index,
+                              address, tag, reportHdr.GetData ());
+        }
+    }
+
   // Determine whether the packet requires a reply
   if ((macHdr.GetMType () == CunbMacHeaderUl::SINGLE_ACK ||
 	  macHdr.GetMType () == CunbMacHeaderUl::MULTIPLE_ACK)  &&
-      !PairExist(seq_id_pair))
+      !msStatus.HasUplink (seqNo))
     {
       //NS_LOG_DEBUG ("Scheduling a reply for this device");
-	  m_id_seq_pair.push_back(seq_id_pair);
+	  msStatus.AddUplink (seqNo);
 
-      // Remove Old Pair because the Sequence Number count repeats cyclically
-      RemoveOldPair(seq_id_pair);
+      // Devices without a MAC, those of a CunbMeterPopulation, don't listen
+      if (msStatus.GetMac () == 0)
+        {
+          return true;
+        }
 
       MSStatus::Reply reply;
       reply.hasReply = true;
+      reply.receptionTime = Simulator::Now ();
 
       // this is the ACK packet sent to the MS. It can be a Multiple or Single Ack
       Ptr<Packet> replyPacket = Create<Packet> ();
@@ -314,13 +583,40 @@ SimpleCunbServer::Receive (Ptr<NetDevice> device, Ptr<const Packet> packet,
       //NS_LOG_INFO("Set Ack Bit "<< seqNo);
       replyMacHdr.SetAckBits(seqNo);
 
+      // Let the MS know how well it is heard, so that it can adapt the
+      // number of repetitions of its next uplinks
+      if (msStatus.GetNEnbs () > 0)
+        {
+          double margin = msStatus.GetEnbRcvPower (0) - EnbCunbPhy::sensitivity;
+          margin = std::max (0.0, std::min (255.0, margin));
+          replyMacHdr.SetLinkMargin ((uint8_t)margin);
+          replyMacHdr.SetEnbCount (msStatus.GetNEnbs ());
+        }
+
       reply.macHeader = replyMacHdr;
 
+      // Queue a TX power change, if the ADR engine wants one and the MS
+      // has answered the previous one. The new power is only taken into
+      // account once the MS acknowledges it
+      uint8_t txPowerIndex;
+      if (m_adrEngine != 0 &&
+          !msStatus.HasPendingCommand (LINK_ADR_REQ) &&
+          m_adrEngine->Decide (frameHdr.GetAddress (),
+                               msStatus, txPowerIndex))
+        {
+          msStatus.QueueCommand
+            (Create<LinkAdrReq> (LinkAdrReq::KEEP_DATA_RATE, txPowerIndex,
+                                 0xFFFF, 0, 0));
+        }
+
+      // Piggy-back the queued MAC commands that fit in the ACK
+      msStatus.AddPendingCommands (reply.frameHeader, reply.packet->GetSize ());
+
       CunbMacTrailer replyMacTlr = CunbMacTrailer();
       reply.macTrailer = replyMacTlr;
 
-      m_msStatuses.at (frameHdr.GetAddress ()).SetFirstReceiveWindowFrequency (tag.GetFrequency ());
-      m_msStatuses.at (frameHdr.GetAddress ()).SetReply (reply);
+      msStatus.SetFirstReceiveWindowFrequency (tag.GetFrequency ());
+      msStatus.SetReply (reply);
 
 
       uint16_t pType = appHdr.GetPtype();
@@ -373,7 +669,10 @@ SimpleCunbServer::SendOnFirstWindow (CunbDeviceAddress address,uint16_t ptype, u
       // Inform the eNB of the transmission
       m_enbStatuses.find (enbForReply)->second.GetNetDevice ()->
       Send (replyPacket, enbForReply, 0x0800);
+      NotifyDownlink (enbForReply, replyPacket);
       NS_LOG_INFO("ACK size "<<replyPacket->GetSize());
+      m_metrics->NotifyReply (1, Simulator::Now () -
+                              m_msStatuses.at (address).GetReplyReceptionTime ());
     }
   else
     {
@@ -385,6 +684,10 @@ SimpleCunbServer::SendOnFirstWindow (CunbDeviceAddress address,uint16_t ptype, u
             Simulator::Schedule (Seconds (1), &SimpleCunbServer::SendOnSecondWindow, this,
                            address, ptype,seqNo,ident);
       }
+      else
+      {
+        m_metrics->NotifyReplyGivenUp ();
+      }
     }
 }
 
@@ -421,6 +724,9 @@ SimpleCunbServer::SendOnSecondWindow (CunbDeviceAddress address, uint16_t ptype,
       // Inform the eNB of the transmission
       m_enbStatuses.find (enbForReply)->second.GetNetDevice ()->
       Send (replyPacket, enbForReply, 0x0800);
+      NotifyDownlink (enbForReply, replyPacket);
+      m_metrics->NotifyReply (2, Simulator::Now () -
+                              m_msStatuses.at (address).GetReplyReceptionTime ());
     }
   else
     {
@@ -432,6 +738,10 @@ SimpleCunbServer::SendOnSecondWindow (CunbDeviceAddress address, uint16_t ptype,
             Simulator::Schedule (Seconds (2), &SimpleCunbServer::SendOnThirdWindow, this,
                                  address,seqNo,ident);
       }
+      else
+      {
+        m_metrics->NotifyReplyGivenUp ();
+      }
     }
 }
 
@@ -468,11 +778,15 @@ SimpleCunbServer::SendOnThirdWindow (CunbDeviceAddress address,uint8_t seqNo,uin
       // Inform the eNB of the transmission
       m_enbStatuses.find (enbForReply)->second.GetNetDevice ()->
       Send (replyPacket, enbForReply, 0x0800);
+      NotifyDownlink (enbForReply, replyPacket);
+      m_metrics->NotifyReply (3, Simulator::Now () -
+                              m_msStatuses.at (address).GetReplyReceptionTime ());
     }
   else
     {
       // Schedule a reply on the second receive window
       NS_LOG_INFO ("Giving up on this reply, no eNB available for third window");
+      m_metrics->NotifyReplyGivenUp ();
     }
 }
 
@@ -484,35 +798,130 @@ SimpleCunbServer::GetEnbForReply (CunbDeviceAddress deviceAddress,
 
   // Check which eNBs can send this reply
   // Go in the order suggested by the msStatus
-  std::list<Address> addresses = m_msStatuses.at
-      (deviceAddress).GetSortedEnbAddresses ();
+  const MSStatus &msStatus = m_msStatuses.at (deviceAddress);
+  uint8_t nEnbs = msStatus.GetNEnbs ();
 
-  for (auto it = addresses.begin (); it != addresses.end (); ++it)
+  // Rank of the chosen eNB, nEnbs if none is available
+  uint8_t chosen = nEnbs;
+
+  switch (m_enbSelectionPolicy)
     {
-	  //NS_LOG_INFO("Addresses : "<<(*it));
-      if (m_enbStatuses.at (*it).IsAvailableForTransmission (frequency))
+    case LEAST_LOADED:
+      {
+        uint32_t bestQueueDepth = 0;
+        Time bestAirtime;
+        for (uint8_t rank = 0; rank < nEnbs; rank++)
+          {
+            double margin = msStatus.GetEnbRcvPower (rank) - EnbCunbPhy::sensitivity;
+            if (margin < m_linkMarginThreshold)
+              {
+                // eNBs are sorted by receive power, the others are weaker
+                break;
+              }
+            EnbStatus &enbStatus = m_enbStatuses.at (msStatus.GetEnbAddress (rank));
+            if (!enbStatus.IsAvailableForTransmission (frequency))
+              {
+                continue;
+              }
+            uint32_t queueDepth = enbStatus.GetQueueDepth ();
+            Time airtime = enbStatus.GetTotalAirtime ();
+            if (chosen == nEnbs || queueDepth < bestQueueDepth ||
+                (queueDepth == bestQueueDepth && airtime < bestAirtime))
+              {
+                chosen = rank;
+                bestQueueDepth = queueDepth;
+                bestAirtime = airtime;
+              }
+          }
+        if (chosen < nEnbs)
+          {
+            break;
+          }
+        // No eNB has enough margin: fall back to the strongest one
+      }
+      // Fall through
+    case STRONGEST_FIRST:
+      for (uint8_t rank = 0; rank < nEnbs; rank++)
         {
-          m_enbStatuses.at (*it).SetNextTransmissionTime (Simulator::Now ());
-          return *it;
+          //NS_LOG_INFO("Addresses : "<<msStatus.GetEnbAddress (rank));
+          if (m_enbStatuses.at (msStatus.GetEnbAddress (rank)).
+              IsAvailableForTransmission (frequency))
+            {
+              chosen = rank;
+              break;
+            }
         }
+      break;
+    case WEIGHTED_ROUND_ROBIN:
+      {
+        // Smooth weighted round robin among the available eNBs: each one
+        // earns its weight, the richest one is picked and pays the total
+        int64_t totalWeight = 0;
+        for (uint8_t rank = 0; rank < nEnbs; rank++)
+          {
+            EnbStatus &enbStatus = m_enbStatuses.at (msStatus.GetEnbAddress (rank));
+            if (!enbStatus.IsAvailableForTransmission (frequency))
+              {
+                continue;
+              }
+            enbStatus.SetCurrentWeight (enbStatus.GetCurrentWeight () + enbStatus.GetWeight ());
+            totalWeight += enbStatus.GetWeight ();
+            if (chosen == nEnbs || enbStatus.GetCurrentWeight () >
+                m_enbStatuses.at (msStatus.GetEnbAddress (chosen)).GetCurrentWeight ())
+              {
+                chosen = rank;
+              }
+          }
+        if (chosen < nEnbs)
+          {
+            EnbStatus &enbStatus = m_enbStatuses.at (msStatus.GetEnbAddress (chosen));
+            enbStatus.SetCurrentWeight (enbStatus.GetCurrentWeight () - totalWeight);
+          }
+      }
+      break;
     }
 
-  return Address ();
+  if (chosen == nEnbs)
+    {
+      m_metrics->NotifyNoEnbAvailable ();
+      return Address ();
+    }
+
+  const Address &address = msStatus.GetEnbAddress (chosen);
+  m_enbStatuses.at (address).SetNextTransmissionTime (Simulator::Now ());
+  Ptr<Node> enb = GetEnbNodeFromAddress (address);
+  m_metrics->NotifyEnbChoice (chosen, enb != 0 ? enb->GetId () : 0xFFFFFFFF);
+  return address;
 }
 
-bool
-SimpleCunbServer::PairExist(std::pair<uint16_t,uint8_t> id_seq_pair)
+void
+SimpleCunbServer::SetEnbWeight (Ptr<Node> enb, uint32_t weight)
 {
-	for (std::list<std::pair<uint16_t,uint8_t>>::iterator it = m_id_seq_pair.end (); it != m_id_seq_pair.begin (); --it)
-	    {
-		  //std::cout<< " ident "<< (int)(*it).first << " seq no in List "<< (int)(*it).second << std::endl;
-		     if((*it).first == id_seq_pair.first && (*it).second == id_seq_pair.second)
-		     {
-		    	 return true;
-		     }
-	    }
-	return false;
+  NS_LOG_FUNCTION (this << enb << weight);
+
+  for (auto it = m_enbNodes.begin (); it != m_enbNodes.end (); ++it)
+    {
+      if (it->second == enb)
+        {
+          m_enbStatuses.at (it->first).SetWeight (weight);
+          return;
+        }
+    }
+  NS_LOG_WARN ("This eNB is not connected to the server");
+}
+
+void
+SimpleCunbServer::NotifyDownlink (Address enbAddress, Ptr<const Packet> packet)
+{
+  EnbStatus &enbStatus = m_enbStatuses.at (enbAddress);
 
+  // Downlink parameters are the same ones the eNB MAC uses
+  CunbTxParameters params;
+  enbStatus.AddDownlink (CunbPhy::GetOnAirTime (packet->Copy (), params, ENB));
+
+  Ptr<Node> enb = GetEnbNodeFromAddress (enbAddress);
+  m_enbDownlink (enb != 0 ? enb->GetId () : 0xFFFFFFFF,
+                 enbStatus.GetQueueDepth (), enbStatus.GetTotalAirtime ());
 }
 
 bool
@@ -529,35 +938,6 @@ SimpleCunbServer::PairSeqIdentRepExist(std::pair<std::pair<uint16_t,uint8_t>,uin
 
 }
 
-void
-SimpleCunbServer::RemoveOldPair(std::pair<uint16_t,uint8_t> seq_id_pair)
-{
-	// Remove old ID Seq count pair
-	//NS_LOG_INFO("Seq no " <<(int)seq_id_pair.second << " ident of current "<<(int)seq_id_pair.first );
-	      for (std::list<std::pair<uint16_t,uint8_t>>::iterator it = m_id_seq_pair.end (); it != m_id_seq_pair.begin (); --it)
-	      	    {
-	    	         //std::cout << " seq no of iterator "<< (int)(*it).second << " ident no "<< (int)(*it).first<< std::endl;
-	      		     if((*it).first == seq_id_pair.first)
-	      		     {
-	      		    	if(seq_id_pair.second == 0 && (*it).second == 255)
-	      		    	//if(seq_id_pair.second == 0 && (*it).second == 15) // Remove the highest number sequence number still there in the list
-	      		        {
-	      		    		    std::pair<uint16_t,uint8_t> remove_pair = std::make_pair(seq_id_pair.first,(*it).second);
-	      		    		    m_id_seq_pair.remove(remove_pair);
-	      		    	}
-	      		    	if(seq_id_pair.second == 255 && (*it).second < seq_id_pair.second)
-	      		    	 //if(seq_id_pair.second == 15 && (*it).second < seq_id_pair.second) // Remove all the entries except the current
-	      		    	 {
-	      		    		 std::pair<uint16_t,uint8_t> remove_pair = std::make_pair(seq_id_pair.first,(*it).second);
-	      		    		 m_id_seq_pair.remove(remove_pair);
-	      		    		 //std::cout << " removing "<< (int) (*it).second <<std::endl;
-	      		    	 }
-
-	      		     }
-	      	    }
-
-}
-
 void
 SimpleCunbServer::RemoveOldPairModified(std::pair<std::pair<uint16_t,uint8_t>,uint8_t> seq_id_rep_pair)
 {
@@ -593,14 +973,12 @@ SimpleCunbServer::GetNodeFromIdent(uint16_t ident)
 Ptr<Node>
 SimpleCunbServer::GetEnbNodeFromAddress(Address address)
 {
-	for (auto it = m_enbNode_address_pairs.begin (); it != m_enbNode_address_pairs.end (); ++it)
-		    {
-			     if((*it).second == address)
-			     {
-			    	 return (*it).first;
-			     }
-		    }
+	std::map<Address,Ptr<Node> >::const_iterator it = m_enbNodes.find (address);
+	if (it == m_enbNodes.end ())
+	{
 		return Ptr<Node>();
+	}
+	return it->second;
 }
 
 void
@@ -622,14 +1000,22 @@ SimpleCunbServer::TriggerOneTimeRequesting(Ptr<Node> ms, CunbDeviceAddress addre
     otrApp->SetMS(ms);
     otrApp->SetMac(enbMac);
     otrApp->SetNode (enb);
+    otrApp->SetMetrics (m_metrics);
 
     // The problem with the current method is the Application gets destroyed before using
     enb->AddApplication (otrApp);
 }
 
-//This function is used to send the AA and GET request
 void
 SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint8_t requestType)
+{
+	SendObisRequest (msAddress, frequency, requestType, 0x010100070000);
+}
+
+// Build the DLMS-COSEM AA Request (requestType 1) or GET Request
+// (requestType 0), down to the wrapper header
+Ptr<Packet>
+SimpleCunbServer::CreateRequestPacket (uint8_t requestType, uint64_t obisCode)
 {
 	// Create a DLMS-COSEM AA Request Packet
 	Ptr<Packet> packet = Create<Packet> ();
@@ -650,8 +1036,6 @@ SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint
     NewTypeAPDU typeaaHdr;
 	typeaaHdr.SetApduType ((ApduType)aahdr.GetIdApdu()); // Define the type of APDU
 	packet->AddHeader (typeaaHdr); // Copy the header into the packet
-	AAreqCount++;
-    NS_LOG_INFO("AA req count "<<AAreqCount << " Address "<< msAddress);
 
    }
    else if(requestType == 0) // for GET Request
@@ -660,7 +1044,7 @@ SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint
  	 NewCosemGetRequestNormalHeader hdr;
      hdr.SetInvokeIdAndPriority (0x02);  // 0000 0010 (invoke_id {0b0000}),service_class= 1 (confirmed) priority level ({normal}))
      hdr.SetClassId (0X03);  // Class Register
-     hdr.SetInstanceId (0x010100070000);  // OBIS CODE: 1.1.0.7.0.0
+     hdr.SetInstanceId (obisCode);  // OBIS CODE, e.g. 1.1.0.7.0.0
      hdr.SetAttributeId (0x02);  // Second Attribut = Value
      packet->AddHeader (hdr); // Copy the header into the packet
 
@@ -668,10 +1052,6 @@ SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint
      NewTypeAPDU typeHdr;
      typeHdr.SetApduType ((ApduType)hdr.GetIdApdu()); // Define the type of APDU
      packet->AddHeader (typeHdr); // Copy the header into the packet
-     GETreqCount++;
-     NS_LOG_INFO("GET req count "<< GETreqCount<< " Address "<< msAddress);
-
-
    }
 
 	AppLayerHeader appHdr;
@@ -689,6 +1069,26 @@ SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint
 	wrapperHdr.SetLength (packet->GetSize ());
 	packet->AddHeader (wrapperHdr);
 
+	return packet;
+}
+
+//This function is used to send the AA and GET request
+Address
+SimpleCunbServer::SendObisRequest(CunbDeviceAddress msAddress,double frequency, uint8_t requestType, uint64_t obisCode)
+{
+	Ptr<Packet> packet = CreateRequestPacket (requestType, obisCode);
+
+	if(requestType == 1)
+	{
+		m_metrics->NotifyAaRequest ();
+		NS_LOG_INFO("AA req count "<<m_metrics->GetAaRequestCount () << " Address "<< msAddress);
+	}
+	else if(requestType == 0)
+	{
+		m_metrics->NotifyGetRequest ();
+		NS_LOG_INFO("GET req count "<< m_metrics->GetGetRequestCount ()<< " Address "<< msAddress);
+	}
+
 	CunbLinkLayerHeader llHdr;
 	packet->AddHeader(llHdr);
 
@@ -714,13 +1114,186 @@ SimpleCunbServer::SendRequest(CunbDeviceAddress msAddress,double frequency, uint
 	Address enbForReply = GetEnbForReply (msAddress, frequency);
 	NS_LOG_INFO("Address to reply "<< enbForReply << " and freq to use " << frequency);
 
-	if(enbForReply==Address()) return;
+	if(enbForReply==Address()) return enbForReply;
 
-	Ptr<Node> enb = GetEnbNodeFromAddress(enbForReply);
-	enb->GetDevice(0)->GetObject<CunbNetDevice>()->Send(packet, enbForReply, 0x0800);
+	// Aim at the next ping slot of the MS, if it opens any
+	Time delay = GetTimeToPingSlot (msAddress);
+	if (delay.IsStrictlyPositive ())
+	{
+		NS_LOG_DEBUG ("Holding the request for " << delay.GetSeconds () << " s");
+		Simulator::Schedule (delay, &SimpleCunbServer::SendToEnb, this,
+		                     enbForReply, packet);
+		return enbForReply;
+	}
 
+	SendToEnb (enbForReply, packet);
 
+	return enbForReply;
 }
 
+void
+SimpleCunbServer::ReceiveGetResponse (CunbDeviceAddress msAddress,
+                                      uint16_t ident, uint8_t seqNo,
+                                      uint8_t index,
+                                      const Address &enbAddress,
+                                      const CunbTag &tag, uint32_t value)
+{
+  NS_LOG_FUNCTION (this << msAddress << ident << unsigned (seqNo) <<
+                   unsigned (index) << value);
+
+  if (m_readingSink != 0)
+    {
+      CunbReadingSink::Reading reading;
+      reading.timeNs = Simulator::Now ().GetNanoSeconds ();
+      reading.address = msAddress.Get ();
+      reading.ident = ident;
+      reading.seq = seqNo;
+      reading.index = index;
+      Ptr<Node> enb = GetEnbNodeFromAddress (enbAddress);
+      reading.enb = (enb != 0) ? enb->GetId () : 0xFFFFFFFF;
+      reading.rssi = tag.GetReceivePower ();
+      reading.frequency = tag.GetFrequency ();
+      reading.value = value;
+      m_readingSink->Record (reading);
+    }
+
+  if (m_readCampaign != 0 && m_readCampaign->IsTarget (msAddress))
+    {
+      m_readCampaign->NotifyGetResponse (msAddress, value);
+    }
+}
+
+void
+SimpleCunbServer::SendToEnb (Address enbAddress, Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << enbAddress << packet);
+
+  Ptr<Node> enb = GetEnbNodeFromAddress (enbAddress);
+  enb->GetDevice (0)->GetObject<CunbNetDevice> ()->Send (packet, enbAddress, 0x0800);
+  NotifyDownlink (enbAddress, packet);
+}
+
+Time
+SimpleCunbServer::GetTimeToPingSlot (CunbDeviceAddress address) const
+{
+  if (m_pingSlotPeriod.IsZero ())
+    {
+      return Seconds (0);
+    }
+
+  // The simulation time is the network time the beacons carry, so that the
+  // ping slots follow from the address of the MS, as they do on its side
+  int64_t period = m_pingSlotPeriod.GetTimeStep ();
+  Time offset = MSCunbMac::ComputePingSlotOffset (address, m_pingSlotPeriod,
+                                                  m_pingSlotDuration);
+  int64_t wait = (offset - Simulator::Now ()).GetTimeStep () % period;
+  if (wait < 0)
+    {
+      wait += period;
+    }
+  return TimeStep (wait);
+}
+
+
+uint16_t
+SimpleCunbServer::AddGroup (const std::vector<CunbDeviceAddress> &members)
+{
+  NS_LOG_FUNCTION (this << members.size ());
+
+  uint16_t groupId = m_groups.size ();
+  m_groups.push_back (members);
+
+  // Let each member know its response slot, as it would be told when the
+  // group is set up over the air
+  for (uint16_t slot = 0; slot < members.size (); slot++)
+    {
+      std::map<CunbDeviceAddress,MSStatus>::iterator it =
+        m_msStatuses.find (members[slot]);
+      if (it == m_msStatuses.end () || it->second.GetMac () == 0)
+        {
+          NS_LOG_WARN ("Unknown group member " << members[slot].Print ());
+          continue;
+        }
+      it->second.GetMac ()->JoinGroup (groupId, slot);
+    }
+
+  return groupId;
+}
+
+Time
+SimpleCunbServer::SendGroupRequest (uint16_t groupId, uint64_t obisCode)
+{
+  NS_LOG_FUNCTION (this << groupId << obisCode);
+
+  NS_ASSERT (groupId < m_groups.size ());
+  const std::vector<CunbDeviceAddress> &members = m_groups[groupId];
+
+  // A single GET Request for the whole group
+  Ptr<Packet> packet = CreateRequestPacket (0, obisCode);
+
+  CunbBeaconPayload payload;
+  payload.SetGroupInfo (groupId, members.size (), m_groupSlotDuration);
+  packet->AddHeader (payload);
+
+  CunbBeaconHeader beaconHdr;
+  beaconHdr.SetGroupType (CunbBeaconHeader::GROUP_REQUEST);
+  beaconHdr.SetGrpSeqNo (m_groupSeqNo);
+  m_groupSeqNo = (m_groupSeqNo + 1) % 32; // GrpSeqNo is 5 bits long
+  packet->AddHeader (beaconHdr);
+
+  CunbBeaconTrailer beaconTlr;
+  packet->AddTrailer (beaconTlr);
+
+  CunbFrameHeader frameHdr;
+  frameHdr.SetAddress (CunbDeviceAddress (4294967295));
+  packet->AddHeader (frameHdr);
+
+  // Broadcast it through the eNBs that hear the members best
+  std::set<Address> enbAddresses;
+  for (uint32_t i = 0; i < members.size (); i++)
+    {
+      std::map<CunbDeviceAddress,MSStatus>::iterator it =
+        m_msStatuses.find (members[i]);
+      if (it != m_msStatuses.end () && it->second.GetNEnbs () > 0)
+        {
+          enbAddresses.insert (it->second.GetBestEnbAddress ());
+        }
+    }
+
+  // Skip the eNBs that can't transmit yet, as for the replies
+  uint32_t nSent = 0;
+  std::set<Address>::iterator it;
+  for (it = enbAddresses.begin (); it != enbAddresses.end (); ++it)
+    {
+      Ptr<Node> enb = GetEnbNodeFromAddress (*it);
+      std::map<Address,EnbStatus>::iterator status = m_enbStatuses.find (*it);
+      if (enb == 0 || status == m_enbStatuses.end () ||
+          !status->second.IsAvailableForTransmission
+            (EnbCunbMac::GROUP_DOWNLINK_FREQUENCY))
+        {
+          continue;
+        }
+      Ptr<EnbCunbMac> enbMac = enb->GetDevice (0)->GetObject<CunbNetDevice> ()
+        ->GetMac ()->GetObject<EnbCunbMac> ();
+      Ptr<Packet> copy = packet->Copy ();
+      if (enbMac->SendGroupDownlink (copy))
+        {
+          NotifyDownlink (*it, copy);
+          nSent++;
+        }
+    }
+
+  if (nSent == 0)
+    {
+      m_metrics->NotifyNoEnbAvailable ();
+      return Seconds (0);
+    }
+
+  m_metrics->NotifyGroupRequest ();
+  NS_LOG_INFO ("Group " << groupId << " request sent through " <<
+               nSent << " eNBs");
+
+  return TimeStep (m_groupSlotDuration.GetTimeStep () * members.size ());
+}
 
 }
@@ -6,9 +6,18 @@
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/packet.h"
 #include "ns3/cunb-device-address.h"
+#include "ns3/cunb-frame-header-ul.h"
+#include "ns3/cunb-tag.h"
 #include "ns3/ms-status.h"
 #include "ns3/enb-status.h"
 #include "ns3/node-container.h"
+#include "ns3/cunb-read-campaign.h"
+#include "ns3/cunb-reading-sink.h"
+#include "ns3/cunb-server-metrics.h"
+#include "ns3/cunb-adr-engine.h"
+#include "ns3/cunb-meter-population.h"
+#include "ns3/traced-callback.h"
+#include <vector>
 
 namespace ns3 {
 
@@ -16,26 +25,46 @@ namespace ns3 {
  * A SimpleCunbServer is an application standing on top of a node equipped with
  * links that connect it with the enbs.
  *
- * This version of the CunbServer isn't smart enough to handle MAC commands,
- * but can reply correctly with ACKs to confirm uplink messages.
+ * This version of the CunbServer replies with ACKs to confirm uplink
+ * messages. MAC commands travel in the options (FOpts) of the frame headers:
+ * those of the uplinks are handled by ParseCommands, and the ones meant for
+ * a MS are queued in its MSStatus until an ACK has room for them.
  */
 class SimpleCunbServer : public Application
 {
 public:
 
-  static TypeId GetTypeId (void);
+  /**
+   * How the eNB used to reach a MS is picked among the available ones.
+   */
+  enum EnbSelectionPolicy
+  {
+    STRONGEST_FIRST,     //!< The eNB that receives the MS best
+    LEAST_LOADED,        //!< The eNB with the shortest downlink queue among
+                         //!those with enough link margin
+    WEIGHTED_ROUND_ROBIN //!< Turns proportional to the eNB weights
+  };
+
+  /**
+   * TracedCallback signature for downlink packets handed to an eNB.
+   *
+   * \param enbId The node id of the eNB.
+   * \param queueDepth The downlink packets queued at the eNB, this included.
+   * \param airtime The total time on air of the eNB's downlink packets.
+   */
+  typedef void (* EnbLoadCallback)(uint32_t enbId, uint32_t queueDepth,
+                                   Time airtime);
 
-  static int helloCount;
-  static int AAreqCount;
-  static int GETreqCount;
+  static TypeId GetTypeId (void);
 
   SimpleCunbServer();
   virtual ~SimpleCunbServer();
 
   /**
-   * Parse and take action on the commands contained on the frameHeader
+   * Parse and take action on the commands contained on the frameHeader of an
+   * uplink. Answers are queued for the sending MS.
    */
-  void ParseCommands (CunbFrameHeader frameHeader);
+  void ParseCommands (const CunbFrameHeaderUl &frameHeader);
 
   /**
    * Start the Cunb application
@@ -64,6 +93,12 @@ public:
    */
   void AddEnb (Ptr<Node> enb, Ptr<NetDevice> netDevice);
 
+  /**
+   * Inform the SimpleCunbServer of the meters of a population. Since they
+   * don't listen, their uplinks are never answered.
+   */
+  void AddPopulation (Ptr<CunbMeterPopulation> population);
+
   void AddNodeAddressPair(Ptr<Node> ms, CunbDeviceAddress address);
 
   void AddMacAddressPair(Ptr<EnbCunbMac> enbMac, CunbDeviceAddress address);
@@ -113,9 +148,10 @@ public:
    */
   Address GetEnbForReply (CunbDeviceAddress deviceAddress, double frequency);
 
-  bool PairExist(std::pair<uint16_t,uint8_t> id_seq_pair);
-
-  void RemoveOldPair(std::pair<uint16_t,uint8_t> id_seq_pair);
+  /**
+   * Set the weight of an eNB in the WEIGHTED_ROUND_ROBIN policy.
+   */
+  void SetEnbWeight (Ptr<Node> enb, uint32_t weight);
 
   bool PairSeqIdentRepExist(std::pair<std::pair<uint16_t,uint8_t>,uint8_t> id_seq_rep);
 
@@ -129,17 +165,86 @@ public:
 
   void SendRequest(CunbDeviceAddress address,double frequency, uint8_t requestType);
 
+  /**
+   * Send an AA Request (requestType 1) or a GET Request (requestType 0) for
+   * the given OBIS code to a MS.
+   *
+   * If PingSlotPeriod is set, the request is handed to the eNB at the start
+   * of the next ping slot of the MS.
+   *
+   * \return The address of the eNB used to send the request, or an empty
+   * Address if no eNB was available.
+   */
+  Address SendObisRequest(CunbDeviceAddress address,double frequency, uint8_t requestType, uint64_t obisCode);
+
+  /**
+   * Let a read campaign drive the requests to its target MSs. AARE and
+   * GET Responses of the targets are handed to the campaign instead of
+   * triggering the next request after a fixed delay.
+   */
+  void SetReadCampaign (Ptr<CunbReadCampaign> campaign);
+
+  Ptr<CunbReadCampaign> GetReadCampaign (void) const;
+
+  /**
+   * Set the sink every decoded GET Response is recorded to. The sink is
+   * flushed when the application stops.
+   */
+  void SetReadingSink (Ptr<CunbReadingSink> sink);
+
+  Ptr<CunbReadingSink> GetReadingSink (void) const;
+
+  /**
+   * Let an ADR engine adjust the TX power of the MSs. Its decisions are
+   * queued for the MSs as LinkAdrReq MAC commands, which are sent again on
+   * every ACK until the MS answers with a LinkAdrAns. Only then is the new
+   * power recorded in the MSStatus.
+   */
+  void SetAdrEngine (Ptr<CunbAdrEngine> adrEngine);
+
+  Ptr<CunbAdrEngine> GetAdrEngine (void) const;
+
+  /**
+   * Define a group of MSs that can be read with a single group downlink.
+   * Each MS is given the response slot of its position in members.
+   *
+   * \param members The addresses of the MSs of the group.
+   * \return The id of the group.
+   */
+  uint16_t AddGroup (const std::vector<CunbDeviceAddress> &members);
+
+  /**
+   * Send a GET Request for the given OBIS code to all the MSs of a group,
+   * as a single beacon-type frame per eNB. The MSs then answer one after
+   * the other, each in its response slot.
+   *
+   * eNBs held back by their duty cycle are skipped.
+   *
+   * \return The time after which all the response slots are over, or zero
+   * if no eNB could reach the group.
+   */
+  Time SendGroupRequest (uint16_t groupId, uint64_t obisCode);
+
+  /**
+   * Replace the counters and histograms of this server. A null value gives
+   * the server new, empty ones.
+   */
+  void SetMetrics (Ptr<CunbServerMetrics> metrics);
+
+  /**
+   * Get the counters and histograms of this server.
+   */
+  Ptr<CunbServerMetrics> GetMetrics (void) const;
+
 
 protected:
   std::map<CunbDeviceAddress,MSStatus> m_msStatuses;
 
   std::map<Address,EnbStatus> m_enbStatuses;
 
-  std::list<std::pair<uint16_t,uint8_t>> m_id_seq_pair;
-
   std::list<std::pair<std::pair<uint16_t,uint8_t>,uint8_t>> m_id_seq_rep_pair;
 
-  std::list<std::pair<Ptr<Node>,Address>> m_enbNode_address_pairs;
+  std::map<Address,Ptr<Node> > m_enbNodes; //!< eNB nodes, by address
 
 
 private:
@@ -153,6 +258,65 @@ private:
 
   ObjectFactory m_factory;
 
+  Ptr<CunbReadCampaign> m_readCampaign; //!< The campaign driving the requests, if any
+
+  Ptr<CunbReadingSink> m_readingSink; //!< Where the meter readings are stored, if anywhere
+
+  Ptr<CunbServerMetrics> m_metrics; //!< The counters of this server
+
+  Ptr<CunbAdrEngine> m_adrEngine; //!< Decides on TX power changes, if any
+
+  /**
+   * Build a request packet, from the APDU to the wrapper header.
+   *
+   * \param requestType 1 for an AA Request, 0 for a GET Request.
+   * \param obisCode The OBIS code a GET Request reads.
+   */
+  Ptr<Packet> CreateRequestPacket (uint8_t requestType, uint64_t obisCode);
+
+  /**
+   * Hand the value of a GET Response to the reading sink and to the read
+   * campaign, if any. A batched uplink carries several of them, which share
+   * its sequence number.
+   *
+   * \param index The position of the GET Response in the uplink, 0 for the
+   * first one.
+   */
+  void ReceiveGetResponse (CunbDeviceAddress msAddress, uint16_t ident,
+                           uint8_t seqNo, uint8_t index,
+                           const Address &enbAddress,
+                           const CunbTag &tag, uint32_t value);
+
+  /**
+   * Hand a downlink packet to an eNB, and account for it.
+   */
+  void SendToEnb (Address enbAddress, Ptr<Packet> packet);
+
+  /**
+   * Get the time until the next ping slot of a MS, zero if it's now or if
+   * PingSlotPeriod is zero. The slot is computed from the address of the MS
+   * and the ping slot attributes, which must match those of the MSs.
+   */
+  Time GetTimeToPingSlot (CunbDeviceAddress address) const;
+
+  /**
+   * Account for a downlink packet that was handed to an eNB.
+   */
+  void NotifyDownlink (Address enbAddress, Ptr<const Packet> packet);
+
+  enum EnbSelectionPolicy m_enbSelectionPolicy; //!< How eNBs are picked
+
+  double m_linkMarginThreshold; //!< Minimum link margin for LEAST_LOADED, in dB
+
+  std::vector<std::vector<CunbDeviceAddress> > m_groups; //!< Members, by group id
+  Time m_groupSlotDuration; //!< Response slot of a MS in a group downlink
+  uint8_t m_groupSeqNo;     //!< GrpSeqNo of the next group downlink
+
+  Time m_pingSlotPeriod;   //!< Ping slot period of the MSs, 0 to ignore them
+  Time m_pingSlotDuration; //!< Duration of the ping slots of the MSs
+
+  TracedCallback<uint32_t, uint32_t, Time> m_enbDownlink; //!< Load of the eNBs
+
 };
 
 } /* namespace ns3 */
@@ -1,7 +1,42 @@
 /* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
 
-// Include a header file from your module to test.
-#include "ns3/cunb.h"
+#include "ns3/cunb-phy.h"
+#include "ns3/enb-cunb-phy.h"
+#include "ns3/ms-cunb-phy.h"
+#include "ns3/ms-cunb-mac.h"
+#include "ns3/cunb-channel.h"
+#include "ns3/cunb-net-device.h"
+#include "ns3/cunb-interference-helper.h"
+#include "ns3/cunb-mac-header-ul.h"
+#include "ns3/cunb-mac-trailer.h"
+#include "ns3/cunb-frame-header.h"
+#include "ns3/cunb-frame-header-ul.h"
+#include "ns3/cunb-linklayer-header.h"
+#include "ns3/cunb-beacon-payload.h"
+#include "ns3/app-layer-header.h"
+#include "ns3/new-cosem-header.h"
+#include "ns3/cunb-tag.h"
+#include "ns3/cunb-phy-helper.h"
+#include "ns3/cunb-mac-helper.h"
+#include "ns3/cunb-helper.h"
+#include "ns3/cunb-server-helper.h"
+#include "ns3/cunb-forwarder-helper.h"
+#include "ns3/cunb-device-address-generator.h"
+#include "ns3/cunb-meter-population.h"
+#include "ns3/cunb-reading-sink.h"
+#include "ns3/cunb-packet-tracker-helper.h"
+#include "ns3/cunb-topology-loader.h"
+#include "ns3/Hello_helper.h"
+#include "ns3/OTR_Helper.h"
+#include "ns3/beacon-sender-helper.h"
+#include "ns3/simple-cunb-server.h"
+#include "ns3/ms-status.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/position-allocator.h"
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include <cmath>
+#include <fstream>
 
 // An essential include is test.h
 #include "ns3/test.h"
@@ -10,46 +45,1328 @@
 // to use the using directive to access the ns3 namespace directly
 using namespace ns3;
 
-// This is an example TestCase.
-class CunbTestCase1 : public TestCase
+/**
+ * The TX parameters MSCunbMac uses for the uplink.
+ */
+static CunbTxParameters
+GetUplinkTxParameters (void)
+{
+  CunbTxParameters params;
+  params.bitrate = 250;
+  params.nPreamble = 8;
+  return params;
+}
+
+/**
+ * The center frequencies of the uplink micro channels, computed as
+ * CunbMacHelper does, so that they match the eNB reception paths exactly.
+ */
+static std::vector<double>
+GetMicroChannels (void)
+{
+  std::vector<double> frequencies;
+  double start = 868.1;
+  double step = (868.3 - 868.1) / 150;
+  for (uint32_t i = 0; i < 150; i++)
+    {
+      double end = start + step;
+      frequencies.push_back ((start + end) / 2);
+      start = start + step;
+    }
+  return frequencies;
+}
+
+/**
+ * Build the frame of a GET Response, from the COSEM header to the MAC
+ * trailer, as MobileAutonomousReporting and MSCunbMac do.
+ */
+static Ptr<Packet>
+CreateUplink (CunbDeviceAddress address, uint16_t ident, uint8_t seqCnt,
+              uint32_t value)
+{
+  Ptr<Packet> packet = Create<Packet> (10);
+
+  NewCosemGetResponseNormalHeader cosemHdr;
+  cosemHdr.SetInvokeIdAndPriority (2);
+  cosemHdr.SetData (value);
+  cosemHdr.SetDataAccessResult (0);
+  packet->AddHeader (cosemHdr);
+
+  NewTypeAPDU typeHdr;
+  typeHdr.SetApduType ((ApduType)cosemHdr.GetIdApdu ());
+  packet->AddHeader (typeHdr);
+
+  AppLayerHeader appHdr;
+  appHdr.SetPtype (1);
+  packet->AddHeader (appHdr);
+
+  NewCosemWrapperHeader wrapperHdr;
+  wrapperHdr.SetSrcwPort (80);
+  wrapperHdr.SetDstwPort (90);
+  wrapperHdr.SetLength (packet->GetSize ());
+  packet->AddHeader (wrapperHdr);
+
+  CunbLinkLayerHeader llHdr;
+  packet->AddHeader (llHdr);
+
+  CunbFrameHeaderUl frameHdr;
+  frameHdr.SetFPort (1);
+  frameHdr.SetAddress (address);
+  packet->AddHeader (frameHdr);
+
+  CunbMacHeaderUl macHdr;
+  macHdr.SetMType (CunbMacHeaderUl::SINGLE_ACK);
+  macHdr.SetRepCnts (0);
+  macHdr.SetSeqCnt (seqCnt);
+  macHdr.SetIdent (ident);
+  packet->AddHeader (macHdr);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  macTlr.SetFcs (packet);
+  macTlr.SetMacHeader (macHdr);
+  macTlr.SetAuth (packet);
+  packet->AddTrailer (macTlr);
+
+  CunbTag tag;
+  packet->AddPacketTag (tag);
+
+  return packet;
+}
+
+/**
+ * The channel model of the examples.
+ */
+static Ptr<CunbChannel>
+CreateChannel (void)
+{
+  Ptr<LogDistancePropagationLossModel> loss = CreateObject<LogDistancePropagationLossModel> ();
+  loss->SetPathLossExponent (3.76);
+  loss->SetReference (1, 8.1);
+  Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  return CreateObject<CunbChannel> (loss, delay);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Unit tests
+//////////////////////////////////////////////////////////////////////////////
+
+// Time on air of uplinks and downlinks
+class OnAirTimeTestCase : public TestCase
+{
+public:
+  OnAirTimeTestCase ();
+  virtual ~OnAirTimeTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+OnAirTimeTestCase::OnAirTimeTestCase ()
+  : TestCase ("Verify the time on air of uplinks and downlinks")
+{
+}
+
+OnAirTimeTestCase::~OnAirTimeTestCase ()
+{
+}
+
+void
+OnAirTimeTestCase::DoRun (void)
+{
+  CunbTxParameters uplink = GetUplinkTxParameters ();
+  CunbTxParameters downlink;
+
+  // Four symbols per byte, of 2/bitrate seconds each
+  Ptr<Packet> packet = Create<Packet> (20);
+  NS_TEST_ASSERT_MSG_EQ_TOL (CunbPhy::GetOnAirTime (packet, uplink, MS).GetSeconds (),
+                             0.64, 1e-9, "Wrong time on air of a 20 bytes uplink");
+  NS_TEST_ASSERT_MSG_EQ_TOL (CunbPhy::GetOnAirTime (packet, downlink, ENB).GetSeconds (),
+                             20 * 4 * 2 / 600.0, 1e-9, "Wrong time on air of a 20 bytes downlink");
+
+  packet = Create<Packet> (230);
+  NS_TEST_ASSERT_MSG_EQ_TOL (CunbPhy::GetOnAirTime (packet, uplink, MS).GetSeconds (),
+                             7.36, 1e-9, "Wrong time on air of a 230 bytes uplink");
+
+  packet = Create<Packet> (0);
+  NS_TEST_ASSERT_MSG_EQ (CunbPhy::GetOnAirTime (packet, uplink, MS), Seconds (0),
+                         "An empty packet takes no time on air");
+}
+
+// Overlap of two reception events
+class OverlapTimeTestCase : public TestCase
+{
+public:
+  OverlapTimeTestCase ();
+  virtual ~OverlapTimeTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void AddEvent (Time duration, double frequency);
+
+  CunbInterferenceHelper m_interference;
+  std::vector<Ptr<CunbInterferenceHelper::Event> > m_events;
+};
+
+OverlapTimeTestCase::OverlapTimeTestCase ()
+  : TestCase ("Verify the overlap time of reception events")
+{
+}
+
+OverlapTimeTestCase::~OverlapTimeTestCase ()
+{
+}
+
+void
+OverlapTimeTestCase::AddEvent (Time duration, double frequency)
+{
+  m_events.push_back (m_interference.Add (duration, -100, Create<Packet> (10),
+                                          frequency));
+}
+
+void
+OverlapTimeTestCase::DoRun (void)
+{
+  // Events start at the time they are added
+  Simulator::Schedule (Seconds (0), &OverlapTimeTestCase::AddEvent, this, Seconds (2), 868.5);   // [0, 2]
+  Simulator::Schedule (Seconds (0.5), &OverlapTimeTestCase::AddEvent, this, Seconds (1), 868.5); // [0.5, 1.5]
+  Simulator::Schedule (Seconds (1), &OverlapTimeTestCase::AddEvent, this, Seconds (3), 868.5);   // [1, 4]
+  Simulator::Schedule (Seconds (5), &OverlapTimeTestCase::AddEvent, this, Seconds (1), 868.5);   // [5, 6]
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_events.size (), 4, "Not all the events were added");
+
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[0], m_events[2]), Seconds (1),
+                         "Wrong overlap of partially overlapping events");
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[2], m_events[0]), Seconds (1),
+                         "The overlap depends on the order of the events");
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[0], m_events[1]), Seconds (1),
+                         "Wrong overlap of an event contained in the other");
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[1], m_events[0]), Seconds (1),
+                         "Wrong overlap of an event containing the other");
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[0], m_events[3]), Seconds (0),
+                         "Disjoint events overlap");
+  NS_TEST_ASSERT_MSG_EQ (m_interference.GetOverlapTime (m_events[3], m_events[2]), Seconds (0),
+                         "Disjoint events overlap");
+
+  Simulator::Destroy ();
+}
+
+// Outcome of a reception in presence of other events
+class InterferenceTestCase : public TestCase
+{
+public:
+  InterferenceTestCase ();
+  virtual ~InterferenceTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  void AddEvent (Time duration, double frequency);
+
+  /**
+   * Whether an event of 2 s on 868.5 MHz, starting at 0, is destroyed by a
+   * second one.
+   */
+  bool IsDestroyed (Time start, Time duration, double frequency);
+
+  CunbInterferenceHelper m_interference;
+  std::vector<Ptr<CunbInterferenceHelper::Event> > m_events;
+};
+
+InterferenceTestCase::InterferenceTestCase ()
+  : TestCase ("Verify the interference decisions")
+{
+}
+
+InterferenceTestCase::~InterferenceTestCase ()
+{
+}
+
+void
+InterferenceTestCase::AddEvent (Time duration, double frequency)
+{
+  m_events.push_back (m_interference.Add (duration, -100, Create<Packet> (10),
+                                          frequency));
+}
+
+bool
+InterferenceTestCase::IsDestroyed (Time start, Time duration, double frequency)
+{
+  m_interference.ClearAllEvents ();
+  m_events.clear ();
+
+  Simulator::Schedule (Seconds (0), &InterferenceTestCase::AddEvent, this, Seconds (2), 868.5);
+  Simulator::Schedule (start, &InterferenceTestCase::AddEvent, this, duration, frequency);
+  Simulator::Run ();
+
+  bool destroyed = m_interference.IsDestroyedByInterference (m_events[0]);
+  Simulator::Destroy ();
+  return destroyed;
+}
+
+void
+InterferenceTestCase::DoRun (void)
+{
+  NS_TEST_ASSERT_MSG_EQ (IsDestroyed (Seconds (1), Seconds (2), 868.5), true,
+                         "An overlapping event on the same frequency didn't destroy the reception");
+  NS_TEST_ASSERT_MSG_EQ (IsDestroyed (Seconds (0.5), Seconds (0.1), 868.5), true,
+                         "A short event within the reception didn't destroy it");
+  NS_TEST_ASSERT_MSG_EQ (IsDestroyed (Seconds (1), Seconds (2), 868.4), false,
+                         "An event on another frequency destroyed the reception");
+  NS_TEST_ASSERT_MSG_EQ (IsDestroyed (Seconds (3), Seconds (1), 868.5), false,
+                         "A later event destroyed the reception");
+  NS_TEST_ASSERT_MSG_EQ (IsDestroyed (Seconds (2), Seconds (1), 868.5), false,
+                         "An event starting at the end of the reception destroyed it");
+}
+
+// FCS and MIC of the MAC trailer
+class MacTrailerTestCase : public TestCase
+{
+public:
+  MacTrailerTestCase ();
+  virtual ~MacTrailerTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+MacTrailerTestCase::MacTrailerTestCase ()
+  : TestCase ("Verify the FCS and MIC of the MAC trailer")
+{
+}
+
+MacTrailerTestCase::~MacTrailerTestCase ()
+{
+}
+
+void
+MacTrailerTestCase::DoRun (void)
+{
+  uint8_t data[20];
+  for (uint8_t i = 0; i < 20; i++)
+    {
+      data[i] = i;
+    }
+  Ptr<Packet> packet = Create<Packet> (data, 20);
+
+  CunbMacHeaderUl macHdr;
+  macHdr.SetIdent (7);
+  macHdr.SetSeqCnt (3);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  macTlr.SetFcs (packet);
+  macTlr.SetMacHeader (macHdr);
+  macTlr.SetAuth (packet);
+
+  // Golden values: the FCS is a CRC-16/KERMIT, the MIC the last 16 bits of
+  // the SHA-1 of the data followed by the ident and sequence counter in
+  // decimal
+  NS_TEST_ASSERT_MSG_EQ (macTlr.GetFcs (), 0xa185, "Wrong FCS");
+  NS_TEST_ASSERT_MSG_EQ (macTlr.GetAuth (), 0xa4ed, "Wrong MIC");
+
+  // Round-trip through the packet
+  packet->AddTrailer (macTlr);
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 20 + macTlr.GetSerializedSize (),
+                         "Wrong size of the trailer");
+
+  CunbMacTrailer rxTlr;
+  rxTlr.EnableFcs (true);
+  packet->RemoveTrailer (rxTlr);
+  rxTlr.SetMacHeader (macHdr);
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.GetFcs (), 0xa185, "The FCS didn't survive serialization");
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.GetAuth (), 0xa4ed, "The MIC didn't survive serialization");
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.CheckFcs (packet), true, "The FCS of the intact frame is wrong");
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.CheckAuth (packet), true, "The MIC of the intact frame is wrong");
+
+  // A flipped bit
+  data[5] ^= 0x01;
+  Ptr<Packet> corrupted = Create<Packet> (data, 20);
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.CheckFcs (corrupted), false, "The FCS missed a flipped bit");
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.CheckAuth (corrupted), false, "The MIC missed a flipped bit");
+
+  // A replayed frame, under another sequence counter
+  macHdr.SetSeqCnt (4);
+  rxTlr.SetMacHeader (macHdr);
+  NS_TEST_ASSERT_MSG_EQ (rxTlr.CheckAuth (packet), false, "The MIC ignores the sequence counter");
+}
+
+// Sequence numbers the server remembers to spot duplicates
+class UplinkWindowTestCase : public TestCase
+{
+public:
+  UplinkWindowTestCase ();
+  virtual ~UplinkWindowTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+UplinkWindowTestCase::UplinkWindowTestCase ()
+  : TestCase ("Check the window of uplinks used to spot duplicates")
+{
+}
+
+UplinkWindowTestCase::~UplinkWindowTestCase ()
+{
+}
+
+void
+UplinkWindowTestCase::DoRun (void)
+{
+  MSStatus status;
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (0), false, "A first uplink is a duplicate");
+
+  status.AddUplink (0);
+  status.AddUplink (2);
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (0), true, "A duplicate was missed");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (1), false, "A skipped uplink is a duplicate");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (2), true, "A duplicate was missed");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (3), false, "The next uplink is a duplicate");
+
+  // A late uplink, still in the window
+  status.AddUplink (1);
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (1), true, "A late uplink was forgotten");
+
+  // Over a lap of the counter, every number is new again once reached
+  for (uint32_t seqNo = 3; seqNo < 256 + 3; seqNo++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (status.HasUplink (seqNo % 256), false,
+                             "Uplink " << seqNo << " is a duplicate");
+      status.AddUplink (seqNo % 256);
+    }
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (2), true, "A duplicate was missed");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (2 - MSStatus::SEQ_WINDOW + 256), true,
+                         "The oldest uplink of the window was forgotten");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (3), false, "The next uplink is a duplicate");
+  NS_TEST_ASSERT_MSG_EQ (status.HasUplink (2 + MSStatus::SEQ_WINDOW - 1), false,
+                         "An uplink ahead of the window is a duplicate");
+}
+
+// Serialization of the uplink header stack and the beacon payload
+class HeaderSerializationTestCase : public TestCase
+{
+public:
+  HeaderSerializationTestCase ();
+  virtual ~HeaderSerializationTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+HeaderSerializationTestCase::HeaderSerializationTestCase ()
+  : TestCase ("Verify the serialization of the headers")
+{
+}
+
+HeaderSerializationTestCase::~HeaderSerializationTestCase ()
+{
+}
+
+void
+HeaderSerializationTestCase::DoRun (void)
+{
+  CunbDeviceAddress address (54, 1864);
+  Ptr<Packet> packet = CreateUplink (address, 513, 200, 123456);
+
+  CunbMacTrailer macTlr;
+  macTlr.EnableFcs (true);
+  packet->RemoveTrailer (macTlr);
+
+  CunbMacHeaderUl macHdr;
+  packet->RemoveHeader (macHdr);
+  NS_TEST_ASSERT_MSG_EQ (unsigned (macHdr.GetMType ()), unsigned (CunbMacHeaderUl::SINGLE_ACK),
+                         "Wrong MType");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (macHdr.GetSeqCnt ()), 200, "Wrong sequence counter");
+  NS_TEST_ASSERT_MSG_EQ (macHdr.GetIdent (), 513, "Wrong ident");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (macHdr.GetRepCnts ()), 0, "Wrong repetition counter");
+
+  CunbFrameHeaderUl frameHdr;
+  packet->RemoveHeader (frameHdr);
+  NS_TEST_ASSERT_MSG_EQ (unsigned (frameHdr.GetFPort ()), 1, "Wrong FPort");
+  NS_TEST_ASSERT_MSG_EQ (frameHdr.GetAddress (), address, "Wrong address");
+  NS_TEST_ASSERT_MSG_EQ (frameHdr.GetSerializedSize (), 5,
+                         "A header without options shouldn't carry FCtrl");
+
+  // Options bring the FCtrl byte along
+  CunbFrameHeader dlHdr;
+  dlHdr.SetAddress (address);
+  dlHdr.SetFPort (1);
+  dlHdr.AddCommand (Create<LinkCheckAns> (12, 2));
+  Ptr<Packet> dl = Create<Packet> ();
+  dl->AddHeader (dlHdr);
+  NS_TEST_ASSERT_MSG_EQ (dl->GetSize (), 6 + dlHdr.GetFOptsLength (),
+                         "Wrong size of a header with options");
+  CunbFrameHeader rxDlHdr;
+  dl->RemoveHeader (rxDlHdr);
+  NS_TEST_ASSERT_MSG_EQ (unsigned (rxDlHdr.GetFPort ()), 1,
+                         "The FPort kept the FCtrl flag");
+  NS_TEST_ASSERT_MSG_EQ (rxDlHdr.GetCommands ().size (), 1, "The option was lost");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (rxDlHdr.GetCommands ().front ()->GetCommandType ()),
+                         unsigned (LINK_CHECK_ANS), "Wrong option");
+
+  CunbLinkLayerHeader llHdr;
+  packet->RemoveHeader (llHdr);
+
+  NewCosemWrapperHeader wrapperHdr;
+  packet->RemoveHeader (wrapperHdr);
+  NS_TEST_ASSERT_MSG_EQ (wrapperHdr.GetSrcwPort (), 80, "Wrong source wPort");
+  NS_TEST_ASSERT_MSG_EQ (wrapperHdr.GetDstwPort (), 90, "Wrong destination wPort");
+  NS_TEST_ASSERT_MSG_EQ (wrapperHdr.GetLength (), packet->GetSize (),
+                         "The wrapper length isn't the one of the APDU");
+
+  AppLayerHeader appHdr;
+  packet->RemoveHeader (appHdr);
+  NS_TEST_ASSERT_MSG_EQ (appHdr.GetPtype (), 1, "Wrong packet type");
+
+  NewTypeAPDU typeHdr;
+  packet->RemoveHeader (typeHdr);
+  NS_TEST_ASSERT_MSG_EQ (typeHdr.GetApduType (), GETRES_N, "Wrong APDU type");
+
+  NewCosemGetResponseNormalHeader cosemHdr;
+  packet->RemoveHeader (cosemHdr);
+  NS_TEST_ASSERT_MSG_EQ (cosemHdr.GetData (), 123456, "Wrong data");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (cosemHdr.GetInvokeIdAndPriority ()), 2,
+                         "Wrong invoke id and priority");
+  NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), 10, "The payload isn't what is left");
+
+  // The TLV elements of the beacon
+  CunbBeaconPayload payload;
+  payload.SetTxPower (-3);
+  payload.SetSlotConfig (16, MilliSeconds (1500));
+  payload.SetNetworkTime (MilliSeconds (3723042));
+  Ptr<Packet> beacon = Create<Packet> ();
+  beacon->AddHeader (payload);
+  NS_TEST_ASSERT_MSG_EQ (beacon->GetSize (), payload.GetSerializedSize (),
+                         "Wrong size of the beacon payload");
+
+  CunbBeaconPayload rxPayload;
+  beacon->RemoveHeader (rxPayload);
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.Has (CunbBeaconPayload::TX_POWER), true, "TX power missing");
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.Has (CunbBeaconPayload::GROUP_INFO), false,
+                         "Group info where there's none");
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.GetTxPower (), -3, "Wrong TX power");
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.GetSlotCount (), 16, "Wrong slot count");
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.GetSlotDuration (), MilliSeconds (1500), "Wrong slot duration");
+  NS_TEST_ASSERT_MSG_EQ (rxPayload.GetNetworkTime (), MilliSeconds (3723042), "Wrong network time");
+}
+
+// Records of the packet tracker, in and out of its table
+class PacketTrackerTestCase : public TestCase
 {
 public:
-  CunbTestCase1 ();
-  virtual ~CunbTestCase1 ();
+  PacketTrackerTestCase ();
+  virtual ~PacketTrackerTestCase ();
 
 private:
   virtual void DoRun (void);
+
+  /**
+   * Build a transmission of a payload, as MSCunbMac does for each of its
+   * repetitions.
+   */
+  Ptr<Packet> BuildTransmission (Ptr<const Packet> payload, uint8_t repetition);
+
+  /**
+   * Give a packet the same outcome at both eNBs.
+   */
+  void NotifyOutcomes (CunbPacketTrackerHelper &tracker, Ptr<const Packet> packet,
+                       enum CunbPacketTrackerHelper::Outcome outcome);
+
+  NodeContainer m_enbs;
 };
 
-// Add some help text to this case to describe what it is intended to test
-CunbTestCase1::CunbTestCase1 ()
-  : TestCase ("Cunb test case (does nothing)")
+PacketTrackerTestCase::PacketTrackerTestCase ()
+  : TestCase ("Check the records of the packet tracker")
 {
 }
 
-// This destructor does nothing but we include it as a reminder that
-// the test case should clean up after itself
-CunbTestCase1::~CunbTestCase1 ()
+PacketTrackerTestCase::~PacketTrackerTestCase ()
 {
 }
 
-//
-// This method is the pure virtual method from class TestCase that every
-// TestCase must implement
-//
+Ptr<Packet>
+PacketTrackerTestCase::BuildTransmission (Ptr<const Packet> payload, uint8_t repetition)
+{
+  Ptr<Packet> packet = payload->Copy ();
+  CunbMacHeaderUl macHdr;
+  macHdr.SetMType (CunbMacHeaderUl::SINGLE_ACK);
+  macHdr.SetRepCnts (repetition);
+  packet->AddHeader (macHdr);
+  return packet;
+}
+
 void
-CunbTestCase1::DoRun (void)
+PacketTrackerTestCase::NotifyOutcomes (CunbPacketTrackerHelper &tracker,
+                                       Ptr<const Packet> packet,
+                                       enum CunbPacketTrackerHelper::Outcome outcome)
 {
-  // A wide variety of test macros are available in src/core/test.h
-  NS_TEST_ASSERT_MSG_EQ (true, true, "true doesn't equal true for some reason");
-  // Use this one for floating point comparisons
-  NS_TEST_ASSERT_MSG_EQ_TOL (0.01, 0.01, 0.001, "Numbers are not equal within tolerance");
+  tracker.NotifyOutcome (packet, m_enbs.Get (0)->GetId (), outcome);
+  tracker.NotifyOutcome (packet, m_enbs.Get (1)->GetId (), outcome);
 }
 
-// The TestSuite class names the TestSuite, identifies what type of TestSuite,
-// and enables the TestCases to be run.  Typically, only the constructor for
-// this class must be defined
-//
+void
+PacketTrackerTestCase::DoRun (void)
+{
+  CunbPhyHelper phyHelper = CunbPhyHelper ();
+  phyHelper.SetChannel (CreateChannel ());
+  phyHelper.SetDeviceType (CunbPhyHelper::ENB);
+  CunbMacHelper macHelper = CunbMacHelper ();
+  macHelper.SetDeviceType (CunbMacHelper::ENB);
+  macHelper.SetRegion (CunbMacHelper::EU);
+  CunbHelper helper = CunbHelper ();
+
+  m_enbs = NodeContainer ();
+  m_enbs.Create (2);
+  MobilityHelper mobility;
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (m_enbs);
+  helper.Install (phyHelper, macHelper, m_enbs);
+  uint32_t enb0 = m_enbs.Get (0)->GetId ();
+  uint32_t enb1 = m_enbs.Get (1)->GetId ();
+
+  // The repetitions of an uplink share the UID of its payload, each of them
+  // has a record of its own
+  CunbPacketTrackerHelper tracker;
+  tracker.InstallReceivers (m_enbs);
+  Ptr<Packet> payload = Create<Packet> (10);
+  Ptr<Packet> first = BuildTransmission (payload, 0);
+  Ptr<Packet> second = BuildTransmission (payload, 1);
+  tracker.NotifySent (first, 0);
+  tracker.NotifySent (second, 0);
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNSent (), 2, "Wrong number of packets sent");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNPending (), 2, "The repetitions share a record");
+
+  tracker.NotifyOutcome (first, enb0, CunbPacketTrackerHelper::RECEIVED);
+  tracker.NotifyOutcome (first, enb1, CunbPacketTrackerHelper::INTERFERED);
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNPending (), 1, "The first repetition wasn't retired");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNDelivered (), 1, "The first repetition wasn't delivered");
+
+  // A second outcome at the same eNB is ignored, as are unknown packets
+  tracker.NotifyOutcome (second, enb0, CunbPacketTrackerHelper::UNDER_SENSITIVITY);
+  tracker.NotifyOutcome (second, enb0, CunbPacketTrackerHelper::RECEIVED);
+  NotifyOutcomes (tracker, BuildTransmission (Create<Packet> (10), 0),
+                  CunbPacketTrackerHelper::RECEIVED);
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNPending (), 1, "A record was retired too soon");
+  tracker.NotifyOutcome (second, enb1, CunbPacketTrackerHelper::UNDER_SENSITIVITY);
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNPending (), 0, "The second repetition wasn't retired");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetNDelivered (), 1, "The second repetition was delivered");
+  NS_TEST_ASSERT_MSG_EQ_TOL (tracker.GetPdr (), 0.5, 1e-9, "Wrong PDR");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetOutcomeCount (CunbPacketTrackerHelper::RECEIVED), 1,
+                         "Wrong number of receptions");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetOutcomeCount (CunbPacketTrackerHelper::INTERFERED), 1,
+                         "Wrong number of interfered receptions");
+  NS_TEST_ASSERT_MSG_EQ (tracker.GetOutcomeCount (CunbPacketTrackerHelper::UNDER_SENSITIVITY), 2,
+                         "Wrong number of receptions under the sensitivity");
+
+  // At 3/4 of the capacity, records share their probe sequences: erasing
+  // them out of order must move the others back without losing any
+  CunbPacketTrackerHelper dense;
+  dense.InstallReceivers (m_enbs);
+  dense.SetCapacity (64);
+  std::vector<Ptr<Packet> > packets;
+  for (uint32_t i = 0; i < 48; i++)
+    {
+      packets.push_back (BuildTransmission (Create<Packet> (10), 0));
+      dense.NotifySent (packets.back (), 0);
+    }
+  NS_TEST_ASSERT_MSG_EQ (dense.GetNPending (), 48, "Wrong number of records");
+  uint32_t pending = 48;
+  for (uint32_t step = 0; step < 2; step++)
+    {
+      for (uint32_t i = step; i < packets.size (); i += 2)
+        {
+          NotifyOutcomes (dense, packets[packets.size () - 1 - i],
+                          CunbPacketTrackerHelper::RECEIVED);
+          pending--;
+          NS_TEST_ASSERT_MSG_EQ (dense.GetNPending (), pending,
+                                 "A record was lost by an erase");
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (dense.GetNDelivered (), 48, "Wrong number of packets delivered");
+  NS_TEST_ASSERT_MSG_EQ (dense.GetNTimedOut (), 0, "Records timed out");
+
+  // The sweep retires the records older than the timeout, whatever their
+  // outcomes
+  CunbPacketTrackerHelper swept;
+  swept.InstallReceivers (m_enbs);
+  swept.SetTimeout (Seconds (1));
+  Ptr<Packet> complete = BuildTransmission (Create<Packet> (10), 0);
+  Ptr<Packet> partial = BuildTransmission (Create<Packet> (10), 0);
+  Ptr<Packet> silent = BuildTransmission (Create<Packet> (10), 0);
+  Ptr<Packet> late = BuildTransmission (Create<Packet> (10), 0);
+  swept.NotifySent (complete, 0);
+  swept.NotifySent (partial, 0);
+  swept.NotifySent (silent, 0);
+  NotifyOutcomes (swept, complete, CunbPacketTrackerHelper::RECEIVED);
+  swept.NotifyOutcome (partial, enb0, CunbPacketTrackerHelper::RECEIVED);
+  Simulator::Schedule (Seconds (1.5), &CunbPacketTrackerHelper::NotifySent, &swept,
+                       late, 0);
+  Simulator::Stop (Seconds (2));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (swept.GetNTimedOut (), 2, "Wrong number of records timed out");
+  NS_TEST_ASSERT_MSG_EQ (swept.GetNPending (), 1, "A recent record was swept");
+  NS_TEST_ASSERT_MSG_EQ (swept.GetNDelivered (), 2, "Wrong number of packets delivered");
+  NS_TEST_ASSERT_MSG_EQ (swept.GetOutcomeCount (CunbPacketTrackerHelper::UNSET), 3,
+                         "Wrong number of receptions without an outcome");
+
+  swept.Flush ();
+  NS_TEST_ASSERT_MSG_EQ (swept.GetNPending (), 0, "The flush left records");
+  NS_TEST_ASSERT_MSG_EQ (swept.GetNTimedOut (), 3, "Wrong number of records timed out");
+
+  Simulator::Destroy ();
+}
+
+// Parsing of topology files, and their binary cache
+class TopologyLoaderTestCase : public TestCase
+{
+public:
+  TopologyLoaderTestCase ();
+  virtual ~TopologyLoaderTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Write a cache with the given counts, followed by nPositions positions.
+   */
+  void WriteCache (std::string fileName, uint64_t nMeters, uint64_t nEnbs,
+                   uint32_t nPositions);
+};
+
+TopologyLoaderTestCase::TopologyLoaderTestCase ()
+  : TestCase ("Load topology files and caches")
+{
+}
+
+TopologyLoaderTestCase::~TopologyLoaderTestCase ()
+{
+}
+
+void
+TopologyLoaderTestCase::WriteCache (std::string fileName, uint64_t nMeters,
+                                    uint64_t nEnbs, uint32_t nPositions)
+{
+  std::ofstream file (fileName.c_str (), std::ios::binary);
+  uint64_t counts[2] = { nMeters, nEnbs };
+  file.write ("CUNBTOP1", 8);
+  file.write (reinterpret_cast<const char *> (counts), sizeof (counts));
+  std::vector<double> positions (3 * nPositions, 1.0);
+  file.write (reinterpret_cast<const char *> (positions.data ()),
+              positions.size () * sizeof (double));
+}
+
+void
+TopologyLoaderTestCase::DoRun (void)
+{
+  std::string textFile = CreateTempDirFilename ("topology.dat");
+  std::ofstream text (textFile.c_str ());
+  text << "# x y z" << std::endl;
+  text << "100 200 1.5" << std::endl;
+  text << "-3.25e2\t+4E1 0\r" << std::endl;
+  text << std::endl;
+  text << "  7 8 ENB" << std::endl;
+  text << "9 10 GW" << std::endl;
+  text << "not a node" << std::endl;
+  text << "1 2" << std::endl;
+  text << "1e99999999999 0 0" << std::endl;
+  text << "1e-99999999999 0 0";
+  text.close ();
+
+  CunbTopologyLoader loader;
+  loader.SetEnbHeight (30);
+  NS_TEST_ASSERT_MSG_EQ (loader.Load (textFile), true, "The text file wasn't loaded");
+  NS_TEST_ASSERT_MSG_EQ (loader.GetNMeters (), 4, "Wrong number of meters");
+  NS_TEST_ASSERT_MSG_EQ (loader.GetNEnbs (), 2, "Wrong number of eNBs");
+  NS_TEST_ASSERT_MSG_EQ (loader.GetNSkipped (), 2, "Wrong number of skipped lines");
+
+  const std::vector<Vector> &meters = loader.GetMeterPositions ();
+  NS_TEST_ASSERT_MSG_EQ (meters[0].x, 100, "Wrong x of the first meter");
+  NS_TEST_ASSERT_MSG_EQ (meters[0].y, 200, "Wrong y of the first meter");
+  NS_TEST_ASSERT_MSG_EQ (meters[0].z, 1.5, "Wrong z of the first meter");
+  NS_TEST_ASSERT_MSG_EQ (meters[1].x, -325, "Wrong x of the second meter");
+  NS_TEST_ASSERT_MSG_EQ (meters[1].y, 40, "Wrong y of the second meter");
+  // Huge exponents saturate instead of overflowing
+  NS_TEST_ASSERT_MSG_EQ (std::isinf (meters[2].x), true, "A huge exponent didn't saturate");
+  NS_TEST_ASSERT_MSG_EQ (meters[3].x, 0, "A huge negative exponent didn't give 0");
+
+  const std::vector<Vector> &enbs = loader.GetEnbPositions ();
+  NS_TEST_ASSERT_MSG_EQ (enbs[0].x, 7, "Wrong x of the first eNB");
+  NS_TEST_ASSERT_MSG_EQ (enbs[0].y, 8, "Wrong y of the first eNB");
+  NS_TEST_ASSERT_MSG_EQ (enbs[0].z, 30, "The eNB height wasn't applied");
+  NS_TEST_ASSERT_MSG_EQ (enbs[1].x, 9, "Wrong x of the second eNB");
+
+  // The cache gives back the same positions
+  std::string cacheFile = CreateTempDirFilename ("topology.cache");
+  NS_TEST_ASSERT_MSG_EQ (loader.WriteCache (cacheFile), true, "The cache wasn't written");
+  CunbTopologyLoader cached;
+  NS_TEST_ASSERT_MSG_EQ (cached.Load (cacheFile), true, "The cache wasn't loaded");
+  NS_TEST_ASSERT_MSG_EQ (cached.GetNMeters (), 4, "Wrong number of cached meters");
+  NS_TEST_ASSERT_MSG_EQ (cached.GetNEnbs (), 2, "Wrong number of cached eNBs");
+  for (uint32_t i = 0; i < cached.GetNMeters (); i++)
+    {
+      const Vector &position = cached.GetMeterPositions ()[i];
+      NS_TEST_ASSERT_MSG_EQ (position.x, meters[i].x, "Wrong cached meter " << i);
+      NS_TEST_ASSERT_MSG_EQ (position.y, meters[i].y, "Wrong cached meter " << i);
+      NS_TEST_ASSERT_MSG_EQ (position.z, meters[i].z, "Wrong cached meter " << i);
+    }
+  for (uint32_t i = 0; i < cached.GetNEnbs (); i++)
+    {
+      const Vector &position = cached.GetEnbPositions ()[i];
+      NS_TEST_ASSERT_MSG_EQ (position.x, enbs[i].x, "Wrong cached eNB " << i);
+      NS_TEST_ASSERT_MSG_EQ (position.y, enbs[i].y, "Wrong cached eNB " << i);
+      NS_TEST_ASSERT_MSG_EQ (position.z, enbs[i].z, "Wrong cached eNB " << i);
+    }
+
+  // Caches with more positions than they hold are refused, counts whose
+  // size overflows included
+  WriteCache (cacheFile, 2, 1, 2);
+  NS_TEST_ASSERT_MSG_EQ (cached.Load (cacheFile), false, "A truncated cache was loaded");
+  WriteCache (cacheFile, (uint64_t)1 << 61, (uint64_t)1 << 61, 1);
+  NS_TEST_ASSERT_MSG_EQ (cached.Load (cacheFile), false, "A corrupted cache was loaded");
+  WriteCache (cacheFile, 1, 1, 2);
+  NS_TEST_ASSERT_MSG_EQ (cached.Load (cacheFile), true, "A valid cache was refused");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// System tests
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+ * The outcomes of the receptions at the eNBs, summed over all of them.
+ */
+struct EnbOutcomes
+{
+  uint32_t rxBegin;
+  uint32_t received;
+  uint32_t interfered;
+  uint32_t underSensitivity;
+  uint32_t noMoreReceivers;
+};
+
+static void
+CountRxBegin (EnbOutcomes *outcomes, Ptr<const Packet> packet)
+{
+  outcomes->rxBegin++;
+}
+
+static void
+CountOutcome (uint32_t *counter, Ptr<const Packet> packet, uint32_t node)
+{
+  (*counter)++;
+}
+
+static void
+ConnectOutcomes (NodeContainer enbs, EnbOutcomes *outcomes)
+{
+  for (uint32_t i = 0; i < enbs.GetN (); i++)
+    {
+      Ptr<CunbPhy> phy = enbs.Get (i)->GetDevice (0)->GetObject<CunbNetDevice> ()->GetPhy ();
+      phy->TraceConnectWithoutContext ("PhyRxBegin",
+                                       MakeBoundCallback (&CountRxBegin, outcomes));
+      phy->TraceConnectWithoutContext ("ReceivedPacket",
+                                       MakeBoundCallback (&CountOutcome, &outcomes->received));
+      phy->TraceConnectWithoutContext ("LostPacketBecauseInterference",
+                                       MakeBoundCallback (&CountOutcome, &outcomes->interfered));
+      phy->TraceConnectWithoutContext ("LostPacketBecauseUnderSensitivity",
+                                       MakeBoundCallback (&CountOutcome, &outcomes->underSensitivity));
+      phy->TraceConnectWithoutContext ("LostPacketBecauseNoMoreReceivers",
+                                       MakeBoundCallback (&CountOutcome, &outcomes->noMoreReceivers));
+    }
+}
+
+// A small scripted network, every outcome of which is known
+class SmallNetworkTestCase : public TestCase
+{
+public:
+  SmallNetworkTestCase ();
+  virtual ~SmallNetworkTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Have a MS send a GET Response on a micro channel.
+   */
+  void SendUplink (uint32_t ms, uint8_t seqCnt, uint32_t channel);
+
+  NodeContainer m_mss;
+  std::vector<double> m_frequencies;
+};
+
+SmallNetworkTestCase::SmallNetworkTestCase ()
+  : TestCase ("Compare the KPIs of a small scripted network to golden values")
+{
+}
+
+SmallNetworkTestCase::~SmallNetworkTestCase ()
+{
+}
+
+void
+SmallNetworkTestCase::SendUplink (uint32_t ms, uint8_t seqCnt, uint32_t channel)
+{
+  Ptr<CunbNetDevice> device = m_mss.Get (ms)->GetDevice (0)->GetObject<CunbNetDevice> ();
+  CunbDeviceAddress address = device->GetMac ()->GetObject<MSCunbMac> ()->GetDeviceAddress ();
+
+  device->GetPhy ()->Send (CreateUplink (address, ms + 1, seqCnt, 1000 + ms),
+                           GetUplinkTxParameters (), m_frequencies[channel], 14);
+}
+
+void
+SmallNetworkTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+  m_frequencies = GetMicroChannels ();
+
+  Ptr<CunbChannel> channel = CreateChannel ();
+  CunbPhyHelper phyHelper = CunbPhyHelper ();
+  phyHelper.SetChannel (channel);
+  CunbMacHelper macHelper = CunbMacHelper ();
+  macHelper.SetRegion (CunbMacHelper::EU);
+  CunbHelper helper = CunbHelper ();
+
+  // Two MSs 100 m away from the eNB, and one out of its reach
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 0));
+  positions->Add (Vector (100, 0, 0));
+  positions->Add (Vector (0, 100, 0));
+  positions->Add (Vector (100000, 0, 0));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+
+  NodeContainer enbs;
+  enbs.Create (1);
+  mobility.Install (enbs);
+  phyHelper.SetDeviceType (CunbPhyHelper::ENB);
+  macHelper.SetDeviceType (CunbMacHelper::ENB);
+  helper.Install (phyHelper, macHelper, enbs);
+
+  m_mss = NodeContainer ();
+  m_mss.Create (3);
+  mobility.Install (m_mss);
+  phyHelper.SetDeviceType (CunbPhyHelper::MS);
+  macHelper.SetDeviceType (CunbMacHelper::MS);
+  macHelper.SetAddressGenerator (CreateObject<CunbDeviceAddressGenerator> (54, 1864));
+  helper.Install (phyHelper, macHelper, m_mss);
+
+  NodeContainer servers;
+  servers.Create (1);
+  CunbServerHelper serverHelper;
+  serverHelper.SetEnbs (enbs);
+  serverHelper.SetMSs (m_mss);
+  Ptr<SimpleCunbServer> server = DynamicCast<SimpleCunbServer>
+      (serverHelper.Install (servers).Get (0));
+  CunbForwarderHelper forwarderHelper;
+  forwarderHelper.Install (enbs);
+
+  Ptr<CunbBufferedReadingSink> sink = CreateObject<CunbBufferedReadingSink> ();
+  server->SetReadingSink (sink);
+
+  EnbOutcomes outcomes = EnbOutcomes ();
+  ConnectOutcomes (enbs, &outcomes);
+
+  // A clean uplink of each of the close MSs
+  Simulator::Schedule (Seconds (1), &SmallNetworkTestCase::SendUplink, this, 0, 0, 0);
+  Simulator::Schedule (Seconds (100), &SmallNetworkTestCase::SendUplink, this, 1, 0, 1);
+  // A collision: the first uplink takes the only reception path of the
+  // micro channel and is interfered, the second finds no free path
+  Simulator::Schedule (Seconds (200), &SmallNetworkTestCase::SendUplink, this, 0, 1, 2);
+  Simulator::Schedule (Seconds (200), &SmallNetworkTestCase::SendUplink, this, 1, 1, 2);
+  // An uplink under the sensitivity
+  Simulator::Schedule (Seconds (300), &SmallNetworkTestCase::SendUplink, this, 2, 0, 3);
+  // A repetition of the first uplink
+  Simulator::Schedule (Seconds (400), &SmallNetworkTestCase::SendUplink, this, 0, 0, 4);
+
+  Simulator::Stop (Seconds (500));
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (outcomes.rxBegin, 6, "Wrong number of receptions at the eNB");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.received, 3, "Wrong number of uplinks received");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.interfered, 1, "Wrong number of uplinks interfered");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.underSensitivity, 1,
+                         "Wrong number of uplinks under the sensitivity");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.noMoreReceivers, 1,
+                         "Wrong number of uplinks without a reception path");
+
+  // 2 of the 5 distinct uplinks reach the server
+  Ptr<CunbServerMetrics> metrics = server->GetMetrics ();
+  NS_TEST_ASSERT_MSG_EQ (sink->GetNRecorded (), 2, "Wrong number of readings");
+  NS_TEST_ASSERT_MSG_EQ_TOL (sink->GetNRecorded () / 5.0, 0.4, 1e-9, "Wrong PDR");
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetDuplicateCount (), 1, "Wrong number of duplicates");
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetReplyCount (1), 2, "Wrong number of ACKs in the first window");
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetReplyCount (2), 0, "Wrong number of ACKs in the second window");
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetReplyGivenUpCount (), 0, "ACKs were given up");
+  NS_TEST_ASSERT_MSG_EQ (sink->GetBuffered (0).value, 1000, "Wrong first reading");
+  NS_TEST_ASSERT_MSG_EQ (sink->GetBuffered (1).value, 1001, "Wrong second reading");
+
+  Simulator::Destroy ();
+}
+
+// A MS that only listens in its ping slots, once a beacon gave it the
+// network time
+class PingSlotTestCase : public TestCase
+{
+public:
+  PingSlotTestCase ();
+  virtual ~PingSlotTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PingSlotTestCase::PingSlotTestCase ()
+  : TestCase ("Check that requests held for the ping slots are answered")
+{
+}
+
+PingSlotTestCase::~PingSlotTestCase ()
+{
+}
+
+void
+PingSlotTestCase::DoRun (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<CunbChannel> channel = CreateChannel ();
+  CunbPhyHelper phyHelper = CunbPhyHelper ();
+  phyHelper.SetChannel (channel);
+  CunbMacHelper macHelper = CunbMacHelper ();
+  macHelper.SetRegion (CunbMacHelper::EU);
+  CunbHelper helper = CunbHelper ();
+
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 0));
+  positions->Add (Vector (100, 0, 0));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+
+  NodeContainer enbs;
+  enbs.Create (1);
+  mobility.Install (enbs);
+  phyHelper.SetDeviceType (CunbPhyHelper::ENB);
+  macHelper.SetDeviceType (CunbMacHelper::ENB);
+  helper.Install (phyHelper, macHelper, enbs);
+
+  NodeContainer mss;
+  mss.Create (1);
+  mobility.Install (mss);
+  phyHelper.SetDeviceType (CunbPhyHelper::MS);
+  macHelper.SetDeviceType (CunbMacHelper::MS);
+  macHelper.SetAddressGenerator (CreateObject<CunbDeviceAddressGenerator> (54, 1864));
+  helper.Install (phyHelper, macHelper, mss);
+  Ptr<MSCunbMac> mac = mss.Get (0)->GetDevice (0)->GetObject<CunbNetDevice> ()
+      ->GetMac ()->GetObject<MSCunbMac> ();
+  mac->SetIdent (1);
+  mac->SetAttribute ("PingSlotPeriod", TimeValue (Seconds (10)));
+
+  NodeContainer servers;
+  servers.Create (1);
+  CunbServerHelper serverHelper;
+  serverHelper.SetEnbs (enbs);
+  serverHelper.SetMSs (mss);
+  Ptr<SimpleCunbServer> server = DynamicCast<SimpleCunbServer>
+      (serverHelper.Install (servers).Get (0));
+  server->SetAttribute ("PingSlotPeriod", TimeValue (Seconds (10)));
+  server->SetAttribute ("PingSlotDuration", TimeValue (Seconds (0.2)));
+  CunbForwarderHelper forwarderHelper;
+  forwarderHelper.Install (enbs);
+
+  Ptr<CunbBufferedReadingSink> sink = CreateObject<CunbBufferedReadingSink> ();
+  server->SetReadingSink (sink);
+
+  // The beacon gives the MS the network time before its hello, which makes
+  // the server send the AA Request, then the GET Request, in its ping slots
+  BeaconSenderHelper beaconHelper;
+  beaconHelper.SetSendTime (Seconds (1));
+  beaconHelper.Install (enbs.Get (0));
+
+  HelloHelper helloHelper;
+  helloHelper.SetSendTime (Seconds (5));
+  helloHelper.SetMac (mac);
+  helloHelper.Install (mss.Get (0));
+
+  OTRHelper otrHelper;
+  otrHelper.SetSendTime (Seconds (1000000));
+  otrHelper.SetMac (mac);
+  otrHelper.Install (mss.Get (0));
+
+  Simulator::Stop (Seconds (45));
+  Simulator::Run ();
+
+  // Only the propagation delay sets the clock of the MS apart
+  NS_TEST_ASSERT_MSG_EQ (mac->IsPingSlotSynchronised (), true,
+                         "The MS didn't get the network time");
+  NS_TEST_ASSERT_MSG_EQ_TOL (mac->GetNetworkTime ().GetSeconds (),
+                             Simulator::Now ().GetSeconds (), 1e-3,
+                             "The network time of the MS is off");
+
+  Ptr<CunbServerMetrics> metrics = server->GetMetrics ();
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetAaRequestCount (), 1, "Wrong number of AA Requests");
+  NS_TEST_ASSERT_MSG_EQ (metrics->GetGetRequestCount (), 1, "Wrong number of GET Requests");
+  NS_TEST_ASSERT_MSG_EQ (sink->GetNRecorded (), 1, "The GET Request wasn't answered");
+  NS_TEST_ASSERT_MSG_EQ (sink->GetBuffered (0).value, 789, "Wrong reading");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * The KPIs of a run of a population of meters.
+ */
+struct PopulationKpis
+{
+  EnbOutcomes outcomes;
+  uint64_t sent;
+  uint64_t readings;
+  uint32_t duplicates;
+  uint32_t replies; //!< ACKs, in any of the windows
+  uint32_t givenUp;
+};
+
+/**
+ * Let the meters at the given positions report every minute for 10 minutes,
+ * around eNBs laid out on a grid of 1500 m.
+ */
+static PopulationKpis
+RunPopulation (uint32_t nEnbs, const std::vector<Vector> &meters)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<CunbChannel> channel = CreateChannel ();
+
+  NodeContainer enbs;
+  enbs.Create (nEnbs);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nEnbs; i++)
+    {
+      positions->Add (Vector (1500 * (i % 2), 1500 * (i / 2), 15));
+    }
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (enbs);
+
+  CunbPhyHelper phyHelper = CunbPhyHelper ();
+  phyHelper.SetChannel (channel);
+  phyHelper.SetDeviceType (CunbPhyHelper::ENB);
+  CunbMacHelper macHelper = CunbMacHelper ();
+  macHelper.SetDeviceType (CunbMacHelper::ENB);
+  macHelper.SetRegion (CunbMacHelper::EU);
+  CunbHelper helper = CunbHelper ();
+  helper.Install (phyHelper, macHelper, enbs);
+
+  NodeContainer servers;
+  servers.Create (1);
+  CunbServerHelper serverHelper;
+  serverHelper.SetEnbs (enbs);
+  serverHelper.SetMSs (NodeContainer ());
+  Ptr<SimpleCunbServer> server = DynamicCast<SimpleCunbServer>
+      (serverHelper.Install (servers).Get (0));
+  CunbForwarderHelper forwarderHelper;
+  forwarderHelper.Install (enbs);
+
+  Ptr<CunbBufferedReadingSink> sink = CreateObject<CunbBufferedReadingSink> ();
+  server->SetReadingSink (sink);
+
+  Ptr<CunbMeterPopulation> population = CreateObject<CunbMeterPopulation> ();
+  population->SetAttribute ("ReportingInterval", TimeValue (Seconds (60)));
+  population->SetChannel (channel);
+  population->AssignStreams (0);
+  Ptr<CunbDeviceAddressGenerator> addrGen = CreateObject<CunbDeviceAddressGenerator> (54, 1864);
+  for (uint32_t i = 0; i < meters.size (); i++)
+    {
+      population->AddMeter (meters[i], addrGen->NextAddress ());
+    }
+  server->AddPopulation (population);
+
+  PopulationKpis kpis = PopulationKpis ();
+  ConnectOutcomes (enbs, &kpis.outcomes);
+
+  // Let the last reports reach the server
+  population->Start ();
+  Simulator::Schedule (Seconds (600), &CunbMeterPopulation::Stop, population);
+  Simulator::Stop (Seconds (620));
+  Simulator::Run ();
+
+  Ptr<CunbServerMetrics> metrics = server->GetMetrics ();
+  kpis.sent = population->GetNSent ();
+  kpis.readings = sink->GetNRecorded ();
+  kpis.duplicates = metrics->GetDuplicateCount ();
+  kpis.replies = metrics->GetReplyCount (1) + metrics->GetReplyCount (2) +
+    metrics->GetReplyCount (3);
+  kpis.givenUp = metrics->GetReplyGivenUpCount ();
+
+  Simulator::Destroy ();
+  return kpis;
+}
+
+// Meters whose reports never overlap, so that their KPIs are known exactly
+class PopulationGoldenTestCase : public TestCase
+{
+public:
+  PopulationGoldenTestCase ();
+  virtual ~PopulationGoldenTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PopulationGoldenTestCase::PopulationGoldenTestCase ()
+  : TestCase ("Compare the KPIs of a lone meter to golden values")
+{
+}
+
+PopulationGoldenTestCase::~PopulationGoldenTestCase ()
+{
+}
+
+void
+PopulationGoldenTestCase::DoRun (void)
+{
+  // A meter in the middle of 4 eNBs, some 1060 m away from each of them
+  std::vector<Vector> meters (1, Vector (750, 750, 0));
+  PopulationKpis kpis = RunPopulation (4, meters);
+
+  NS_TEST_ASSERT_MSG_EQ (kpis.sent, 10, "Wrong number of reports sent");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.rxBegin, 40, "Wrong number of receptions at the eNBs");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.received, 40, "Wrong number of reports received");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.interfered, 0, "Wrong number of reports interfered");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.underSensitivity, 0,
+                         "Wrong number of reports under the sensitivity");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.noMoreReceivers, 0,
+                         "Wrong number of reports without a reception path");
+  NS_TEST_ASSERT_MSG_EQ (kpis.readings, 10, "Wrong number of readings");
+  NS_TEST_ASSERT_MSG_EQ_TOL (kpis.readings / 10.0, 1.0, 1e-9, "Wrong PDR");
+  NS_TEST_ASSERT_MSG_EQ (kpis.duplicates, 30, "Wrong number of duplicates");
+  NS_TEST_ASSERT_MSG_EQ (kpis.replies, 0, "Meters of a population were sent ACKs");
+  NS_TEST_ASSERT_MSG_EQ (kpis.givenUp, 0, "ACKs were given up");
+
+  // A meter out of the reach of all of them
+  meters[0] = Vector (100000, 0, 0);
+  kpis = RunPopulation (4, meters);
+
+  NS_TEST_ASSERT_MSG_EQ (kpis.sent, 10, "Wrong number of reports sent");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.rxBegin, 40, "Wrong number of receptions at the eNBs");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.received, 0, "Wrong number of reports received");
+  NS_TEST_ASSERT_MSG_EQ (kpis.outcomes.underSensitivity, 40,
+                         "Wrong number of reports under the sensitivity");
+  NS_TEST_ASSERT_MSG_EQ (kpis.readings, 0, "Wrong number of readings");
+  NS_TEST_ASSERT_MSG_EQ (kpis.duplicates, 0, "Wrong number of duplicates");
+}
+
+// A seeded population of meters around a few eNBs
+class PopulationTestCase : public TestCase
+{
+public:
+  /**
+   * \param outcomes The golden outcomes of the receptions at the eNBs.
+   * \param readings The golden number of readings at the server.
+   */
+  PopulationTestCase (uint32_t nMeters, uint32_t nEnbs,
+                      const EnbOutcomes &outcomes, uint64_t readings);
+  virtual ~PopulationTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  PopulationKpis RunScenario (void);
+
+  uint32_t m_nMeters;
+  uint32_t m_nEnbs;
+  EnbOutcomes m_outcomes;
+  uint64_t m_readings;
+};
+
+PopulationTestCase::PopulationTestCase (uint32_t nMeters, uint32_t nEnbs,
+                                        const EnbOutcomes &outcomes,
+                                        uint64_t readings)
+  : TestCase ("Compare the KPIs of a seeded population of meters to golden values"),
+    m_nMeters (nMeters),
+    m_nEnbs (nEnbs),
+    m_outcomes (outcomes),
+    m_readings (readings)
+{
+}
+
+PopulationTestCase::~PopulationTestCase ()
+{
+}
+
+PopulationKpis
+PopulationTestCase::RunScenario (void)
+{
+  RngSeedManager::SetSeed (1);
+  RngSeedManager::SetRun (1);
+
+  Ptr<UniformDiscPositionAllocator> meterPositions = CreateObject<UniformDiscPositionAllocator> ();
+  meterPositions->SetRho (3000);
+  meterPositions->AssignStreams (1);
+  std::vector<Vector> meters;
+  for (uint32_t i = 0; i < m_nMeters; i++)
+    {
+      meters.push_back (meterPositions->GetNext ());
+    }
+
+  return RunPopulation (m_nEnbs, meters);
+}
+
+void
+PopulationTestCase::DoRun (void)
+{
+  PopulationKpis kpis = RunScenario ();
+  const EnbOutcomes &outcomes = kpis.outcomes;
+
+  // Every meter reports 10 times, within the first interval and once per
+  // interval after it, and every report reaches every eNB
+  NS_TEST_ASSERT_MSG_EQ (kpis.sent, 10 * m_nMeters, "Wrong number of reports sent");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.rxBegin, m_outcomes.rxBegin,
+                         "Wrong number of receptions at the eNBs");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.received, m_outcomes.received,
+                         "Wrong number of reports received");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.interfered, m_outcomes.interfered,
+                         "Wrong number of reports interfered");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.underSensitivity, m_outcomes.underSensitivity,
+                         "Wrong number of reports under the sensitivity");
+  NS_TEST_ASSERT_MSG_EQ (outcomes.noMoreReceivers, m_outcomes.noMoreReceivers,
+                         "Wrong number of reports without a reception path");
+
+  // Every report received by an eNB reaches the server, once as a reading
+  NS_TEST_ASSERT_MSG_EQ (kpis.readings, m_readings, "Wrong number of readings");
+  NS_TEST_ASSERT_MSG_EQ_TOL (kpis.readings / (double) kpis.sent,
+                             m_readings / (10.0 * m_nMeters), 1e-9, "Wrong PDR");
+  NS_TEST_ASSERT_MSG_EQ (kpis.duplicates, m_outcomes.received - m_readings,
+                         "Wrong number of duplicates");
+
+  // The meters don't listen, the server mustn't try to answer them
+  NS_TEST_ASSERT_MSG_EQ (kpis.replies, 0, "Meters of a population were sent ACKs");
+  NS_TEST_ASSERT_MSG_EQ (kpis.givenUp, 0, "ACKs were given up");
+
+  // The same seed gives the same network
+  PopulationKpis again = RunScenario ();
+  NS_TEST_ASSERT_MSG_EQ (again.sent, kpis.sent, "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.outcomes.received, outcomes.received, "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.outcomes.interfered, outcomes.interfered, "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.outcomes.underSensitivity, outcomes.underSensitivity,
+                         "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.outcomes.noMoreReceivers, outcomes.noMoreReceivers,
+                         "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.readings, kpis.readings, "The run isn't reproducible");
+  NS_TEST_ASSERT_MSG_EQ (again.duplicates, kpis.duplicates, "The run isn't reproducible");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Suites
+//////////////////////////////////////////////////////////////////////////////
+
 class CunbTestSuite : public TestSuite
 {
 public:
@@ -59,10 +1376,36 @@ public:
 CunbTestSuite::CunbTestSuite ()
   : TestSuite ("cunb", UNIT)
 {
-  // TestDuration for TestCase can be QUICK, EXTENSIVE or TAKES_FOREVER
-  AddTestCase (new CunbTestCase1, TestCase::QUICK);
+  AddTestCase (new OnAirTimeTestCase, TestCase::QUICK);
+  AddTestCase (new OverlapTimeTestCase, TestCase::QUICK);
+  AddTestCase (new InterferenceTestCase, TestCase::QUICK);
+  AddTestCase (new MacTrailerTestCase, TestCase::QUICK);
+  AddTestCase (new UplinkWindowTestCase, TestCase::QUICK);
+  AddTestCase (new HeaderSerializationTestCase, TestCase::QUICK);
+  AddTestCase (new PacketTrackerTestCase, TestCase::QUICK);
+  AddTestCase (new TopologyLoaderTestCase, TestCase::QUICK);
 }
 
-// Do not forget to allocate an instance of this TestSuite
 static CunbTestSuite cunbTestSuite;
 
+class CunbSystemTestSuite : public TestSuite
+{
+public:
+  CunbSystemTestSuite ();
+};
+
+CunbSystemTestSuite::CunbSystemTestSuite ()
+  : TestSuite ("cunb-system", SYSTEM)
+{
+  AddTestCase (new SmallNetworkTestCase, TestCase::QUICK);
+  AddTestCase (new PingSlotTestCase, TestCase::QUICK);
+  AddTestCase (new PopulationGoldenTestCase, TestCase::QUICK);
+  // Golden outcomes: receptions, received, interfered, under the
+  // sensitivity, without a reception path; then the readings
+  AddTestCase (new PopulationTestCase (200, 1, {2000, 1008, 37, 931, 24}, 1008),
+               TestCase::QUICK);
+  AddTestCase (new PopulationTestCase (2000, 4, {80000, 20877, 11751, 37966, 9406}, 8981),
+               TestCase::EXTENSIVE);
+}
+
+static CunbSystemTestSuite cunbSystemTestSuite;